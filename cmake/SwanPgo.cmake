@@ -0,0 +1,49 @@
+# Profile guided build of Swan, run by the swan_pgo target
+# cmake -DSOURCE_DIR=... -DBUILD_DIR=... -DBUILD_TYPE=... -DGENERATOR=... -DC_COMPILER=... -DC_COMPILER_ID=... [-DMARCH=...] -P SwanPgo.cmake
+#
+# Both passes build in the same directory, GCC names the profile of every object after its path and those have to match
+# 1. build with SWAN_PGO=GENERATE and run swan_bench, which writes the profile to BUILD_DIR/pgo-data
+# 2. build again with SWAN_PGO=USE, the optimized binaries end up in BUILD_DIR/src
+
+set(PgoData "${BUILD_DIR}/pgo-data")
+
+function(SwanPgoRun)
+    execute_process(COMMAND ${ARGN} RESULT_VARIABLE Result)
+    if (NOT Result EQUAL 0)
+        message(FATAL_ERROR "PGO step failed: ${ARGN}")
+    endif()
+endfunction()
+
+function(SwanPgoConfigure Mode)
+    SwanPgoRun(${CMAKE_COMMAND} -S ${SOURCE_DIR} -B ${BUILD_DIR} -G ${GENERATOR}
+        -DCMAKE_C_COMPILER=${C_COMPILER}
+        -DCMAKE_BUILD_TYPE=${BUILD_TYPE}
+        -DSWAN_MARCH=${MARCH}
+        -DSWAN_PGO=${Mode}
+        -DSWAN_PGO_DATA=${PgoData})
+endfunction()
+
+# An old profile would get mixed into the new one
+file(REMOVE_RECURSE ${PgoData})
+file(MAKE_DIRECTORY ${PgoData})
+
+message(STATUS "Building Swan to collect a profile")
+SwanPgoConfigure(GENERATE)
+SwanPgoRun(${CMAKE_COMMAND} --build ${BUILD_DIR} --target swan_bench)
+
+# Every benchmark, a few times over, is the workload the profile comes from
+message(STATUS "Running swan_bench for the profile")
+SwanPgoRun(${BUILD_DIR}/src/bench/swan_bench --repetitions 3 --min-time 0.01 --output ${PgoData}/bench.json)
+
+# Clang writes raw profiles that have to be merged first
+if (NOT C_COMPILER_ID STREQUAL "GNU")
+    find_program(LlvmProfdata NAMES llvm-profdata REQUIRED)
+    file(GLOB RawProfiles ${PgoData}/*.profraw)
+    SwanPgoRun(${LlvmProfdata} merge -o ${PgoData}/swan.profdata ${RawProfiles})
+endif()
+
+message(STATUS "Building Swan with the profile")
+SwanPgoConfigure(USE)
+SwanPgoRun(${CMAKE_COMMAND} --build ${BUILD_DIR})
+
+message(STATUS "Done, the profile guided binaries are in ${BUILD_DIR}/src")
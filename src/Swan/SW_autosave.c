@@ -0,0 +1,263 @@
+#include "SW_autosave.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "SW_network.h"
+#include "SW_trace.h"
+
+typedef struct SW_Autosave
+{
+    char *fileName;
+    char *temporaryName;            // fileName with .tmp after it, written first and renamed over fileName once it's complete
+    uint32_t stepInterval, stepsDone;
+
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;            // A save is staged, or the writer should stop
+    pthread_cond_t idle;            // The writer is done with the staging buffer
+
+    // Training only touches the staging buffer while nothing is staged, the writer only while something is
+    uint8_t *staging;
+    size_t stagingSize, stagingCapacity;
+    bool staged;
+    bool stopping;
+
+    uint32_t skipped;               // Saves that came while the last one was still being written
+} SW_Autosave;
+
+// The rename is only durable once the directory it happened in is synced as well
+static void SW_SyncDirectory(const char *fileName)
+{
+#ifndef _WIN32
+    const char *Slash = strrchr(fileName, '/');
+    char *Directory = Slash != NULL ? strndup(fileName, (size_t)(Slash - fileName) + 1) : strdup(".");
+    if (Directory == NULL)
+        return;
+
+    int File = open(Directory, O_RDONLY);
+    if (File >= 0)
+    {
+        fsync(File);
+        close(File);
+    }
+
+    free(Directory);
+#else
+    (void)fileName;
+#endif
+}
+
+static bool SW_WriteSave(SW_Autosave *autosave)
+{
+    FILE *File = fopen(autosave->temporaryName, "wb");
+    if (File == NULL)
+        return false;
+
+    bool Written = fwrite(autosave->staging, 1, autosave->stagingSize, File) == autosave->stagingSize && fflush(File) == 0;
+
+#ifdef _WIN32
+    Written = Written && _commit(_fileno(File)) == 0;
+#else
+    Written = Written && fsync(fileno(File)) == 0;
+#endif
+
+    Written = fclose(File) == 0 && Written;
+
+    if (!Written)
+    {
+        remove(autosave->temporaryName);
+        return false;
+    }
+
+#ifdef _WIN32
+    // rename doesn't replace files here, for a moment there's only the temporary one
+    remove(autosave->fileName);
+#endif
+
+    if (rename(autosave->temporaryName, autosave->fileName) != 0)
+        return false;
+
+    SW_SyncDirectory(autosave->fileName);
+
+    return true;
+}
+
+static void *SW_AutosaveWriter(void *argument)
+{
+    SW_Autosave *Autosave = argument;
+
+    SWP_setTraceThreadName("autosave");
+
+    pthread_mutex_lock(&Autosave->lock);
+
+    for (;;)
+    {
+        while (!Autosave->staged && !Autosave->stopping)
+            pthread_cond_wait(&Autosave->wake, &Autosave->lock);
+
+        if (!Autosave->staged)
+            break;
+
+        pthread_mutex_unlock(&Autosave->lock);
+
+        uint64_t TraceBegin = SWP_traceBegin();
+
+        if (!SW_WriteSave(Autosave))
+            fputs("The autosave didn't make it to the disk, the last one is still there though", stderr);
+
+        SWP_traceEnd(TraceBegin, "autosave write", "io", (int64_t)Autosave->stagingSize);
+
+        pthread_mutex_lock(&Autosave->lock);
+        Autosave->staged = false;
+        pthread_cond_broadcast(&Autosave->idle);
+    }
+
+    pthread_mutex_unlock(&Autosave->lock);
+
+    return NULL;
+}
+
+void SW_StartAutosave(SW_Network *network, const char *fileName, uint32_t stepInterval)
+{
+    SW_StopAutosave(network);
+
+    SW_Autosave *Autosave = calloc(1, sizeof(SW_Autosave));
+    size_t NameLength = strlen(fileName);
+
+    if (Autosave == NULL || (Autosave->fileName = malloc(NameLength + 1)) == NULL || (Autosave->temporaryName = malloc(NameLength + 5)) == NULL)
+    {
+        fputs("Please get better RAM", stderr);
+        abort();
+    }
+
+    memcpy(Autosave->fileName, fileName, NameLength + 1);
+    memcpy(Autosave->temporaryName, fileName, NameLength);
+    memcpy(Autosave->temporaryName + NameLength, ".tmp", 5);
+
+    Autosave->stepInterval = stepInterval;
+
+    pthread_mutex_init(&Autosave->lock, NULL);
+    pthread_cond_init(&Autosave->wake, NULL);
+    pthread_cond_init(&Autosave->idle, NULL);
+
+    if (pthread_create(&Autosave->writer, NULL, SW_AutosaveWriter, Autosave) != 0)
+    {
+        fputs("No thread for the autosave, it's off", stderr);
+        pthread_mutex_destroy(&Autosave->lock);
+        pthread_cond_destroy(&Autosave->wake);
+        pthread_cond_destroy(&Autosave->idle);
+        free(Autosave->fileName);
+        free(Autosave->temporaryName);
+        free(Autosave);
+        return;
+    }
+
+    network->autosave = Autosave;
+}
+
+bool SW_AutosaveNow(SW_Network *network)
+{
+    SW_Autosave *Autosave = network->autosave;
+    if (Autosave == NULL)
+        return false;
+
+    pthread_mutex_lock(&Autosave->lock);
+    bool Busy = Autosave->staged;
+    if (Busy)
+        Autosave->skipped++;
+    pthread_mutex_unlock(&Autosave->lock);
+
+    if (Busy)
+        return false;
+
+    uint64_t TraceBegin = SWP_traceBegin();
+
+    size_t Size = SW_SerializeNetwork(network, NULL);
+    if (Size > Autosave->stagingCapacity)
+    {
+        free(Autosave->staging);
+        Autosave->staging = malloc(Size);
+        if (Autosave->staging == NULL)
+        {
+            fputs("Please get better RAM", stderr);
+            abort();
+        }
+
+        Autosave->stagingCapacity = Size;
+    }
+
+    SW_SerializeNetwork(network, Autosave->staging);
+    Autosave->stagingSize = Size;
+
+    SWP_traceEnd(TraceBegin, "autosave snapshot", "io", (int64_t)Size);
+
+    pthread_mutex_lock(&Autosave->lock);
+    Autosave->staged = true;
+    pthread_cond_signal(&Autosave->wake);
+    pthread_mutex_unlock(&Autosave->lock);
+
+    return true;
+}
+
+void SW_WaitForAutosave(SW_Network *network)
+{
+    SW_Autosave *Autosave = network->autosave;
+    if (Autosave == NULL)
+        return;
+
+    pthread_mutex_lock(&Autosave->lock);
+    while (Autosave->staged)
+        pthread_cond_wait(&Autosave->idle, &Autosave->lock);
+    pthread_mutex_unlock(&Autosave->lock);
+}
+
+void SW_StopAutosave(SW_Network *network)
+{
+    SW_Autosave *Autosave = network->autosave;
+    if (Autosave == NULL)
+        return;
+
+    // The writer finishes what's staged before it looks at stopping
+    pthread_mutex_lock(&Autosave->lock);
+    Autosave->stopping = true;
+    pthread_cond_signal(&Autosave->wake);
+    pthread_mutex_unlock(&Autosave->lock);
+
+    pthread_join(Autosave->writer, NULL);
+
+    if (Autosave->skipped != 0)
+        fprintf(stderr, "The disk was too slow for %u autosaves, those got skipped\n", Autosave->skipped);
+
+    pthread_mutex_destroy(&Autosave->lock);
+    pthread_cond_destroy(&Autosave->wake);
+    pthread_cond_destroy(&Autosave->idle);
+    free(Autosave->staging);
+    free(Autosave->fileName);
+    free(Autosave->temporaryName);
+    free(Autosave);
+
+    network->autosave = NULL;
+}
+
+void SW_AutosaveStep(SW_Network *network)
+{
+    SW_Autosave *Autosave = network->autosave;
+    if (Autosave == NULL || Autosave->stepInterval == 0)
+        return;
+
+    if (++Autosave->stepsDone < Autosave->stepInterval)
+        return;
+
+    Autosave->stepsDone = 0;
+    SW_AutosaveNow(network);
+}
@@ -0,0 +1,22 @@
+#ifndef SW_AUTOSAVE_H
+#define SW_AUTOSAVE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "SW_types.h"
+
+// Saves a network every so many training steps without training waiting for the disk
+// A step copies the network into a staging buffer, in the same bytes SW_SaveNetwork writes, and a thread of its own writes that out
+// in one go to a temporary file, syncs it and renames it over the real one, so a crash always leaves the last complete save behind
+// When the disk can't keep up a save gets skipped instead of stopping training for it
+
+void SW_StartAutosave(SW_Network *network, const char *fileName, uint32_t stepInterval); // every stepInterval steps of SW_TrainNeuralNetwork, 0 only saves on SW_AutosaveNow
+bool SW_AutosaveNow(SW_Network *network);       // false if it got skipped, the last save is still being written
+void SW_WaitForAutosave(SW_Network *network);   // returns once the last save is on disk
+void SW_StopAutosave(SW_Network *network);      // waits for the last save too, SW_UnloadNetwork does this on its own
+
+// For SW_TrainNeuralNetwork, counts one step and saves when it's time
+void SW_AutosaveStep(SW_Network *network);
+
+#endif // SW_AUTOSAVE_H
@@ -0,0 +1,677 @@
+#include "SW_convolution.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "SW_types.h"
+#include "SW_network.h"
+#include "SW_layer.h"
+#include "SW_matrix.h"
+
+// Output channels per block of the direct kernel, and output pixels it does at once, SWM_convolutionTile does one of those
+#define SW_DIRECT_BLOCK SWM_CONV_TILE_CHANNELS
+#define SW_DIRECT_PIXELS SWM_CONV_TILE_PIXELS
+
+// How many times the autotuner runs each algorithm, the fastest run counts
+#define SW_AUTOTUNE_RUNS 3
+
+static void *SW_ConvolutionAlloc(size_t size)
+{
+    void *Memory = malloc(size);
+
+    if (Memory == NULL)
+    {
+        fputs("Please get better RAM", stderr);
+        abort();
+    }
+
+    return Memory;
+}
+
+static float *SW_Columns(SW_Layer *layer)
+{
+    if (layer->convolution->columns == NULL)
+        layer->convolution->columns = SW_ConvolutionAlloc(sizeof(float) * layer->weightColumns * layer->height * layer->width);
+
+    return layer->convolution->columns;
+}
+
+static float *SW_ColumnErrors(SW_Layer *layer)
+{
+    if (layer->convolution->columnErrors == NULL)
+        layer->convolution->columnErrors = SW_ConvolutionAlloc(sizeof(float) * layer->weightColumns * layer->height * layer->width);
+
+    return layer->convolution->columnErrors;
+}
+
+void SW_ResetConvolutionWeights(SW_Layer *layer)
+{
+    if (layer->convolution == NULL)
+        return;
+
+    free(layer->convolution->blockedWeights);
+    free(layer->convolution->winogradWeights);
+
+    layer->convolution->blockedWeights = NULL;
+    layer->convolution->winogradWeights = NULL;
+}
+
+void SW_FreeConvolution(SW_Layer *layer)
+{
+    if (layer->convolution == NULL)
+        return;
+
+    SW_ResetConvolutionWeights(layer);
+
+    free(layer->convolution->columns);
+    free(layer->convolution->columnErrors);
+    free(layer->convolution->scratch);
+    free(layer->convolution);
+
+    layer->convolution = NULL;
+}
+
+static bool SW_WinogradFits(SW_Layer *layer)
+{
+    return layer->convolution->kernelSize == 3 && layer->convolution->stride == 1;
+}
+
+void SW_SetConvolutionAlgorithm(SW_Layer *layer, SW_ConvolutionAlgorithm algorithm)
+{
+    if (layer->convolution == NULL)
+    {
+        fputs("Only convolutions have a convolution algorithm, surprisingly", stderr);
+        return;
+    }
+
+    if (algorithm == SW_CONVOLUTION_ALGORITHM_WINOGRAD && !SW_WinogradFits(layer))
+    {
+        fputs("Winograd only does 3x3 kernels with a stride of 1, using im2col instead", stderr);
+        algorithm = SW_CONVOLUTION_ALGORITHM_IM2COL;
+    }
+
+    layer->convolution->algorithm = algorithm;
+
+    // Sized for the old algorithm
+    free(layer->convolution->scratch);
+    layer->convolution->scratch = NULL;
+}
+
+// Every row is one input channel and kernel position, every column one output pixel, pixels outside the image are zero padding
+static void SW_Im2Col(SW_Layer *layer, const float *input, float *columns)
+{
+    SW_Convolution *Convolution = layer->convolution;
+    uint32_t KernelSize = Convolution->kernelSize;
+    uint32_t PixelAmount = layer->height * layer->width;
+
+    for (uint32_t c = 0; c < Convolution->inputChannels; c++)
+    for (uint32_t ky = 0; ky < KernelSize; ky++)
+    for (uint32_t kx = 0; kx < KernelSize; kx++)
+    {
+        const float *Channel = &input[(size_t)c * Convolution->inputHeight * Convolution->inputWidth];
+        float *Row = &columns[((size_t)(c * KernelSize + ky) * KernelSize + kx) * PixelAmount];
+
+        for (uint32_t y = 0; y < layer->height; y++)
+        {
+            int64_t InputY = (int64_t)y * Convolution->stride + ky - Convolution->padding;
+            float *RowPart = &Row[(size_t)y * layer->width];
+
+            if (InputY < 0 || InputY >= Convolution->inputHeight)
+            {
+                memset(RowPart, 0, sizeof(float) * layer->width);
+                continue;
+            }
+
+            for (uint32_t x = 0; x < layer->width; x++)
+            {
+                int64_t InputX = (int64_t)x * Convolution->stride + kx - Convolution->padding;
+
+                RowPart[x] = (InputX < 0 || InputX >= Convolution->inputWidth) ? 0.0f : Channel[InputY * Convolution->inputWidth + InputX];
+            }
+        }
+    }
+}
+
+// The reverse of SW_Im2Col, pixels that were used by several columns get the sum of their errors
+static void SW_Col2Im(SW_Layer *layer, const float *columns, float *input)
+{
+    SW_Convolution *Convolution = layer->convolution;
+    uint32_t KernelSize = Convolution->kernelSize;
+    uint32_t PixelAmount = layer->height * layer->width;
+
+    memset(input, 0, sizeof(float) * Convolution->inputChannels * Convolution->inputHeight * Convolution->inputWidth);
+
+    for (uint32_t c = 0; c < Convolution->inputChannels; c++)
+    for (uint32_t ky = 0; ky < KernelSize; ky++)
+    for (uint32_t kx = 0; kx < KernelSize; kx++)
+    {
+        float *Channel = &input[(size_t)c * Convolution->inputHeight * Convolution->inputWidth];
+        const float *Row = &columns[((size_t)(c * KernelSize + ky) * KernelSize + kx) * PixelAmount];
+
+        for (uint32_t y = 0; y < layer->height; y++)
+        {
+            int64_t InputY = (int64_t)y * Convolution->stride + ky - Convolution->padding;
+            if (InputY < 0 || InputY >= Convolution->inputHeight) continue;
+
+            for (uint32_t x = 0; x < layer->width; x++)
+            {
+                int64_t InputX = (int64_t)x * Convolution->stride + kx - Convolution->padding;
+                if (InputX < 0 || InputX >= Convolution->inputWidth) continue;
+
+                Channel[InputY * Convolution->inputWidth + InputX] += Row[(size_t)y * layer->width + x];
+            }
+        }
+    }
+}
+
+static void SW_Im2ColConvolution(SW_Layer *layer, const float *input, const void *weights, SWM_Type weightType, float *output, float *columns)
+{
+    uint32_t PixelAmount = layer->height * layer->width;
+
+    SW_Im2Col(layer, input, columns);
+
+    // output[channels x pixels] = weights[channels x (input channels * kernel area)] * columns[(input channels * kernel area) x pixels]
+    SWM_gemm(false, false, layer->weightRows, PixelAmount, layer->weightColumns, 1.0f, weights, weightType, layer->weightColumns, columns, SWM_TYPE_FLOAT32, PixelAmount, 0.0f, output, PixelAmount);
+}
+
+void SW_ConvolutionForward(SW_Layer *layer, const float *input, const void *weights, SWM_Type weightType, float *output)
+{
+    SW_Im2ColConvolution(layer, input, weights, weightType, output, SW_Columns(layer));
+}
+
+void SW_ConvolutionBackward(SW_Layer *layer, const float *input, const float *outputError, const void *weights, SWM_Type weightType, float scale, float *weightGradient, float *inputError)
+{
+    uint32_t PixelAmount = layer->height * layer->width;
+
+    // The columns aren't kept around from the forward pass, remaking them is cheaper than storing them for every image
+    SW_Im2Col(layer, input, SW_Columns(layer));
+
+    SWM_gemm(false, true, layer->weightRows, layer->weightColumns, PixelAmount, scale, outputError, SWM_TYPE_FLOAT32, PixelAmount, layer->convolution->columns, SWM_TYPE_FLOAT32, PixelAmount, 1.0f, weightGradient, layer->weightColumns);
+
+    if (inputError == NULL)
+        return;
+
+    SWM_gemm(true, false, layer->weightColumns, PixelAmount, layer->weightRows, 1.0f, weights, weightType, layer->weightColumns, outputError, SWM_TYPE_FLOAT32, PixelAmount, 0.0f, SW_ColumnErrors(layer), PixelAmount);
+
+    SW_Col2Im(layer, layer->convolution->columnErrors, inputError);
+}
+
+// Direct, every block of 8 output channels goes over the image with the weights of the block interleaved, so one load has a weight for each channel
+static void SW_BlockWeights(SW_Layer *layer)
+{
+    SW_Convolution *Convolution = layer->convolution;
+    uint32_t BlockAmount = (layer->channels + SW_DIRECT_BLOCK - 1) / SW_DIRECT_BLOCK;
+
+    Convolution->blockedWeights = SW_ConvolutionAlloc(sizeof(float) * BlockAmount * layer->weightColumns * SW_DIRECT_BLOCK);
+
+    for (uint32_t b = 0; b < BlockAmount; b++)
+        for (uint32_t k = 0; k < layer->weightColumns; k++)
+            for (uint32_t l = 0; l < SW_DIRECT_BLOCK; l++)
+            {
+                uint32_t Channel = b * SW_DIRECT_BLOCK + l;
+
+                Convolution->blockedWeights[((size_t)b * layer->weightColumns + k) * SW_DIRECT_BLOCK + l] = Channel < layer->channels ? layer->weights[(size_t)Channel * layer->weightColumns + k] : 0.0f;
+            }
+}
+
+// The input with the padding written out as zeros, wide enough that the last tile of a row can read SW_DIRECT_PIXELS pixels
+static uint32_t SW_PaddedHeight(const SW_Layer *layer)
+{
+    return layer->convolution->inputHeight + 2 * layer->convolution->padding;
+}
+
+static uint32_t SW_PaddedWidth(const SW_Layer *layer)
+{
+    const SW_Convolution *Convolution = layer->convolution;
+    uint32_t TileAmount = (layer->width + SW_DIRECT_PIXELS - 1) / SW_DIRECT_PIXELS;
+    uint32_t Width = (TileAmount * SW_DIRECT_PIXELS - 1) * Convolution->stride + Convolution->kernelSize;
+
+    return Width > Convolution->inputWidth + 2 * Convolution->padding ? Width : Convolution->inputWidth + 2 * Convolution->padding;
+}
+
+// The scratch isn't this layer's alone, so the padding gets written every time as well, it's only the border
+static void SW_PadInput(SW_Layer *layer, const float *input, float *padded)
+{
+    SW_Convolution *Convolution = layer->convolution;
+    uint32_t PaddedHeight = SW_PaddedHeight(layer), PaddedWidth = SW_PaddedWidth(layer);
+    uint32_t Padding = Convolution->padding;
+    uint32_t BottomPadding = PaddedHeight - Padding - Convolution->inputHeight;
+    uint32_t RightPadding = PaddedWidth - Padding - Convolution->inputWidth;
+
+    for (uint32_t c = 0; c < Convolution->inputChannels; c++)
+    {
+        float *Plane = &padded[(size_t)c * PaddedHeight * PaddedWidth];
+
+        memset(Plane, 0, sizeof(float) * Padding * PaddedWidth);
+        memset(&Plane[(size_t)(Padding + Convolution->inputHeight) * PaddedWidth], 0, sizeof(float) * BottomPadding * PaddedWidth);
+
+        for (uint32_t y = 0; y < Convolution->inputHeight; y++)
+        {
+            float *Row = &Plane[(size_t)(Padding + y) * PaddedWidth];
+
+            memset(Row, 0, sizeof(float) * Padding);
+            memcpy(&Row[Padding], &input[((size_t)c * Convolution->inputHeight + y) * Convolution->inputWidth], sizeof(float) * Convolution->inputWidth);
+            memset(&Row[Padding + Convolution->inputWidth], 0, sizeof(float) * RightPadding);
+        }
+    }
+}
+
+static void SW_DirectConvolution(SW_Layer *layer, const float *input, float *output, float *scratch)
+{
+    SW_Convolution *Convolution = layer->convolution;
+    uint32_t PixelAmount = layer->height * layer->width;
+    size_t PaddedWidth = SW_PaddedWidth(layer), PlaneSize = (size_t)SW_PaddedHeight(layer) * PaddedWidth;
+    uint32_t BlockAmount = (layer->channels + SW_DIRECT_BLOCK - 1) / SW_DIRECT_BLOCK;
+
+    if (Convolution->blockedWeights == NULL)
+        SW_BlockWeights(layer);
+
+    SW_PadInput(layer, input, scratch);
+
+    float Tile[SW_DIRECT_PIXELS * SW_DIRECT_BLOCK];
+
+    for (uint32_t b = 0; b < BlockAmount; b++)
+    {
+        const float *Weights = &Convolution->blockedWeights[(size_t)b * layer->weightColumns * SW_DIRECT_BLOCK];
+        uint32_t ChannelAmount = layer->channels - b * SW_DIRECT_BLOCK < SW_DIRECT_BLOCK ? layer->channels - b * SW_DIRECT_BLOCK : SW_DIRECT_BLOCK;
+
+        for (uint32_t y = 0; y < layer->height; y++)
+            for (uint32_t x = 0; x < layer->width; x += SW_DIRECT_PIXELS)
+            {
+                uint32_t TilePixels = layer->width - x < SW_DIRECT_PIXELS ? layer->width - x : SW_DIRECT_PIXELS;
+
+                const float *Window = &scratch[(size_t)y * Convolution->stride * PaddedWidth + x * Convolution->stride];
+
+                SWM_convolutionTile(Window, PlaneSize, PaddedWidth, Convolution->inputChannels, Convolution->kernelSize, Convolution->stride, Weights, Tile);
+
+                // Back from blocked to channels x height x width
+                for (uint32_t p = 0; p < TilePixels; p++)
+                    for (uint32_t l = 0; l < ChannelAmount; l++)
+                        output[(size_t)(b * SW_DIRECT_BLOCK + l) * PixelAmount + y * layer->width + x + p] = Tile[p * SW_DIRECT_BLOCK + l];
+            }
+    }
+}
+
+// Winograd F(2x2, 3x3), every 2x2 block of output comes from a 4x4 block of input, with 16 multiplies per input channel instead of 36
+// In the transformed domain each of the 16 positions is its own gemm over the channels
+static uint32_t SW_WinogradTileAmount(SW_Layer *layer)
+{
+    return ((layer->height + 1) / 2) * ((layer->width + 1) / 2);
+}
+
+// U = G g G^T
+static void SW_WinogradTransformWeights(SW_Layer *layer)
+{
+    SW_Convolution *Convolution = layer->convolution;
+    uint32_t OutputChannels = layer->channels;
+    uint32_t InputChannels = Convolution->inputChannels;
+
+    Convolution->winogradWeights = SW_ConvolutionAlloc(sizeof(float) * 16 * OutputChannels * InputChannels);
+
+    for (uint32_t o = 0; o < OutputChannels; o++)
+        for (uint32_t c = 0; c < InputChannels; c++)
+        {
+            const float *g = &layer->weights[(size_t)o * layer->weightColumns + c * 9];
+            float Gg[4][3], U[4][4];
+
+            for (uint32_t j = 0; j < 3; j++)
+            {
+                Gg[0][j] = g[j];
+                Gg[1][j] = 0.5f * (g[j] + g[3 + j] + g[6 + j]);
+                Gg[2][j] = 0.5f * (g[j] - g[3 + j] + g[6 + j]);
+                Gg[3][j] = g[6 + j];
+            }
+
+            for (uint32_t i = 0; i < 4; i++)
+            {
+                U[i][0] = Gg[i][0];
+                U[i][1] = 0.5f * (Gg[i][0] + Gg[i][1] + Gg[i][2]);
+                U[i][2] = 0.5f * (Gg[i][0] - Gg[i][1] + Gg[i][2]);
+                U[i][3] = Gg[i][2];
+            }
+
+            for (uint32_t i = 0; i < 16; i++)
+                Convolution->winogradWeights[((size_t)i * OutputChannels + o) * InputChannels + c] = U[i / 4][i % 4];
+        }
+}
+
+// The scratch has the transformed input, [16][input channels][tiles], and then the transformed output, [16][output channels][tiles]
+static void SW_WinogradConvolution(SW_Layer *layer, const float *input, float *output, float *scratch)
+{
+    SW_Convolution *Convolution = layer->convolution;
+    uint32_t OutputChannels = layer->channels;
+    uint32_t InputChannels = Convolution->inputChannels;
+    uint32_t TilesWide = (layer->width + 1) / 2;
+    uint32_t TileAmount = SW_WinogradTileAmount(layer);
+
+    float *WinogradInput = scratch;
+    float *WinogradOutput = &scratch[(size_t)16 * InputChannels * TileAmount];
+
+    if (Convolution->winogradWeights == NULL)
+        SW_WinogradTransformWeights(layer);
+
+    // V = B^T d B for every 4x4 input block
+    for (uint32_t c = 0; c < InputChannels; c++)
+        for (uint32_t t = 0; t < TileAmount; t++)
+        {
+            int64_t Top = (int64_t)(t / TilesWide) * 2 - Convolution->padding;
+            int64_t Left = (int64_t)(t % TilesWide) * 2 - Convolution->padding;
+            float d[4][4], Bd[4][4];
+
+            for (uint32_t i = 0; i < 4; i++)
+                for (uint32_t j = 0; j < 4; j++)
+                {
+                    int64_t InputY = Top + i, InputX = Left + j;
+
+                    d[i][j] = (InputY < 0 || InputY >= Convolution->inputHeight || InputX < 0 || InputX >= Convolution->inputWidth) ? 0.0f : input[((size_t)c * Convolution->inputHeight + InputY) * Convolution->inputWidth + InputX];
+                }
+
+            for (uint32_t j = 0; j < 4; j++)
+            {
+                Bd[0][j] = d[0][j] - d[2][j];
+                Bd[1][j] = d[1][j] + d[2][j];
+                Bd[2][j] = d[2][j] - d[1][j];
+                Bd[3][j] = d[1][j] - d[3][j];
+            }
+
+            float *V = &WinogradInput[(size_t)c * TileAmount + t];
+            size_t Step = (size_t)InputChannels * TileAmount;
+
+            for (uint32_t i = 0; i < 4; i++)
+            {
+                V[(i * 4 + 0) * Step] = Bd[i][0] - Bd[i][2];
+                V[(i * 4 + 1) * Step] = Bd[i][1] + Bd[i][2];
+                V[(i * 4 + 2) * Step] = Bd[i][2] - Bd[i][1];
+                V[(i * 4 + 3) * Step] = Bd[i][1] - Bd[i][3];
+            }
+        }
+
+    // M[output channels x tiles] = U[output channels x input channels] * V[input channels x tiles], for each of the 16 positions
+    for (uint32_t i = 0; i < 16; i++)
+        SWM_gemm(false, false, OutputChannels, TileAmount, InputChannels, 1.0f, &Convolution->winogradWeights[(size_t)i * OutputChannels * InputChannels], SWM_TYPE_FLOAT32, InputChannels, &WinogradInput[(size_t)i * InputChannels * TileAmount], SWM_TYPE_FLOAT32, TileAmount, 0.0f, &WinogradOutput[(size_t)i * OutputChannels * TileAmount], TileAmount);
+
+    // Y = A^T M A, cut off where the output is odd sized
+    for (uint32_t o = 0; o < OutputChannels; o++)
+        for (uint32_t t = 0; t < TileAmount; t++)
+        {
+            const float *M = &WinogradOutput[(size_t)o * TileAmount + t];
+            size_t Step = (size_t)OutputChannels * TileAmount;
+            float AM[2][4];
+
+            for (uint32_t j = 0; j < 4; j++)
+            {
+                AM[0][j] = M[j * Step] + M[(4 + j) * Step] + M[(8 + j) * Step];
+                AM[1][j] = M[(4 + j) * Step] - M[(8 + j) * Step] - M[(12 + j) * Step];
+            }
+
+            uint32_t Top = (t / TilesWide) * 2, Left = (t % TilesWide) * 2;
+
+            for (uint32_t i = 0; i < 2 && Top + i < layer->height; i++)
+            {
+                float *Row = &output[((size_t)o * layer->height + Top + i) * layer->width + Left];
+
+                Row[0] = AM[i][0] + AM[i][1] + AM[i][2];
+                if (Left + 1 < layer->width)
+                    Row[1] = AM[i][1] - AM[i][2] - AM[i][3];
+            }
+        }
+}
+
+// Floats of scratch one image needs, auto has room for whichever algorithm the autotuner picks
+static size_t SW_ScratchSize(SW_Layer *layer, SW_ConvolutionAlgorithm algorithm)
+{
+    SW_Convolution *Convolution = layer->convolution;
+    size_t Im2Col = (size_t)layer->weightColumns * layer->height * layer->width;
+    size_t Direct = (size_t)Convolution->inputChannels * SW_PaddedHeight(layer) * SW_PaddedWidth(layer);
+    size_t Winograd = SW_WinogradFits(layer) ? (size_t)16 * SW_WinogradTileAmount(layer) * (Convolution->inputChannels + layer->channels) : 0;
+
+    switch (algorithm)
+    {
+    case SW_CONVOLUTION_ALGORITHM_IM2COL:
+        return Im2Col;
+
+    case SW_CONVOLUTION_ALGORITHM_DIRECT:
+        return Direct;
+
+    case SW_CONVOLUTION_ALGORITHM_WINOGRAD:
+        return Winograd;
+
+    default:
+    {
+        size_t Largest = Im2Col > Direct ? Im2Col : Direct;
+        return Largest > Winograd ? Largest : Winograd;
+    }
+    }
+}
+
+static void SW_RunConvolution(SW_Layer *layer, SW_ConvolutionAlgorithm algorithm, const float *input, float *output, float *scratch)
+{
+    switch (algorithm)
+    {
+    case SW_CONVOLUTION_ALGORITHM_DIRECT:
+        SW_DirectConvolution(layer, input, output, scratch);
+        break;
+
+    case SW_CONVOLUTION_ALGORITHM_WINOGRAD:
+        SW_WinogradConvolution(layer, input, output, scratch);
+        break;
+
+    default:
+    {
+        const void *Weights = layer->halfWeights != NULL ? layer->halfWeights : (const void *)layer->weights;
+        SW_Im2ColConvolution(layer, input, Weights, layer->weightType, output, scratch);
+        break;
+    }
+    }
+}
+
+static double SW_Seconds(void)
+{
+    struct timespec Time;
+    timespec_get(&Time, TIME_UTC);
+
+    return Time.tv_sec + Time.tv_nsec * 1e-9;
+}
+
+// Runs every algorithm that fits on the input and keeps the fastest, the weight copies of the others get freed again
+static void SW_AutotuneConvolution(SW_Layer *layer, const float *input, float *output)
+{
+    SW_Convolution *Convolution = layer->convolution;
+    float *Scratch = SW_ConvolutionAlloc(sizeof(float) * SW_ScratchSize(layer, SW_CONVOLUTION_ALGORITHM_AUTO));
+    SW_ConvolutionAlgorithm Candidates[] = { SW_CONVOLUTION_ALGORITHM_IM2COL, SW_CONVOLUTION_ALGORITHM_DIRECT, SW_CONVOLUTION_ALGORITHM_WINOGRAD };
+    SW_ConvolutionAlgorithm Best = SW_CONVOLUTION_ALGORITHM_IM2COL;
+    double BestTime = 0.0;
+
+    for (uint32_t i = 0; i < sizeof(Candidates) / sizeof(Candidates[0]); i++)
+    {
+        if (Candidates[i] == SW_CONVOLUTION_ALGORITHM_WINOGRAD && !SW_WinogradFits(layer))
+            continue;
+
+        // The first run makes the weight copies, that shouldn't count
+        SW_RunConvolution(layer, Candidates[i], input, output, Scratch);
+
+        double Time = 0.0;
+        for (uint32_t r = 0; r < SW_AUTOTUNE_RUNS; r++)
+        {
+            double Start = SW_Seconds();
+            SW_RunConvolution(layer, Candidates[i], input, output, Scratch);
+            double Elapsed = SW_Seconds() - Start;
+
+            if (r == 0 || Elapsed < Time)
+                Time = Elapsed;
+        }
+
+        if (i == 0 || Time < BestTime)
+        {
+            Best = Candidates[i];
+            BestTime = Time;
+        }
+    }
+
+    free(Scratch);
+
+    Convolution->algorithm = Best;
+
+    if (Best != SW_CONVOLUTION_ALGORITHM_DIRECT)
+    {
+        free(Convolution->blockedWeights);
+        Convolution->blockedWeights = NULL;
+    }
+    if (Best != SW_CONVOLUTION_ALGORITHM_WINOGRAD)
+    {
+        free(Convolution->winogradWeights);
+        Convolution->winogradWeights = NULL;
+    }
+
+    // Sized for every algorithm until now
+    free(Convolution->scratch);
+    Convolution->scratch = NULL;
+}
+
+void SW_ExecuteConvolution(SW_Layer *layer, const float *input, float *output)
+{
+    SW_Convolution *Convolution = layer->convolution;
+
+    if (Convolution->algorithm == SW_CONVOLUTION_ALGORITHM_AUTO)
+        SW_AutotuneConvolution(layer, input, output);
+
+    if (Convolution->scratch == NULL)
+        Convolution->scratch = SW_ConvolutionAlloc(sizeof(float) * SW_ScratchSize(layer, Convolution->algorithm));
+
+    SW_RunConvolution(layer, Convolution->algorithm, input, output, Convolution->scratch);
+}
+
+// Tunes on a made up image, the timings don't depend on the values, and makes the weight copies of the algorithm
+static void SW_PrepareConvolution(SW_Layer *layer)
+{
+    SW_Convolution *Convolution = layer->convolution;
+
+    if (Convolution->algorithm == SW_CONVOLUTION_ALGORITHM_AUTO)
+    {
+        float *Input = calloc((size_t)Convolution->inputChannels * Convolution->inputHeight * Convolution->inputWidth, sizeof(float));
+        float *Output = SW_ConvolutionAlloc(sizeof(float) * layer->neuronAmount);
+        if (Input == NULL)
+        {
+            fputs("Please get better RAM", stderr);
+            abort();
+        }
+
+        SW_AutotuneConvolution(layer, Input, Output);
+
+        free(Input);
+        free(Output);
+    }
+
+    if (Convolution->algorithm == SW_CONVOLUTION_ALGORITHM_DIRECT && Convolution->blockedWeights == NULL)
+        SW_BlockWeights(layer);
+    if (Convolution->algorithm == SW_CONVOLUTION_ALGORITHM_WINOGRAD && Convolution->winogradWeights == NULL)
+        SW_WinogradTransformWeights(layer);
+}
+
+// Training goes one image at a time, each image already is a whole gemm, the float input stays in the workspace for backward
+static void SW_ConvolutionForwardBatch(SW_Layer *layer, SW_LayerBatch *batch)
+{
+    uint32_t InputAmount = layer->convolution->inputChannels * layer->convolution->inputHeight * layer->convolution->inputWidth;
+
+    // Inference gets the autotuned algorithm and nothing to keep for backward
+    // Once the layer is prepared this only reads it, the scratch is in the workspace, so threads with a workspace each can share it
+    if (batch->inference)
+    {
+        SW_PrepareConvolution(layer);
+
+        for (uint32_t b = 0; b < batch->batchSize; b++)
+        {
+            float *Output = &batch->output[(size_t)b * layer->neuronAmount];
+
+            SW_RunConvolution(layer, layer->convolution->algorithm, &((const float *)batch->input)[(size_t)b * InputAmount], Output, batch->workspace);
+            SW_BiasAndActivate(layer, Output);
+        }
+
+        return;
+    }
+
+    float *Input = batch->workspace;
+
+    SWM_convertToFloat(batch->input, batch->type, Input, (size_t)batch->batchSize * InputAmount);
+
+    for (uint32_t b = 0; b < batch->batchSize; b++)
+    {
+        float *Output = &batch->output[(size_t)b * layer->neuronAmount];
+
+        SW_ConvolutionForward(layer, &Input[(size_t)b * InputAmount], batch->weights, batch->weightType, Output);
+        SW_BiasAndActivate(layer, Output);
+    }
+}
+
+static void SW_ConvolutionBackwardBatch(SW_Layer *layer, SW_LayerBatch *batch)
+{
+    uint32_t InputAmount = layer->convolution->inputChannels * layer->convolution->inputHeight * layer->convolution->inputWidth;
+    const float *Input = batch->workspace;
+
+    memset(batch->weightGradient, 0, sizeof(float) * layer->weightRows * layer->weightColumns);
+
+    for (uint32_t b = 0; b < batch->batchSize; b++)
+        SW_ConvolutionBackward(layer, &Input[(size_t)b * InputAmount], &batch->outputErrorFloat[(size_t)b * layer->neuronAmount], batch->weights, batch->weightType, batch->gradientScale, batch->weightGradient, batch->inputError != NULL ? &batch->inputError[(size_t)b * InputAmount] : NULL);
+
+    SW_BiasGradient(layer, batch);
+}
+
+static void SW_ConvolutionExecute(SW_Network *network, uint32_t layerIndex)
+{
+    SW_Layer *CurrentLayer = &network->layers[layerIndex];
+    float *Input = SW_GatherLayerInput(network, layerIndex);
+    float *Output = Input + network->layers[layerIndex - 1].neuronAmount;
+
+    SW_ExecuteConvolution(CurrentLayer, Input, Output);
+    SW_BiasAndActivate(CurrentLayer, Output);
+    SW_SetLayerOutput(CurrentLayer, Output);
+}
+
+static size_t SW_ConvolutionWorkspaceSize(SW_Layer *layer, uint32_t batchSize)
+{
+    return sizeof(float) * batchSize * layer->convolution->inputChannels * layer->convolution->inputHeight * layer->convolution->inputWidth;
+}
+
+// One image at a time, with room for the autotuner's pick if it didn't run yet
+static size_t SW_ConvolutionInferenceWorkspaceSize(SW_Layer *layer, uint32_t batchSize)
+{
+    (void)batchSize;
+
+    return sizeof(float) * SW_ScratchSize(layer, layer->convolution->algorithm);
+}
+
+static size_t SW_ConvolutionSave(SW_Layer *layer, void *settings)
+{
+    uint32_t Kernel[3] = { layer->convolution->kernelSize, layer->convolution->stride, layer->convolution->padding };
+    if (settings != NULL)
+        memcpy(settings, Kernel, sizeof(Kernel));
+
+    return sizeof(Kernel);
+}
+
+static void SW_ConvolutionLoad(SW_Network *network, uint32_t neuronAmount, SW_ActivationFunction activationFunction, const uint32_t shape[3], FILE *file)
+{
+    (void)neuronAmount;
+
+    uint32_t Kernel[3] = { 0, 0, 0 };
+    fread(Kernel, sizeof(uint32_t), 3, file);
+
+    SW_AddNetworkConvolutionLayer(network, shape[0], Kernel[0], Kernel[1], Kernel[2], activationFunction);
+}
+
+const SW_LayerInterface SW_ConvolutionLayerInterface =
+{
+    .forwardBatch = SW_ConvolutionForwardBatch,
+    .backwardBatch = SW_ConvolutionBackwardBatch,
+    .execute = SW_ConvolutionExecute,
+    .params = SW_WeightLayerParams,
+    .workspaceSize = SW_ConvolutionWorkspaceSize,
+    .inferenceWorkspaceSize = SW_ConvolutionInferenceWorkspaceSize,
+    .prepare = SW_PrepareConvolution,
+    .save = SW_ConvolutionSave,
+    .load = SW_ConvolutionLoad,
+    .free = SW_FreeConvolution
+};
@@ -0,0 +1,32 @@
+#ifndef SW_CONVOLUTION_H
+#define SW_CONVOLUTION_H
+
+#include <stdint.h>
+
+#include "SW_types.h"
+#include "SW_matrix.h"
+
+// Training does convolutions as im2col, one matrix with a column per output pixel, times the weights through the shared gemm
+// Execution can also use a direct kernel or winograd, which don't need the (kernel area times larger than the image) im2col buffer
+// Images are in channels x height x width order, for a single image at a time
+
+extern const SW_LayerInterface SW_ConvolutionLayerInterface;
+
+void SW_FreeConvolution(SW_Layer *layer);
+
+// Forces an algorithm instead of letting the first execution time them, falls back to im2col when the layer doesn't fit it
+void SW_SetConvolutionAlgorithm(SW_Layer *layer, SW_ConvolutionAlgorithm algorithm);
+
+// Has to be called after the float weights change, the blocked and winograd copies are remade on the next execution
+void SW_ResetConvolutionWeights(SW_Layer *layer);
+
+// The inference path, output gets the convolution without the bias and activation
+void SW_ExecuteConvolution(SW_Layer *layer, const float *input, float *output);
+
+// Always im2col, with the weights in any type, output gets the convolution without the bias and activation
+void SW_ConvolutionForward(SW_Layer *layer, const float *input, const void *weights, SWM_Type weightType, float *output);
+
+// Adds scale times the weight gradient to weightGradient, and writes the error of the input to inputError unless it's NULL (col2im)
+void SW_ConvolutionBackward(SW_Layer *layer, const float *input, const float *outputError, const void *weights, SWM_Type weightType, float scale, float *weightGradient, float *inputError);
+
+#endif // SW_CONVOLUTION_H
@@ -0,0 +1,101 @@
+#include "SW_dense.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "SW_types.h"
+#include "SW_network.h"
+#include "SW_layer.h"
+#include "SW_matrix.h"
+#include "SW_quantize.h"
+
+static void SW_DenseForwardBatch(SW_Layer *layer, SW_LayerBatch *batch)
+{
+    uint32_t NeuronAmount = layer->neuronAmount;
+    uint32_t InputAmount = layer->weightColumns;
+
+    // Same for the int8 weights, their scratch is in the inference workspace and the bias and activation come with requantizing
+    if (batch->inference && layer->quantized != NULL)
+    {
+        SW_ExecuteQuantizedBatch(layer, batch->input, batch->output, batch->batchSize, batch->workspace);
+        return;
+    }
+
+    // The sparse copy is of the float weights, training always brings its own weights so it can't use it
+    if (batch->inference && layer->sparseWeights != NULL)
+        SWM_spmm(batch->batchSize, batch->input, InputAmount, layer->sparseWeights, batch->output, NeuronAmount);
+    else
+        SWM_gemm(false, true, batch->batchSize, NeuronAmount, InputAmount, 1.0f, batch->input, batch->type, InputAmount, batch->weights, batch->weightType, InputAmount, 0.0f, batch->output, NeuronAmount);
+
+    SW_BiasAndActivateBatch(layer, batch->output, batch->batchSize);
+}
+
+static void SW_DenseBackwardBatch(SW_Layer *layer, SW_LayerBatch *batch)
+{
+    uint32_t NeuronAmount = layer->neuronAmount;
+    uint32_t InputAmount = layer->weightColumns;
+
+    SWM_gemm(true, false, NeuronAmount, InputAmount, batch->batchSize, batch->gradientScale, batch->outputError, batch->type, NeuronAmount, batch->input, batch->type, InputAmount, 0.0f, batch->weightGradient, InputAmount);
+
+    SW_BiasGradient(layer, batch);
+
+    if (batch->inputError != NULL)
+        SWM_gemm(false, false, batch->batchSize, InputAmount, NeuronAmount, 1.0f, batch->outputError, batch->type, NeuronAmount, batch->weights, batch->weightType, InputAmount, 0.0f, batch->inputError, InputAmount);
+}
+
+static void SW_DenseExecute(SW_Network *network, uint32_t layerIndex)
+{
+    SW_Layer *PreviousLayer = &network->layers[layerIndex - 1];
+    SW_Layer *CurrentLayer = &network->layers[layerIndex];
+
+    if (CurrentLayer->quantized != NULL)
+    {
+        SW_ExecuteQuantizedLayer(PreviousLayer, CurrentLayer, layerIndex + 1 < network->layerAmount ? &network->layers[layerIndex + 1] : NULL);
+        return;
+    }
+
+    // Gather the previous outputs into one vector so the weights can go through the gemm
+    float *Input = SW_GatherLayerInput(network, layerIndex);
+    float *Output = Input + PreviousLayer->neuronAmount;
+
+    const void *Weights = CurrentLayer->halfWeights != NULL ? CurrentLayer->halfWeights : (const void *)CurrentLayer->weights;
+
+    if (CurrentLayer->sparseWeights != NULL)
+        SWM_spmm(1, Input, PreviousLayer->neuronAmount, CurrentLayer->sparseWeights, Output, CurrentLayer->neuronAmount);
+    else
+        SWM_gemm(false, true, 1, CurrentLayer->neuronAmount, PreviousLayer->neuronAmount, 1.0f, Input, SWM_TYPE_FLOAT32, PreviousLayer->neuronAmount, Weights, CurrentLayer->weightType, PreviousLayer->neuronAmount, 0.0f, Output, CurrentLayer->neuronAmount);
+
+    SW_BiasAndActivate(CurrentLayer, Output);
+    SW_SetLayerOutput(CurrentLayer, Output);
+}
+
+// Only the int8 path needs scratch, the float gemm brings its own
+static size_t SW_DenseInferenceWorkspaceSize(SW_Layer *layer, uint32_t batchSize)
+{
+    return layer->quantized != NULL ? SW_QuantizedWorkspaceSize(layer, batchSize) : 0;
+}
+
+static void SW_DenseLoad(SW_Network *network, uint32_t neuronAmount, SW_ActivationFunction activationFunction, const uint32_t shape[3], FILE *file)
+{
+    (void)file;
+
+    if (network->layerAmount == 0 && shape[1] * shape[2] > 1)
+        SW_AddNetworkImageLayer(network, shape[0], shape[1], shape[2]);
+    else
+        SW_AddNetworkLayer(network, neuronAmount, activationFunction);
+}
+
+const SW_LayerInterface SW_DenseLayerInterface =
+{
+    .forwardBatch = SW_DenseForwardBatch,
+    .backwardBatch = SW_DenseBackwardBatch,
+    .execute = SW_DenseExecute,
+    .params = SW_WeightLayerParams,
+    .workspaceSize = SW_NoLayerWorkspace,
+    .inferenceWorkspaceSize = SW_DenseInferenceWorkspaceSize,
+    .save = NULL,
+    .load = SW_DenseLoad,
+    .free = NULL
+};
@@ -0,0 +1,11 @@
+#ifndef SW_DENSE_H
+#define SW_DENSE_H
+
+#include "SW_types.h"
+
+// Fully connected layers, every neuron has a weight for every output of the previous layer
+// Image layers are dense too, they're only ever the input layer so they never run
+
+extern const SW_LayerInterface SW_DenseLayerInterface;
+
+#endif // SW_DENSE_H
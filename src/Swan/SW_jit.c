@@ -0,0 +1,458 @@
+#include "SW_jit.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "SW_types.h"
+#include "SW_util.h"
+#include "SW_network.h"
+
+// Needs mmap for the executable memory and the System V calling convention
+#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__))
+#define SW_JIT
+#include <sys/mman.h>
+#endif
+
+#ifdef SW_JIT
+
+// Base registers for memory operands, RIP isn't a real register number, it addresses the data after the code
+#define SW_JIT_RBX 3
+#define SW_JIT_RSP 4
+#define SW_JIT_R12 12
+#define SW_JIT_RIP 16
+
+// ymm registers, the ones below SW_JIT_ACCUMULATORS add up the outputs
+#define SW_JIT_ACCUMULATORS 12
+#define SW_JIT_MASK 13
+#define SW_JIT_ZERO 14
+#define SW_JIT_BROADCAST 15
+
+// Output blocks of 8 that share one broadcast of an input, the accumulators left over split the inputs so the fma chains are shorter
+#define SW_JIT_GROUP_BLOCKS 4
+#define SW_JIT_MAX_SPLITS 4
+
+typedef struct SW_JitBuffer
+{
+    uint8_t *bytes;
+    size_t size, capacity;
+} SW_JitBuffer;
+
+// A RIP relative displacement, filled in once the data has its place after the code
+typedef struct SW_JitFixup
+{
+    size_t position;        // Where the displacement is in the code
+    size_t end;             // The end of the instruction, the displacement counts from there
+    size_t dataOffset;
+} SW_JitFixup;
+
+typedef struct SW_Jit
+{
+    SW_JitBuffer code;
+    SW_JitBuffer data;
+    SW_JitBuffer fixups;
+} SW_Jit;
+
+static void SW_JitAppend(SW_JitBuffer *buffer, const void *bytes, size_t size)
+{
+    if (size == 0)
+        return;
+
+    if (buffer->size + size > buffer->capacity)
+    {
+        buffer->capacity = (buffer->size + size) * 2;
+        buffer->bytes = realloc(buffer->bytes, buffer->capacity);
+        if (buffer->bytes == NULL)
+        {
+            fputs("Compiling your network ate all your memory", stderr);
+            abort();
+        }
+    }
+
+    memcpy(buffer->bytes + buffer->size, bytes, size);
+    buffer->size += size;
+}
+
+static void SW_JitByte(SW_Jit *jit, uint8_t byte)
+{
+    SW_JitAppend(&jit->code, &byte, 1);
+}
+
+static void SW_JitInt32(SW_Jit *jit, int32_t value)
+{
+    SW_JitAppend(&jit->code, &value, sizeof(int32_t));
+}
+
+// Adds constants after the code, 32 byte aligned so the loads don't split cache lines, returns where they start
+static size_t SW_JitData(SW_Jit *jit, const void *values, size_t size)
+{
+    static const uint8_t Zeroes[32] = { 0 };
+    SW_JitAppend(&jit->data, Zeroes, (32 - jit->data.size % 32) % 32);
+
+    size_t Offset = jit->data.size;
+    SW_JitAppend(&jit->data, values, size);
+
+    return Offset;
+}
+
+// Three byte VEX prefix for a 256 bit instruction, map 1 is 0F and map 2 is 0F38, pp 1 is a 66 prefix
+static void SW_JitVex(SW_Jit *jit, uint8_t map, uint8_t pp, uint8_t reg, uint8_t vvvv, uint8_t rm, uint8_t opcode)
+{
+    uint8_t B = rm < SW_JIT_RIP ? rm >> 3 : 0;
+
+    SW_JitByte(jit, 0xC4);
+    SW_JitByte(jit, (uint8_t)(!(reg >> 3) << 7 | 1 << 6 | !B << 5 | map));
+    SW_JitByte(jit, (uint8_t)((~vvvv & 15) << 3 | 1 << 2 | pp));
+    SW_JitByte(jit, opcode);
+}
+
+// ModRM for [base + displacement], for RIP the displacement is an offset into the data
+static void SW_JitMemory(SW_Jit *jit, uint8_t reg, uint8_t base, size_t displacement)
+{
+    if (base == SW_JIT_RIP)
+    {
+        SW_JitByte(jit, (uint8_t)((reg & 7) << 3 | 5));
+
+        SW_JitFixup Fixup = { jit->code.size, jit->code.size + 4, displacement };
+        SW_JitAppend(&jit->fixups, &Fixup, sizeof(SW_JitFixup));
+
+        SW_JitInt32(jit, 0);
+        return;
+    }
+
+    SW_JitByte(jit, (uint8_t)(0x80 | (reg & 7) << 3 | (base & 7)));
+
+    // RSP and R12 as a base always need a SIB byte
+    if ((base & 7) == 4)
+        SW_JitByte(jit, 0x24);
+
+    SW_JitInt32(jit, (int32_t)displacement);
+}
+
+// vmovups ymm, [base + displacement]
+static void SW_JitLoad(SW_Jit *jit, uint8_t ymm, uint8_t base, size_t displacement)
+{
+    SW_JitVex(jit, 1, 0, ymm, 0, base, 0x10);
+    SW_JitMemory(jit, ymm, base, displacement);
+}
+
+// vmovups [base + displacement], ymm
+static void SW_JitStore(SW_Jit *jit, uint8_t base, size_t displacement, uint8_t ymm)
+{
+    SW_JitVex(jit, 1, 0, ymm, 0, base, 0x11);
+    SW_JitMemory(jit, ymm, base, displacement);
+}
+
+// vmaskmovps [base + displacement], mask, ymm
+static void SW_JitMaskStore(SW_Jit *jit, uint8_t base, size_t displacement, uint8_t mask, uint8_t ymm)
+{
+    SW_JitVex(jit, 2, 1, ymm, mask, base, 0x2E);
+    SW_JitMemory(jit, ymm, base, displacement);
+}
+
+// vbroadcastss ymm, [base + displacement]
+static void SW_JitBroadcast(SW_Jit *jit, uint8_t ymm, uint8_t base, size_t displacement)
+{
+    SW_JitVex(jit, 2, 1, ymm, 0, base, 0x18);
+    SW_JitMemory(jit, ymm, base, displacement);
+}
+
+// vfmadd231ps destination, source, [base + displacement]
+static void SW_JitFma(SW_Jit *jit, uint8_t destination, uint8_t source, uint8_t base, size_t displacement)
+{
+    SW_JitVex(jit, 2, 1, destination, source, base, 0xB8);
+    SW_JitMemory(jit, destination, base, displacement);
+}
+
+// vxorps, vaddps or vmaxps on registers, destination = a op b
+#define SW_JIT_XOR 0x57
+#define SW_JIT_ADD 0x58
+#define SW_JIT_MAX 0x5F
+
+static void SW_JitOperation(SW_Jit *jit, uint8_t opcode, uint8_t destination, uint8_t a, uint8_t b)
+{
+    SW_JitVex(jit, 1, 0, destination, a, b, opcode);
+    SW_JitByte(jit, (uint8_t)(0xC0 | (destination & 7) << 3 | (b & 7)));
+}
+
+static void SW_JitActivate(float *values, uint32_t amount, uint32_t activationFunction)
+{
+    for (uint32_t i = 0; i < amount; i++)
+        values[i] = SW_ApplyActivation(values[i], activationFunction);
+}
+
+// Activations without a single instruction for them go through SW_JitActivate on the outputs in the stack frame
+static void SW_JitCallActivate(SW_Jit *jit, size_t outputOffset, uint32_t amount, uint32_t activationFunction)
+{
+    static const uint8_t VzeroUpper[3] = { 0xC5, 0xF8, 0x77 };
+    static const uint8_t LeaRdi[4] = { 0x48, 0x8D, 0xBC, 0x24 };   // lea rdi, [rsp + disp32]
+    static const uint8_t MovRax[2] = { 0x48, 0xB8 };               // mov rax, imm64
+    static const uint8_t CallRax[2] = { 0xFF, 0xD0 };
+
+    void (*Function)(float *, uint32_t, uint32_t) = SW_JitActivate;
+    uint64_t Address = (uint64_t)(uintptr_t)Function;
+
+    SW_JitAppend(&jit->code, VzeroUpper, 3);
+    SW_JitAppend(&jit->code, LeaRdi, 4);
+    SW_JitInt32(jit, (int32_t)outputOffset);
+    SW_JitByte(jit, 0xBE);                                         // mov esi, imm32
+    SW_JitInt32(jit, (int32_t)amount);
+    SW_JitByte(jit, 0xBA);                                         // mov edx, imm32
+    SW_JitInt32(jit, (int32_t)activationFunction);
+    SW_JitAppend(&jit->code, MovRax, 2);
+    SW_JitAppend(&jit->code, &Address, 8);
+    SW_JitAppend(&jit->code, CallRax, 2);
+}
+
+static bool SW_JitBlockUsed(const float *weights, uint32_t outputs, uint32_t input, uint32_t block)
+{
+    for (uint32_t i = 0; i < 8; i++)
+        if (weights[((size_t)input * ((outputs + 7) / 8) + block) * 8 + i] != 0.0f)
+            return true;
+
+    return false;
+}
+
+// Eight outputs per ymm register, every input gets broadcast once per group of blocks and multiplied with the weights straight from memory
+static void SW_JitDenseLayer(SW_Jit *jit, const SW_Layer *layer, uint8_t inputBase, size_t inputOffset, size_t outputOffset)
+{
+    uint32_t Inputs = layer->weightColumns;
+    uint32_t Outputs = layer->neuronAmount;
+    uint32_t Blocks = (Outputs + 7) / 8;
+
+    // The biases and the transposed weights, padded to whole blocks with zeroes
+    float *Biases = calloc((size_t)Blocks * 8, sizeof(float));
+    float *Weights = calloc((size_t)Inputs * Blocks * 8, sizeof(float));
+    if (Biases == NULL || Weights == NULL)
+    {
+        fputs("Compiling your network ate all your memory", stderr);
+        abort();
+    }
+
+    memcpy(Biases, layer->biases, sizeof(float) * Outputs);
+    for (uint32_t o = 0; o < Outputs; o++)
+        for (uint32_t i = 0; i < Inputs; i++)
+            Weights[(size_t)i * Blocks * 8 + o] = layer->weights[(size_t)o * Inputs + i];
+
+    size_t BiasOffset = SW_JitData(jit, Biases, sizeof(float) * Blocks * 8);
+    size_t WeightOffset = SW_JitData(jit, Weights, sizeof(float) * Inputs * Blocks * 8);
+
+    SW_JitOperation(jit, SW_JIT_XOR, SW_JIT_ZERO, SW_JIT_ZERO, SW_JIT_ZERO);
+
+    for (uint32_t Group = 0; Group < Blocks; Group += SW_JIT_GROUP_BLOCKS)
+    {
+        uint32_t GroupBlocks = Blocks - Group < SW_JIT_GROUP_BLOCKS ? Blocks - Group : SW_JIT_GROUP_BLOCKS;
+        uint32_t Splits = SW_JIT_ACCUMULATORS / GroupBlocks < SW_JIT_MAX_SPLITS ? SW_JIT_ACCUMULATORS / GroupBlocks : SW_JIT_MAX_SPLITS;
+
+        for (uint32_t b = 0; b < GroupBlocks; b++)
+        {
+            SW_JitLoad(jit, b, SW_JIT_RIP, BiasOffset + (size_t)(Group + b) * 32);
+
+            for (uint32_t s = 1; s < Splits; s++)
+                SW_JitOperation(jit, SW_JIT_XOR, s * GroupBlocks + b, s * GroupBlocks + b, s * GroupBlocks + b);
+        }
+
+        // Fully unrolled, blocks of weights that were pruned away don't get any code at all
+        uint32_t Split = 0;
+        for (uint32_t i = 0; i < Inputs; i++)
+        {
+            bool Used = false;
+            for (uint32_t b = 0; b < GroupBlocks && !Used; b++)
+                Used = SW_JitBlockUsed(Weights, Outputs, i, Group + b);
+
+            if (!Used) continue;
+
+            SW_JitBroadcast(jit, SW_JIT_BROADCAST, inputBase, inputOffset + (size_t)i * sizeof(float));
+
+            for (uint32_t b = 0; b < GroupBlocks; b++)
+                if (SW_JitBlockUsed(Weights, Outputs, i, Group + b))
+                    SW_JitFma(jit, Split * GroupBlocks + b, SW_JIT_BROADCAST, SW_JIT_RIP, WeightOffset + ((size_t)i * Blocks + Group + b) * 32);
+
+            Split = (Split + 1) % Splits;
+        }
+
+        for (uint32_t b = 0; b < GroupBlocks; b++)
+        {
+            for (uint32_t s = 1; s < Splits; s++)
+                SW_JitOperation(jit, SW_JIT_ADD, b, b, s * GroupBlocks + b);
+
+            if (layer->activationFunction == SW_ACTIVATION_FUNCTION_RELU)
+                SW_JitOperation(jit, SW_JIT_MAX, b, b, SW_JIT_ZERO);
+
+            SW_JitStore(jit, SW_JIT_RSP, outputOffset + (size_t)(Group + b) * 32, b);
+        }
+    }
+
+    if (layer->activationFunction == SW_ACTIVATION_FUNCTION_SIGMOID || layer->activationFunction == SW_ACTIVATION_FUNCTION_TANH)
+        SW_JitCallActivate(jit, outputOffset, Outputs, layer->activationFunction);
+
+    free(Biases);
+    free(Weights);
+}
+
+bool SW_CompileNetwork(SW_Network *network)
+{
+    SW_FreeCompiledNetwork(network);
+
+    // The code it writes is AVX2 with FMA, so it goes along with whatever the kernels picked, SWAN_ISA included
+    if (strcmp(SWM_kernelName(), "generic") == 0 || network->layerAmount < 2)
+        return false;
+
+    size_t WeightAmount = 0;
+    uint32_t WidestBlocks = 1;
+
+    for (uint32_t i = 1; i < network->layerAmount; i++)
+    {
+        SW_Layer *CurrentLayer = &network->layers[i];
+
+        // Quantized layers would give different outputs than the generic path
+        if (CurrentLayer->type != SW_LAYER_TYPE_DENSE || CurrentLayer->weights == NULL || CurrentLayer->quantized != NULL)
+            return false;
+
+        WeightAmount += (size_t)CurrentLayer->weightRows * CurrentLayer->weightColumns;
+        if ((CurrentLayer->neuronAmount + 7) / 8 > WidestBlocks)
+            WidestBlocks = (CurrentLayer->neuronAmount + 7) / 8;
+    }
+
+    if (WeightAmount > SW_JIT_MAX_WEIGHTS)
+        return false;
+
+    // The stack frame has two buffers the layers take turns on
+    size_t BufferSize = (size_t)WidestBlocks * 32;
+    int32_t FrameSize = (int32_t)(2 * BufferSize);
+
+    SW_Jit Jit = { { NULL, 0, 0 }, { NULL, 0, 0 }, { NULL, 0, 0 } };
+
+    // push rbx, push r12, push r13 (keeps the stack 16 byte aligned for calls), mov rbx, rdi (input), mov r12, rsi (output), sub rsp, frame
+    static const uint8_t Prologue[13] = { 0x53, 0x41, 0x54, 0x41, 0x55, 0x48, 0x89, 0xFB, 0x49, 0x89, 0xF4, 0x48, 0x81 };
+    SW_JitAppend(&Jit.code, Prologue, sizeof(Prologue));
+    SW_JitByte(&Jit, 0xEC);
+    SW_JitInt32(&Jit, FrameSize);
+
+    for (uint32_t i = 1; i < network->layerAmount; i++)
+    {
+        uint8_t InputBase = i == 1 ? SW_JIT_RBX : SW_JIT_RSP;
+        size_t InputOffset = i == 1 ? 0 : ((i - 1) % 2) * BufferSize;
+
+        SW_JitDenseLayer(&Jit, &network->layers[i], InputBase, InputOffset, (i % 2) * BufferSize);
+    }
+
+    // Copy the outputs of the last layer to the caller, the partial block at the end with a mask so nothing past the output gets written
+    SW_Layer *LastLayer = &network->layers[network->layerAmount - 1];
+    size_t LastOffset = ((network->layerAmount - 1) % 2) * BufferSize;
+
+    for (uint32_t b = 0; b < (LastLayer->neuronAmount + 7) / 8; b++)
+    {
+        SW_JitLoad(&Jit, 0, SW_JIT_RSP, LastOffset + (size_t)b * 32);
+
+        if (b * 8 + 8 <= LastLayer->neuronAmount)
+        {
+            SW_JitStore(&Jit, SW_JIT_R12, (size_t)b * 32, 0);
+            continue;
+        }
+
+        int32_t Mask[8];
+        for (uint32_t j = 0; j < 8; j++)
+            Mask[j] = b * 8 + j < LastLayer->neuronAmount ? -1 : 0;
+
+        SW_JitLoad(&Jit, SW_JIT_MASK, SW_JIT_RIP, SW_JitData(&Jit, Mask, sizeof(Mask)));
+        SW_JitMaskStore(&Jit, SW_JIT_R12, (size_t)b * 32, SW_JIT_MASK, 0);
+    }
+
+    // add rsp, frame, pop r13, pop r12, pop rbx, vzeroupper, ret
+    static const uint8_t AddRsp[3] = { 0x48, 0x81, 0xC4 };
+    static const uint8_t Epilogue[9] = { 0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC5, 0xF8, 0x77, 0xC3 };
+    SW_JitAppend(&Jit.code, AddRsp, sizeof(AddRsp));
+    SW_JitInt32(&Jit, FrameSize);
+    SW_JitAppend(&Jit.code, Epilogue, sizeof(Epilogue));
+
+    // The data goes right after the code, never writable and executable at the same time
+    size_t DataStart = (Jit.code.size + 63) / 64 * 64;
+    size_t Size = DataStart + Jit.data.size;
+
+    uint8_t *Memory = mmap(NULL, Size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    bool Worked = Memory != MAP_FAILED;
+
+    if (Worked)
+    {
+        memcpy(Memory, Jit.code.bytes, Jit.code.size);
+        memcpy(Memory + DataStart, Jit.data.bytes, Jit.data.size);
+
+        const SW_JitFixup *Fixups = (const SW_JitFixup *)Jit.fixups.bytes;
+        for (size_t i = 0; i < Jit.fixups.size / sizeof(SW_JitFixup); i++)
+        {
+            int32_t Displacement = (int32_t)(DataStart + Fixups[i].dataOffset - Fixups[i].end);
+            memcpy(Memory + Fixups[i].position, &Displacement, sizeof(int32_t));
+        }
+
+        Worked = mprotect(Memory, Size, PROT_READ | PROT_EXEC) == 0;
+        if (!Worked)
+            munmap(Memory, Size);
+    }
+
+    free(Jit.code.bytes);
+    free(Jit.data.bytes);
+    free(Jit.fixups.bytes);
+
+    if (!Worked)
+    {
+        fputs("This system won't let Swan run its own code, using the normal path", stderr);
+        return false;
+    }
+
+    network->compiled = malloc(sizeof(SW_CompiledNetwork));
+    if (network->compiled == NULL)
+    {
+        fputs("Please get better RAM", stderr);
+        abort();
+    }
+
+    network->compiled->memory = Memory;
+    network->compiled->size = Size;
+    network->compiled->execute = (void (*)(const float *, float *))(void *)Memory;
+
+    return true;
+}
+
+void SW_FreeCompiledNetwork(SW_Network *network)
+{
+    if (network->compiled == NULL)
+        return;
+
+    munmap(network->compiled->memory, network->compiled->size);
+    free(network->compiled);
+    network->compiled = NULL;
+}
+
+#else
+
+bool SW_CompileNetwork(SW_Network *network)
+{
+    (void)network;
+    return false;
+}
+
+void SW_FreeCompiledNetwork(SW_Network *network)
+{
+    free(network->compiled);
+    network->compiled = NULL;
+}
+
+#endif // SW_JIT
+
+void SW_ExecuteCompiledNetwork(SW_Network *network, const float *input, float *output)
+{
+    if (network->compiled != NULL)
+    {
+        network->compiled->execute(input, output);
+        return;
+    }
+
+    SW_SetNetworkInput(network, (float *)input);
+    SW_ExucuteNetwork(network);
+
+    SW_Layer *LastLayer = &network->layers[network->layerAmount - 1];
+    for (uint32_t i = 0; i < LastLayer->neuronAmount; i++)
+        output[i] = LastLayer->neurons[i].output;
+}
@@ -0,0 +1,20 @@
+#ifndef SW_JIT_H
+#define SW_JIT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "SW_types.h"
+
+// Compiles the forward pass of a small dense network into x86-64 machine code with the weights built in
+// Needs AVX2 and FMA, and only dense layers with SW_JIT_MAX_WEIGHTS weights at most, returns false when it can't
+// The code has the weights of right now, training, pruning or randomizing the network drops it again
+bool SW_CompileNetwork(SW_Network *network);
+void SW_FreeCompiledNetwork(SW_Network *network);
+
+// input has the size of the first layer and output gets the last one, runs the generic path when the network isn't compiled
+void SW_ExecuteCompiledNetwork(SW_Network *network, const float *input, float *output);
+
+#define SW_JIT_MAX_WEIGHTS 131072
+
+#endif // SW_JIT_H
@@ -0,0 +1,135 @@
+#include "SW_layer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "SW_types.h"
+#include "SW_util.h"
+#include "SW_dense.h"
+#include "SW_convolution.h"
+#include "SW_pooling.h"
+#include "SW_parallel.h"
+
+const SW_LayerInterface *SW_GetLayerInterface(SW_LayerType type)
+{
+    switch (type)
+    {
+    case SW_LAYER_TYPE_DENSE:
+        return &SW_DenseLayerInterface;
+
+    case SW_LAYER_TYPE_CONVOLUTION:
+        return &SW_ConvolutionLayerInterface;
+
+    case SW_LAYER_TYPE_POOLING:
+        return &SW_PoolingLayerInterface;
+
+    default:
+        return NULL;
+    }
+}
+
+void SW_BiasAndActivate(SW_Layer *layer, float *values)
+{
+    uint32_t PixelAmount = layer->height * layer->width;
+
+    for (uint32_t c = 0; c < layer->channels; c++)
+    {
+        float Bias = layer->biases[c];
+        float *Channel = &values[(size_t)c * PixelAmount];
+
+        for (uint32_t p = 0; p < PixelAmount; p++)
+            Channel[p] = SW_ApplyActivation(Channel[p] + Bias, layer->activationFunction);
+    }
+}
+
+typedef struct SW_BiasAndActivateTask
+{
+    SW_Layer *layer;
+    float *values;
+} SW_BiasAndActivateTask;
+
+static void SW_BiasAndActivateSamples(void *context, size_t begin, size_t end, uint32_t thread)
+{
+    (void)thread;
+    SW_BiasAndActivateTask *Task = context;
+
+    for (size_t b = begin; b < end; b++)
+        SW_BiasAndActivate(Task->layer, &Task->values[b * Task->layer->neuronAmount]);
+}
+
+void SW_BiasAndActivateBatch(SW_Layer *layer, float *values, uint32_t batchSize)
+{
+    SW_BiasAndActivateTask Task = { layer, values };
+    SWP_parallelFor(0, batchSize, SWP_grainFor((size_t)layer->neuronAmount * SW_ACTIVATION_COST), SW_BiasAndActivateSamples, &Task);
+}
+
+typedef struct SW_BiasGradientTask
+{
+    SW_Layer *layer;
+    SW_LayerBatch *batch;
+} SW_BiasGradientTask;
+
+static void SW_BiasGradientChannels(void *context, size_t begin, size_t end, uint32_t thread)
+{
+    (void)thread;
+    SW_Layer *Layer = ((SW_BiasGradientTask *)context)->layer;
+    SW_LayerBatch *Batch = ((SW_BiasGradientTask *)context)->batch;
+    uint32_t PixelAmount = Layer->height * Layer->width;
+
+    // We can just treat the bias the same as a weight, but of which the previous neuron's output is always 1
+    for (size_t c = begin; c < end; c++)
+    {
+        float Sum = 0.0f;
+        for (uint32_t b = 0; b < Batch->batchSize; b++)
+            for (uint32_t p = 0; p < PixelAmount; p++)
+                Sum += Batch->outputErrorFloat[(size_t)b * Layer->neuronAmount + c * PixelAmount + p];
+
+        Batch->biasGradient[c] = Sum * Batch->gradientScale;
+    }
+}
+
+void SW_BiasGradient(SW_Layer *layer, SW_LayerBatch *batch)
+{
+    // Every channel sums on its own, so splitting them up doesn't change the result
+    SW_BiasGradientTask Task = { layer, batch };
+    SWP_parallelFor(0, layer->channels, SWP_grainFor((size_t)batch->batchSize * layer->height * layer->width), SW_BiasGradientChannels, &Task);
+}
+
+float *SW_GatherLayerInput(SW_Network *network, uint32_t layerIndex)
+{
+    SW_Layer *PreviousLayer = &network->layers[layerIndex - 1];
+    float *Input = network->executionBuffer;
+
+    for (uint32_t k = 0; k < PreviousLayer->neuronAmount; k++)
+        Input[k] = PreviousLayer->neurons[k].output;
+
+    return Input;
+}
+
+void SW_SetLayerOutput(SW_Layer *layer, const float *output)
+{
+    for (uint32_t j = 0; j < layer->neuronAmount; j++)
+        layer->neurons[j].output = output[j];
+}
+
+SW_LayerParams SW_WeightLayerParams(SW_Layer *layer)
+{
+    SW_LayerParams Params = { layer->weights, layer->biases, layer->weightRows, layer->weightColumns };
+    return Params;
+}
+
+SW_LayerParams SW_NoLayerParams(SW_Layer *layer)
+{
+    (void)layer;
+
+    SW_LayerParams Params = { NULL, NULL, 0, 0 };
+    return Params;
+}
+
+size_t SW_NoLayerWorkspace(SW_Layer *layer, uint32_t batchSize)
+{
+    (void)layer;
+    (void)batchSize;
+
+    return 0;
+}
@@ -0,0 +1,33 @@
+#ifndef SW_LAYER_H
+#define SW_LAYER_H
+
+#include <stdint.h>
+
+#include "SW_types.h"
+
+// Shared by the layer implementations, see SW_LayerInterface
+
+const SW_LayerInterface *SW_GetLayerInterface(SW_LayerType type); // NULL for types that don't exist
+
+// Adds the bias of every channel and applies the activation to one sample, a dense layer is just channels of a single pixel
+void SW_BiasAndActivate(SW_Layer *layer, float *values);
+
+// The same for batchSize samples one after the other, spread over the thread pool
+void SW_BiasAndActivateBatch(SW_Layer *layer, float *values, uint32_t batchSize);
+
+// Roughly what an activation costs compared to a multiply add, for splitting work over threads
+#define SW_ACTIVATION_COST 8
+
+// Sums batch->outputErrorFloat over the batch and pixels of every channel into batch->biasGradient
+void SW_BiasGradient(SW_Layer *layer, SW_LayerBatch *batch);
+
+// Copies the outputs of the previous layer's neurons into the execution buffer, the output goes right after them
+float *SW_GatherLayerInput(SW_Network *network, uint32_t layerIndex);
+void SW_SetLayerOutput(SW_Layer *layer, const float *output);
+
+// For layers with a weight matrix, and for layers that train nothing
+SW_LayerParams SW_WeightLayerParams(SW_Layer *layer);
+SW_LayerParams SW_NoLayerParams(SW_Layer *layer);
+size_t SW_NoLayerWorkspace(SW_Layer *layer, uint32_t batchSize);
+
+#endif // SW_LAYER_H
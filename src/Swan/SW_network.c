@@ -1,28 +1,150 @@
 #include "SW_network.h"
 
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <time.h>
 #include <math.h>
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #include "SW_types.h"
 #include "SW_util.h"
 #include "SW_matrix.h"
+#include "SW_quantize.h"
+#include "SW_prune.h"
+#include "SW_layer.h"
+#include "SW_dense.h"
+#include "SW_convolution.h"
+#include "SW_pooling.h"
+#include "SW_workspace.h"
+#include "SW_jit.h"
+#include "SW_parallel.h"
+#include "SW_profile.h"
+#include "SW_trace.h"
+#include "SW_autosave.h"
+
+// Saved networks start with this, older files without it start with the layer amount
+#define SW_FILE_MAGIC 0x4E415753 // "SWAN"
+#define SW_FILE_VERSION 5
+
+// How the weights of a layer are stored in a file
+#define SW_WEIGHT_STORAGE_FLOAT32 0
+#define SW_WEIGHT_STORAGE_INT8 1
+#define SW_WEIGHT_STORAGE_BFLOAT16 2
+#define SW_WEIGHT_STORAGE_FLOAT16 3
+
+// Files for SW_MapNetwork, the weights start on a new page of this size, the biases on a new cache line
+#define SW_MAPPED_FILE_MAGIC 0x504D5753 // "SWMP"
+#define SW_MAPPED_FILE_VERSION 1
+#define SW_MAPPED_PAGE_SIZE 4096
+#define SW_MAPPED_BIAS_ALIGNMENT 64
+
+// Dynamic loss scaling for half precision training
+#define SW_INITIAL_LOSS_SCALE 65536.0f
+#define SW_MAX_LOSS_SCALE 16777216.0f
+#define SW_LOSS_SCALE_GROWTH_INTERVAL 2000
+
+// mapping
+
+// What a mapped file keeps about a layer besides its shape, right after the layer's own settings
+typedef struct SW_MappedLayer
+{
+    uint32_t weightType;        // An SWM_Type, the half precision copy gets made again from the float weights
+    uint32_t quantized;         // So does the int8 version, with these
+    float inputScale;
+    uint32_t inputZeroPoint;
+} SW_MappedLayer;
+
+// The whole file, pages nobody writes to stay shared with every other process mapping it, written ones become private copies
+static void *SW_MapFile(FILE *file, size_t *size)
+{
+#ifdef _WIN32
+    // No sharing here, it's just read in
+    fseek(file, 0, SEEK_END);
+    *size = (size_t)ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    void *Memory = malloc(*size);
+    if (Memory != NULL && fread(Memory, 1, *size, file) != *size)
+    {
+        free(Memory);
+        Memory = NULL;
+    }
+
+    return Memory;
+#else
+    struct stat Stat;
+    if (fstat(fileno(file), &Stat) < 0 || Stat.st_size == 0)
+        return NULL;
+
+    *size = (size_t)Stat.st_size;
+
+    void *Memory = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(file), 0);
+    if (Memory == MAP_FAILED)
+        return NULL;
+
+    // The first execution would fault every page in one by one otherwise
+    madvise(Memory, *size, MADV_WILLNEED);
+
+    return Memory;
+#endif
+}
+
+static void SW_UnmapFile(void *mapping, size_t size)
+{
+    if (mapping == NULL)
+        return;
+
+#ifdef _WIN32
+    (void)size;
+    free(mapping);
+#else
+    munmap(mapping, size);
+#endif
+}
+
+void SW_FreeWeights(SW_Network *network, void *weights)
+{
+    char *Mapping = network->mapping;
+
+    if (Mapping != NULL && (char *)weights >= Mapping && (char *)weights < Mapping + network->mappingSize)
+        return;
+
+    free(weights);
+}
 
 void SW_InitNetwork(SW_Network *network)
 {
     network->layers = malloc(0);
     network->layerAmount = 0;
+    network->executionBuffer = NULL;
+    network->workspace = NULL;
+    network->workspaceSize = 0;
+    network->trainingMemoryBudget = 0;
+    network->checkpointInterval = 1;
+    network->compiled = NULL;
+    network->profile = NULL;
+    network->profileLayerAmount = 0;
+    network->mapping = NULL;
+    network->mappingSize = 0;
+    network->autosave = NULL;
+
+    network->trainingType = SWM_TYPE_FLOAT32;
+    network->lossScale = 1.0f;
+    network->lossScaleGoodSteps = 0;
+
+    SW_SetPruningSchedule(network, 0.0f, SW_PRUNE_SCOPE_GLOBAL, 0);
 }
 
-void SW_AddNetworkLayer(SW_Network *network, uint32_t neuronAmount, SW_ActivationFunction activationFunction)
+// Adds a layer without any weights yet, everything the layer types share
+static SW_Layer *SW_AppendLayer(SW_Network *network, uint32_t neuronAmount, SW_ActivationFunction activationFunction)
 {
-    if (neuronAmount == 0)
-    {
-        fputs("WHAT'S THE POINT OF A NEURAL NETWORK IF IT LITERALLY HAS NO BRAIN? IS IT INSPIRED BY YOURSELF?", stderr);
-        return;
-    }
+    SW_FreeCompiledNetwork(network);
 
     // Actually allocate the layer and its data
     network->layers = realloc(network->layers, (network->layerAmount + 1) * sizeof(SW_Layer));
@@ -36,7 +158,7 @@ void SW_AddNetworkLayer(SW_Network *network, uint32_t neuronAmount, SW_Activatio
 
     SW_Layer *CurrentLayer = &network->layers[network->layerAmount - 1];
 
-    CurrentLayer->neurons = malloc(sizeof(SW_Neuron) * neuronAmount);
+    CurrentLayer->neurons = calloc(neuronAmount, sizeof(SW_Neuron));
     CurrentLayer->neuronAmount = neuronAmount;
 
     if (CurrentLayer->neurons == NULL)
@@ -46,236 +168,343 @@ void SW_AddNetworkLayer(SW_Network *network, uint32_t neuronAmount, SW_Activatio
     }
 
     CurrentLayer->activationFunction = activationFunction;
+    CurrentLayer->type = SW_LAYER_TYPE_DENSE;
+    CurrentLayer->implementation = &SW_DenseLayerInterface;
+    CurrentLayer->channels = neuronAmount;
+    CurrentLayer->height = 1;
+    CurrentLayer->width = 1;
+    CurrentLayer->convolution = NULL;
+    CurrentLayer->pooling = NULL;
+    CurrentLayer->weightRows = 0;
+    CurrentLayer->weightColumns = 0;
+    CurrentLayer->weights = NULL;
+    CurrentLayer->biases = NULL;
+    CurrentLayer->quantized = NULL;
+    CurrentLayer->weightType = SWM_TYPE_FLOAT32;
+    CurrentLayer->halfWeights = NULL;
+    CurrentLayer->pruneMask = NULL;
+    CurrentLayer->sparseWeights = NULL;
+
+    // The execution buffer holds the input and output of a layer, so it has to fit twice the widest layer
+    uint32_t WidestLayer = 0;
+    for (uint32_t i = 0; i < network->layerAmount; i++)
+        if (network->layers[i].neuronAmount > WidestLayer)
+            WidestLayer = network->layers[i].neuronAmount;
 
-    // Allocate the weights and biases for the neuron (if there is a previous layer to have those values for)
-    if (network->layerAmount > 1)
+    network->executionBuffer = realloc(network->executionBuffer, sizeof(float) * 2 * WidestLayer);
+    if (network->executionBuffer == NULL)
     {
-        uint32_t PreviousLayerNeuronAmount = network->layers[network->layerAmount - 2].neuronAmount;
+        fputs("Please get better RAM", stderr);
+        abort();
+    }
 
-        for (uint32_t i = 0; i < neuronAmount; i++)
-        {
-            CurrentLayer->neurons[i].weights = malloc(sizeof(float) * PreviousLayerNeuronAmount);
-            if (CurrentLayer->neurons[i].weights == NULL)
-            {
-                fputs("Everything is going wrong again!", stderr);
-                abort();
-            }
+    return CurrentLayer;
+}
 
-            memset(CurrentLayer->neurons[i].weights, 0, sizeof(float) * PreviousLayerNeuronAmount);
+// One block for the whole layer, so execution can stream it as a single matrix
+static void SW_AllocateLayerWeights(SW_Layer *layer, uint32_t rows, uint32_t columns)
+{
+    layer->weightRows = rows;
+    layer->weightColumns = columns;
 
-            CurrentLayer->neurons[i].bias = 0.0f;
+    layer->weights = calloc((size_t)rows * columns, sizeof(float));
+    layer->biases = calloc(rows, sizeof(float));
 
-            CurrentLayer->neurons[i].output = 0.0f;
-        }
+    if (layer->weights == NULL || layer->biases == NULL)
+    {
+        fputs("Everything is going wrong again!", stderr);
+        abort();
     }
 }
 
-void SW_UnloadNetwork(SW_Network *network)
+void SW_AddNetworkLayer(SW_Network *network, uint32_t neuronAmount, SW_ActivationFunction activationFunction)
 {
-    for (uint32_t i = 0; i < network->layerAmount; i++)
+    if (neuronAmount == 0)
     {
-        if (i > 0)
-        {
-            for (uint32_t j = 0; j < network->layers[i].neuronAmount; j++)
-                free(network->layers[i].neurons[j].weights);
-        }
-
-        free(network->layers[i].neurons);
+        fputs("WHAT'S THE POINT OF A NEURAL NETWORK IF IT LITERALLY HAS NO BRAIN? IS IT INSPIRED BY YOURSELF?", stderr);
+        return;
     }
 
-    free(network->layers);
+    SW_Layer *CurrentLayer = SW_AppendLayer(network, neuronAmount, activationFunction);
+
+    // Allocate the weights and biases for the neuron (if there is a previous layer to have those values for)
+    if (network->layerAmount > 1)
+    {
+        uint32_t PreviousLayerNeuronAmount = network->layers[network->layerAmount - 2].neuronAmount;
+
+        SW_AllocateLayerWeights(CurrentLayer, neuronAmount, PreviousLayerNeuronAmount);
+
+        for (uint32_t i = 0; i < neuronAmount; i++)
+            CurrentLayer->neurons[i].weights = &CurrentLayer->weights[(size_t)i * PreviousLayerNeuronAmount];
+    }
 }
 
-void SW_RandomizeNetwork(SW_Network *network)
+void SW_AddNetworkImageLayer(SW_Network *network, uint32_t channels, uint32_t height, uint32_t width)
 {
-    // Randomize all the weights and biases for each connection
-    srand(time(NULL));
+    if (network->layerAmount != 0)
+    {
+        fputs("An image layer is an input layer, it has to come first", stderr);
+        return;
+    }
 
-    for (uint32_t i = 1; i < network->layerAmount; i++)
-        for (uint32_t j = 0; j < network->layers[i].neuronAmount; j++)
-        {
-            for (uint32_t k = 0; k < network->layers[i - 1].neuronAmount; k++)
-                network->layers[i].neurons[j].weights[k] = ((float)rand() / (float)RAND_MAX) * 2.0f - 1.0f;
+    if (channels == 0 || height == 0 || width == 0)
+    {
+        fputs("An image without pixels, very modern", stderr);
+        return;
+    }
 
-            network->layers[i].neurons[j].bias = ((float)rand() / (float)RAND_MAX) * 2.0f - 1.0f;
-        }
+    SW_Layer *CurrentLayer = SW_AppendLayer(network, channels * height * width, SW_ACTIVATION_FUNCTION_RELU);
+
+    CurrentLayer->channels = channels;
+    CurrentLayer->height = height;
+    CurrentLayer->width = width;
 }
 
-void SW_SetNetworkInput(SW_Network *network, float *input)
+void SW_AddNetworkConvolutionLayer(SW_Network *network, uint32_t channels, uint32_t kernelSize, uint32_t stride, uint32_t padding, SW_ActivationFunction activationFunction)
 {
     if (network->layerAmount == 0)
     {
-        fputs("It's a bit hard to give some input to a completely empty network, isn't it?", stderr);
+        fputs("A convolution needs something to convolve, add an image layer first", stderr);
         return;
     }
 
-    if (input == NULL)
+    SW_Layer *PreviousLayer = &network->layers[network->layerAmount - 1];
+
+    if (channels == 0 || kernelSize == 0 || stride == 0 || PreviousLayer->height + 2 * padding < kernelSize || PreviousLayer->width + 2 * padding < kernelSize)
     {
-        fputs("Would be a shame if the input data for the neural network got corrupted and not allocated, wouldn't it? Oh wait, that's the case.", stderr);
+        fputs("That convolution doesn't fit on its input", stderr);
         return;
     }
 
-    for (uint32_t i = 0; i < network->layers[0].neuronAmount; i++)
-        network->layers[0].neurons[i].output = input[i];
+    SW_Convolution *Convolution = malloc(sizeof(SW_Convolution));
+    if (Convolution == NULL)
+    {
+        fputs("Please get better RAM", stderr);
+        abort();
+    }
+
+    Convolution->kernelSize = kernelSize;
+    Convolution->stride = stride;
+    Convolution->padding = padding;
+    Convolution->inputChannels = PreviousLayer->channels;
+    Convolution->inputHeight = PreviousLayer->height;
+    Convolution->inputWidth = PreviousLayer->width;
+
+    Convolution->algorithm = SW_CONVOLUTION_ALGORITHM_AUTO;
+    Convolution->columns = NULL;
+    Convolution->columnErrors = NULL;
+    Convolution->blockedWeights = NULL;
+    Convolution->winogradWeights = NULL;
+    Convolution->scratch = NULL;
+
+    uint32_t Height = (PreviousLayer->height + 2 * padding - kernelSize) / stride + 1;
+    uint32_t Width = (PreviousLayer->width + 2 * padding - kernelSize) / stride + 1;
+    uint32_t ColumnRows = Convolution->inputChannels * kernelSize * kernelSize;
+
+    SW_Layer *CurrentLayer = SW_AppendLayer(network, channels * Height * Width, activationFunction);
+
+    CurrentLayer->type = SW_LAYER_TYPE_CONVOLUTION;
+    CurrentLayer->implementation = &SW_ConvolutionLayerInterface;
+    CurrentLayer->channels = channels;
+    CurrentLayer->height = Height;
+    CurrentLayer->width = Width;
+    CurrentLayer->convolution = Convolution;
+
+    // One row of weights per output channel, one weight per input channel and kernel position
+    SW_AllocateLayerWeights(CurrentLayer, channels, ColumnRows);
 }
 
-void SW_TrainNeuralNetwork(SW_Network *network, float **input, float **correctOutput, uint32_t dataAmount, uint32_t batchSize, float targetLoss, SW_LossFunction lossFunction)
+void SW_AddNetworkPoolingLayer(SW_Network *network, SW_PoolingType type, uint32_t size, uint32_t stride)
 {
-    // Let's start simple with only the core of the algorithm for now (back propagation)
-    // That core of the algorithm is taking just one input and its label, and adjusting the weights and biases for that one case
-  
-    // Not finished yet, for now it only works on one image at a time, and half the function arguments are ignored for now
-    // It doesn't seem to work fully yet... Also, it only works with mean squared error for now
-    uint32_t testid = 0;
-    float LearningRate  = 0.2f;
+    if (network->layerAmount == 0)
+    {
+        fputs("Pooling nothing gives you nothing, add an image layer first", stderr);
+        return;
+    }
 
-    SW_SetNetworkInput(network, input[testid]);
-    SW_ExucuteNetwork(network);
+    SW_Layer *PreviousLayer = &network->layers[network->layerAmount - 1];
 
-    // Loop backwards through all the layers
-    for (uint32_t i = network->layerAmount - 1; i > 0; i--)
+    // Global average pooling is a single window over the whole image
+    if (type == SW_POOLING_TYPE_GLOBAL_AVERAGE)
     {
-        SW_Layer *CurrentLayer = &network->layers[i];
-        SW_Layer *PreviousLayer = &network->layers[i - 1];
-        
-        SW_Layer *NextLayer;
+        size = 0;
+        stride = 0;
+    }
+    else if (size == 0 || stride == 0 || size > PreviousLayer->height || size > PreviousLayer->width)
+    {
+        fputs("That pooling window doesn't fit on its input", stderr);
+        return;
+    }
 
-        if (i < network->layerAmount - 1)
-            NextLayer = &network->layers[i + 1];
+    SW_Pooling *Pooling = malloc(sizeof(SW_Pooling));
+    if (Pooling == NULL)
+    {
+        fputs("Please get better RAM", stderr);
+        abort();
+    }
 
-        for (uint32_t j = 0; j < CurrentLayer->neuronAmount; j++)
-        {
-            // Begin with the part of the calculation thas is shared for each weight (how much the neuron influences the error, and the derivative of the activaion function at the output of the neuron)
-            float Error = 0.0f;
+    Pooling->type = type;
+    Pooling->size = size;
+    Pooling->stride = stride;
+    Pooling->inputChannels = PreviousLayer->channels;
+    Pooling->inputHeight = PreviousLayer->height;
+    Pooling->inputWidth = PreviousLayer->width;
 
-            // The error is simple for the last layer, but it's a bit more complicated for any layer before that
-            if (i < network->layerAmount - 1)
-                for (uint32_t h = 0; h < NextLayer->neuronAmount; h++)
-                    Error += NextLayer->neurons[h].error * NextLayer->neurons[h].activationDerivative * NextLayer->neurons[h].weights[j];
-            else
-                Error = -(correctOutput[testid][j] - CurrentLayer->neurons[j].output);
+    uint32_t Height = type == SW_POOLING_TYPE_GLOBAL_AVERAGE ? 1 : (PreviousLayer->height - size) / stride + 1;
+    uint32_t Width = type == SW_POOLING_TYPE_GLOBAL_AVERAGE ? 1 : (PreviousLayer->width - size) / stride + 1;
 
-            // All the derivatives for the different activation functions
-            float ActivationDerivative = 0.0f;
-  
-            switch (CurrentLayer->activationFunction)
-            {
-            case SW_ACTIVATION_FUNCTION_RELU:
-                ActivationDerivative = SW_ReLu_Derivative(CurrentLayer->neurons[j].output);
-                break;
+    SW_Layer *CurrentLayer = SW_AppendLayer(network, Pooling->inputChannels * Height * Width, SW_ACTIVATION_FUNCTION_NONE);
 
-            case SW_ACTIVATION_FUNCTION_SOFTMAX:
-                // unimplemented
-                break;
+    CurrentLayer->type = SW_LAYER_TYPE_POOLING;
+    CurrentLayer->implementation = &SW_PoolingLayerInterface;
+    CurrentLayer->channels = Pooling->inputChannels;
+    CurrentLayer->height = Height;
+    CurrentLayer->width = Width;
+    CurrentLayer->pooling = Pooling;
+}
 
-            case SW_ACTIVATION_FUNCTION_SIGMOID:
-                ActivationDerivative = SW_Sigmoid_Derivative(CurrentLayer->neurons[j].output); 
-                break;
+void SW_UnloadNetwork(SW_Network *network)
+{
+    SW_StopAutosave(network);
 
-            case SW_ACTIVATION_FUNCTION_TANH:
-                ActivationDerivative = SW_Tanh_Derivative(CurrentLayer->neurons[j].output);
-                break;
+    for (uint32_t i = 0; i < network->layerAmount; i++)
+    {
+        SW_FreeQuantizedLayer(&network->layers[i]);
+        SW_FreeLayerSparsity(&network->layers[i]);
+        if (network->layers[i].implementation->free != NULL)
+            network->layers[i].implementation->free(&network->layers[i]);
+        free(network->layers[i].halfWeights);
+        SW_FreeWeights(network, network->layers[i].weights);
+        SW_FreeWeights(network, network->layers[i].biases);
+        free(network->layers[i].neurons);
+    }
 
-            default:
-                fputs("Uh oh there's no activation function here", stderr);
-                break;
-            }
+    free(network->layers);
+    free(network->executionBuffer);
+    SW_FreeCompiledNetwork(network);
+    SW_ResetProfile(network);
+    SW_UnmapFile(network->mapping, network->mappingSize);
+}
 
-            // Also save these for the next (or well, previous) layer
-            CurrentLayer->neurons[j].error = Error;
-            CurrentLayer->neurons[j].activationDerivative = ActivationDerivative;
+void SW_RandomizeNetwork(SW_Network *network)
+{
+    // Randomize all the weights and biases for each connection
+    srand(time(NULL));
+    SW_FreeCompiledNetwork(network);
 
-            // Actually adjust all the weights using those values
-            for (uint32_t k = 0; k < PreviousLayer->neuronAmount; k++)
-            {
-                // Calculate by how much to change the weights
-                float Delta = Error * ActivationDerivative * PreviousLayer->neurons[k].output;
-                CurrentLayer->neurons[j].weights[k] -= Delta * LearningRate;
-            }
+    for (uint32_t i = 1; i < network->layerAmount; i++)
+    {
+        SW_Layer *CurrentLayer = &network->layers[i];
+        SW_LayerParams Params = CurrentLayer->implementation->params(CurrentLayer);
 
-            // We can just treat the bias the same as a weight, but of which the previous neuron's output is always 1
-            float Delta = Error * ActivationDerivative;
-            CurrentLayer->neurons[j].bias -= Delta * LearningRate;
+        for (uint32_t j = 0; j < Params.rows; j++)
+        {
+            for (uint32_t k = 0; k < Params.columns; k++)
+                Params.weights[(size_t)j * Params.columns + k] = ((float)rand() / (float)RAND_MAX) * 2.0f - 1.0f;
+
+            Params.biases[j] = ((float)rand() / (float)RAND_MAX) * 2.0f - 1.0f;
         }
+
+        SW_ResetConvolutionWeights(CurrentLayer);
     }
 }
 
-void SW_ExucuteNetwork(SW_Network *network)
+// Converts the float weights into the half precision copy again
+static void SW_UpdateHalfWeights(SW_Network *network, uint32_t layerIndex)
 {
-    if (network->layerAmount <= 2)
+    SW_Layer *CurrentLayer = &network->layers[layerIndex];
+
+    if (CurrentLayer->halfWeights != NULL)
+        SWM_convertFromFloat(CurrentLayer->weights, CurrentLayer->halfWeights, CurrentLayer->weightType, (size_t)CurrentLayer->weightRows * CurrentLayer->weightColumns);
+}
+
+void SW_SetLayerWeightType(SW_Network *network, uint32_t layerIndex, SWM_Type weightType)
+{
+    if (layerIndex == 0 || layerIndex >= network->layerAmount || network->layers[layerIndex].weights == NULL)
     {
-        fputs("You can't execute a network without any layers, stupid", stderr);
+        fputs("That layer doesn't have any weights to change the type of", stderr);
         return;
     }
 
-    // Calculate the output for each neuron in each layer
-    for (uint32_t i = 1; i < network->layerAmount; i++)
-    {
-        SW_Layer *PreviousLayer = &network->layers[i - 1];
-        SW_Layer *CurrentLayer = &network->layers[i];
+    SW_Layer *CurrentLayer = &network->layers[layerIndex];
 
-        for (uint32_t j = 0; j < CurrentLayer->neuronAmount; j++)
-        {
-            float input = 0.0f;
-
-            for (uint32_t k = 0; k < PreviousLayer->neuronAmount; k++)
-                input += PreviousLayer->neurons[k].output * CurrentLayer->neurons[j].weights[k];
-            
-            input += CurrentLayer->neurons[j].bias;
-  
-            // The activation function ReLU (Rectified linear)
-            switch (CurrentLayer->activationFunction)
-            {
-            case SW_ACTIVATION_FUNCTION_RELU:
-                CurrentLayer->neurons[j].output = SW_ReLu(input);
-                break;
+    free(CurrentLayer->halfWeights);
+    CurrentLayer->halfWeights = NULL;
+    CurrentLayer->weightType = weightType;
 
-            case SW_ACTIVATION_FUNCTION_SOFTMAX:
-                // unimplemented
-                break;
+    if (weightType == SWM_TYPE_FLOAT32)
+        return;
 
-            case SW_ACTIVATION_FUNCTION_SIGMOID:
-                CurrentLayer->neurons[j].output = SW_Sigmoid(input);
-                break;
+    CurrentLayer->halfWeights = malloc(SWM_typeSize(weightType) * CurrentLayer->weightRows * CurrentLayer->weightColumns);
+    if (CurrentLayer->halfWeights == NULL)
+    {
+        fputs("Not even half of your weights fit in memory", stderr);
+        abort();
+    }
 
-            case SW_ACTIVATION_FUNCTION_TANH:
-                CurrentLayer->neurons[j].output = SW_Tanh(input);
-                break;
+    SW_UpdateHalfWeights(network, layerIndex);
+}
 
-            default:
-                fputs("OH GOD YOU HAVE NO ACTIVATION FUNCTION WHAT HAVE YOU DONE", stderr);
-                CurrentLayer->neurons[j].output = 0.0f;
-                break;
-            }
-        }
+void SW_SetNetworkWeightType(SW_Network *network, SWM_Type weightType)
+{
+    for (uint32_t i = 1; i < network->layerAmount; i++)
+        if (network->layers[i].weights != NULL)
+            SW_SetLayerWeightType(network, i, weightType);
+}
+
+void SW_SetNetworkInput(SW_Network *network, float *input)
+{
+    if (network->layerAmount == 0)
+    {
+        fputs("It's a bit hard to give some input to a completely empty network, isn't it?", stderr);
+        return;
+    }
+
+    if (input == NULL)
+    {
+        fputs("Would be a shame if the input data for the neural network got corrupted and not allocated, wouldn't it? Oh wait, that's the case.", stderr);
+        return;
     }
+
+    for (uint32_t i = 0; i < network->layers[0].neuronAmount; i++)
+        network->layers[0].neurons[i].output = input[i];
 }
 
-float SW_CalculateLoss(SW_Network *network, SW_LossFunction lossFunction, float *input, float *correctOutput)
-{      
-    SW_SetNetworkInput(network, input);
-    SW_ExucuteNetwork(network);
+static void *SW_TrainingAlloc(size_t size)
+{
+    void *Memory = malloc(size);
 
-    SW_Layer *LastLayer = &network->layers[network->layerAmount - 1];
+    // Layers without weights ask for nothing, which is allowed to come back as NULL
+    if (Memory == NULL && size != 0)
+    {
+        fputs("Training needs more memory than you have, try a smaller batch", stderr);
+        abort();
+    }
 
+    return Memory;
+}
+
+// The loss for a single sample
+static float SW_SampleLoss(const float *output, const float *correctOutput, uint32_t outputAmount, SW_LossFunction lossFunction)
+{
     float Result = 0.0f;
 
     switch (lossFunction)
     {
     case SW_LOSS_FUNCTION_CROSS_ENTROPY:
-        for (uint32_t i = 0; i < LastLayer->neuronAmount; i++)
+        for (uint32_t i = 0; i < outputAmount; i++)
             // Log is undefined at 0, so there's a bit of extra logic making sure the input doesn't go that low
-            if (LastLayer->neurons[i].output < 0.000001f)
+            if (output[i] < 0.000001f)
                 Result -= correctOutput[i] * logf(0.0001f);
             else
-                Result -= correctOutput[i] * logf(LastLayer->neurons[i].output);
+                Result -= correctOutput[i] * logf(output[i]);
         break;
 
     case SW_LOSS_FUNCTION_MEAN_SQUARED_ERROR:
-        for (uint32_t i = 0; i < LastLayer->neuronAmount; i++)
-            Result += (correctOutput[i] - LastLayer->neurons[i].output) * (correctOutput[i] - LastLayer->neurons[i].output);
+        for (uint32_t i = 0; i < outputAmount; i++)
+            Result += (correctOutput[i] - output[i]) * (correctOutput[i] - output[i]);
 
-        Result /= LastLayer->neuronAmount;
+        Result /= outputAmount;
         break;
 
     default:
@@ -286,75 +515,982 @@ float SW_CalculateLoss(SW_Network *network, SW_LossFunction lossFunction, float
     return Result;
 }
 
-void SW_SaveNetwork(SW_Network *network, char *fileName)
+// How much the loss changes with a single output
+static inline float SW_LossDerivative(float output, float correctOutput, SW_LossFunction lossFunction)
 {
-    FILE *File = fopen(fileName, "wb");
+    if (lossFunction == SW_LOSS_FUNCTION_CROSS_ENTROPY)
+        return -correctOutput / (output < 0.000001f ? 0.000001f : output);
 
-    if (File == NULL)
+    return -(correctOutput - output);
+}
+
+void SW_SetTrainingType(SW_Network *network, SWM_Type trainingType)
+{
+    // Without fast conversions the half precision copies cost more than the bandwidth they save
+    if (trainingType != SWM_TYPE_FLOAT32 && !SWM_hasFastConversion(trainingType))
     {
-        fputs("Looks like your hard drive is dumb", stderr);
-        return;
+        fputs("This CPU can't convert half precision quickly, training in float instead\n", stderr);
+        trainingType = SWM_TYPE_FLOAT32;
     }
 
-    fwrite(&network->layerAmount, sizeof(uint32_t), 1, File);
+    network->trainingType = trainingType;
+    network->lossScale = trainingType == SWM_TYPE_FLOAT32 ? 1.0f : SW_INITIAL_LOSS_SCALE;
+    network->lossScaleGoodSteps = 0;
+}
 
-    for (uint32_t i = 0; i < network->layerAmount; i++)
-    {
-        fwrite(&network->layers[i].activationFunction, sizeof(SW_LossFunction), 1, File);
-        fwrite(&network->layers[i].neuronAmount, sizeof(uint32_t), 1, File);
-        
-        // neurons store connections to last layer, first layer is... the first, skip that
-        if (i == 0) continue;
+typedef struct SW_GatherTask
+{
+    float **rows;
+    float *destination;
+    uint32_t rowLength;
+} SW_GatherTask;
 
-        for (uint32_t j = 0; j < network->layers[i].neuronAmount; j++)
-        {
-            fwrite(network->layers[i].neurons[j].weights, sizeof(float), network->layers[i - 1].neuronAmount, File);
-            fwrite(&network->layers[i].neurons[j].bias, sizeof(float), 1, File);
-        }
-    }
+// Copies the samples of a batch into one matrix
+static void SW_GatherRows(void *context, size_t begin, size_t end, uint32_t thread)
+{
+    (void)thread;
+    SW_GatherTask *Task = context;
 
-    fclose(File);
+    for (size_t b = begin; b < end; b++)
+        memcpy(&Task->destination[b * Task->rowLength], Task->rows[b], sizeof(float) * Task->rowLength);
 }
 
-/* fails if input network is already loaded */
-void SW_LoadNetwork(SW_Network *network, char *fileName)
+typedef struct SW_ActivationDerivativeTask
 {
-    if (network->layerAmount)
+    float *errors;
+    const float *outputs;
+    SW_ActivationFunction activationFunction;
+} SW_ActivationDerivativeTask;
+
+static void SW_MultiplyActivationDerivative(void *context, size_t begin, size_t end, uint32_t thread)
+{
+    (void)thread;
+    SW_ActivationDerivativeTask *Task = context;
+
+    for (size_t j = begin; j < end; j++)
+        Task->errors[j] *= SW_ApplyActivationDerivative(Task->outputs[j], Task->activationFunction);
+}
+
+float SW_TrainNeuralNetwork(SW_Network *network, float **input, float **correctOutput, uint32_t dataAmount, uint32_t batchSize, float targetLoss, SW_LossFunction lossFunction)
+{
+    // One pass over the data in mini batches, each batch goes forward and backward through the network as whole matrices
+    // The gemms run on trainingType copies of the weights, activations and errors, the float weights are the master copy
+    if (network->layerAmount < 2 || dataAmount == 0)
     {
-        fputs("Attempting to load into existing network, watch out, that shit's fatal cuh\n", stderr);
-        abort();
+        fputs("Training needs a network with weights and some data to train on, you brought neither or one", stderr);
+        return 0.0f;
     }
 
-    FILE *file = fopen(fileName, "rb");
+    if (batchSize == 0)
+        batchSize = 1;
+    if (batchSize > dataAmount)
+        batchSize = dataAmount;
 
-    if (file == NULL)
+    float LearningRate  = 0.2f;
+
+    // Quantization is post training, training a quantized network would only train the float weights behind its back
+    SW_DequantizeNetwork(network);
+
+    uint32_t LayerAmount = network->layerAmount;
+    SWM_Type TrainingType = network->trainingType;
+
+    // Every buffer of a step comes out of one planned workspace, the caller's if it's big enough
+    // With a memory budget only the checkpoints keep their activations, the layers in between go forward again before going backward
+    SW_WorkspaceBuffer *Plan = SW_TrainingAlloc(sizeof(SW_WorkspaceBuffer) * SW_TRAINING_BUFFER_TOTAL(LayerAmount));
+    uint32_t Interval = SW_ChooseCheckpointInterval(network, batchSize, Plan);
+    uint32_t LastCheckpoint = SW_LastCheckpoint(LayerAmount, Interval);
+    size_t WorkspaceSize = SW_PlanTrainingWorkspace(network, batchSize, Interval, Plan);
+
+    network->checkpointInterval = Interval;
+
+    void *OwnWorkspace = NULL;
+    void *Workspace = SW_AlignWorkspace(network->workspace);
+
+    if (network->workspace == NULL || (char *)Workspace + WorkspaceSize > (char *)network->workspace + network->workspaceSize)
     {
-        fputs("An oopsie happend with loading ur flies :(", stderr);
-        return;
+        if (network->workspace != NULL)
+            fputs("That workspace is too small for this batch size, training in its own instead", stderr);
+
+        OwnWorkspace = SW_TrainingAlloc(WorkspaceSize + SW_WORKSPACE_ALIGNMENT - 1);
+        Workspace = SW_AlignWorkspace(OwnWorkspace);
     }
 
-    uint32_t layerAmount;
-    fread(&layerAmount, sizeof(uint32_t), 1, file);
+    void **Activations = SW_TrainingAlloc(sizeof(void *) * LayerAmount);          // The output of each layer for the whole batch
+    void **Errors = SW_TrainingAlloc(sizeof(void *) * LayerAmount);               // How much the loss changes with each layer's input before the activation
+    SW_LayerParams *Params = SW_TrainingAlloc(sizeof(SW_LayerParams) * LayerAmount);
+    SW_LayerBatch *Batches = SW_TrainingAlloc(sizeof(SW_LayerBatch) * LayerAmount);  // The weights, gradients and workspace each layer trains with
+    void **WeightCopies = SW_TrainingAlloc(sizeof(void *) * LayerAmount);         // Only for half precision copies the layer doesn't have already
 
-    for (uint32_t i = 0; i < layerAmount; i++)
+    float *Scratch = SW_WorkspaceBufferAt(Workspace, &Plan[SW_TRAINING_BUFFER_SCRATCH(LayerAmount)]);
+    float *PreviousOutputs = SW_WorkspaceBufferAt(Workspace, &Plan[SW_TRAINING_BUFFER_PREVIOUS_OUTPUTS(LayerAmount)]);
+    float *PreviousErrors = SW_WorkspaceBufferAt(Workspace, &Plan[SW_TRAINING_BUFFER_PREVIOUS_ERRORS(LayerAmount)]);
+
+    void *ForwardOutputs[2] =
     {
-        uint32_t activationFunction;
-        fread(&activationFunction, sizeof(SW_LossFunction), 1, file);
+        SW_WorkspaceBufferAt(Workspace, &Plan[SW_TRAINING_BUFFER_FORWARD_OUTPUTS(LayerAmount)]),
+        SW_WorkspaceBufferAt(Workspace, &Plan[SW_TRAINING_BUFFER_FORWARD_OUTPUTS(LayerAmount) + 1])
+    };
+    void *ForwardLayerWorkspace = SW_WorkspaceBufferAt(Workspace, &Plan[SW_TRAINING_BUFFER_FORWARD_LAYER(LayerAmount)]);
 
-        uint32_t neuronAmount;
-        fread(&neuronAmount, sizeof(uint32_t), 1, file);
+    for (uint32_t i = 0; i < LayerAmount; i++)
+    {
+        SW_Layer *CurrentLayer = &network->layers[i];
+        SW_WorkspaceBuffer *LayerPlan = &Plan[i * SW_TRAINING_BUFFER_AMOUNT];
 
-        SW_AddNetworkLayer(network, neuronAmount, activationFunction);
+        Activations[i] = SW_WorkspaceBufferAt(Workspace, &LayerPlan[SW_TRAINING_BUFFER_ACTIVATIONS]);
+        Errors[i] = SW_WorkspaceBufferAt(Workspace, &LayerPlan[SW_TRAINING_BUFFER_ERRORS]);
+        WeightCopies[i] = SW_WorkspaceBufferAt(Workspace, &LayerPlan[SW_TRAINING_BUFFER_WEIGHT_COPY]);
 
-        // neurons store connections to last layer, first layer is... the first, skip that
         if (i == 0) continue;
 
-        for (uint32_t j = 0; j < neuronAmount; j++)
+        SW_LayerBatch *Batch = &Batches[i];
+        Params[i] = CurrentLayer->implementation->params(CurrentLayer);
+
+        size_t WeightAmount = (size_t)Params[i].rows * Params[i].columns;
+
+        Batch->inference = false;
+        Batch->type = TrainingType;
+        Batch->weightGradient = SW_WorkspaceBufferAt(Workspace, &LayerPlan[SW_TRAINING_BUFFER_WEIGHT_GRADIENT]);
+        Batch->biasGradient = SW_WorkspaceBufferAt(Workspace, &LayerPlan[SW_TRAINING_BUFFER_BIAS_GRADIENT]);
+        Batch->workspace = SW_WorkspaceBufferAt(Workspace, &LayerPlan[SW_TRAINING_BUFFER_LAYER]);
+        Batch->weightType = TrainingType;
+
+        if (TrainingType == SWM_TYPE_FLOAT32 || WeightAmount == 0)
+            Batch->weights = Params[i].weights;
+        else if (WeightCopies[i] == NULL)
+            Batch->weights = CurrentLayer->halfWeights;
+        else
         {
-            fread(network->layers[i].neurons[j].weights, sizeof(float), network->layers[i-1].neuronAmount, file);
-            fread(&(network->layers[i].neurons[j].bias), sizeof(float), 1, file);
+            SWM_convertFromFloat(Params[i].weights, WeightCopies[i], TrainingType, WeightAmount);
+            Batch->weights = WeightCopies[i];
         }
     }
-    
-    fclose(file);
-}
\ No newline at end of file
+
+    float TotalLoss = 0.0f;
+    uint32_t SampleAmount = 0;
+
+    for (uint32_t BatchStart = 0; BatchStart < dataAmount; BatchStart += batchSize)
+    {
+        uint32_t CurrentBatchSize = dataAmount - BatchStart < batchSize ? dataAmount - BatchStart : batchSize;
+        float LossScale = network->lossScale;
+
+        // Forward, each row of a matrix is one sample
+        uint64_t TraceBegin = SWP_traceBegin();
+
+        uint32_t InputAmount = network->layers[0].neuronAmount;
+        SW_GatherTask Gather = { &input[BatchStart], Scratch, InputAmount };
+        SWP_parallelFor(0, CurrentBatchSize, SWP_grainFor(InputAmount), SW_GatherRows, &Gather);
+
+        SWM_convertFromFloat(Scratch, Activations[0], TrainingType, (size_t)CurrentBatchSize * InputAmount);
+
+        SWP_traceEnd(TraceBegin, "load batch", "data", BatchStart / batchSize);
+
+        const void *LayerInput = Activations[0];
+
+        for (uint32_t i = 1; i < LayerAmount; i++)
+        {
+            SW_Layer *CurrentLayer = &network->layers[i];
+            SW_LayerBatch *Batch = &Batches[i];
+            bool LastSegment = i > LastCheckpoint;
+
+            // Layers that go forward again later only need their outputs and workspace until the next layer is done
+            void *Output = i % Interval == 0 || LastSegment ? Activations[i] : ForwardOutputs[i % 2];
+
+            Batch->batchSize = CurrentBatchSize;
+            Batch->input = LayerInput;
+            Batch->output = Scratch;
+            Batch->workspace = LastSegment ? SW_WorkspaceBufferAt(Workspace, &Plan[i * SW_TRAINING_BUFFER_AMOUNT + SW_TRAINING_BUFFER_LAYER]) : ForwardLayerWorkspace;
+
+            SW_PROFILE_START(ForwardStart);
+            TraceBegin = SWP_traceBegin();
+
+            CurrentLayer->implementation->forwardBatch(CurrentLayer, Batch);
+
+            // The loss takes the outputs of the last layer straight from Scratch
+            if (Output != NULL)
+                SWM_convertFromFloat(Scratch, Output, TrainingType, (size_t)CurrentBatchSize * CurrentLayer->neuronAmount);
+
+            SW_PROFILE_STOP(ForwardStart, network, i, SW_PROFILE_PHASE_FORWARD, CurrentBatchSize);
+            SWP_traceEnd(TraceBegin, "forward", "layer", i);
+
+            LayerInput = Output;
+        }
+
+        // The loss and the error of the last layer, straight from the float outputs still in Scratch
+        SW_Layer *LastLayer = &network->layers[LayerAmount - 1];
+        uint32_t OutputAmount = LastLayer->neuronAmount;
+        float BatchLoss = 0.0f;
+        TraceBegin = SWP_traceBegin();
+
+        for (uint32_t b = 0; b < CurrentBatchSize; b++)
+        {
+            float *Output = &Scratch[(size_t)b * OutputAmount];
+            float *CorrectOutput = correctOutput[BatchStart + b];
+
+            BatchLoss += SW_SampleLoss(Output, CorrectOutput, OutputAmount, lossFunction);
+
+            // Scaled up, so small half precision errors don't flush to zero
+            for (uint32_t j = 0; j < OutputAmount; j++)
+                Output[j] = SW_LossDerivative(Output[j], CorrectOutput[j], lossFunction) * SW_ApplyActivationDerivative(Output[j], LastLayer->activationFunction) * LossScale;
+        }
+
+        SWM_convertFromFloat(Scratch, Errors[LayerAmount - 1], TrainingType, (size_t)CurrentBatchSize * OutputAmount);
+
+        SWP_traceEnd(TraceBegin, "loss", "step", -1);
+
+        TotalLoss += BatchLoss;
+        SampleAmount += CurrentBatchSize;
+
+        // Backward, averaging the gradients over the batch and undoing the loss scale in the same go
+        float GradientScale = 1.0f / (CurrentBatchSize * LossScale);
+        bool Overflow = false;
+
+        for (uint32_t i = LayerAmount - 1; i > 0; i--)
+        {
+            SW_Layer *CurrentLayer = &network->layers[i];
+            SW_Layer *PreviousLayer = &network->layers[i - 1];
+            SW_LayerBatch *Batch = &Batches[i];
+            size_t WeightAmount = (size_t)Params[i].rows * Params[i].columns;
+
+            // The top of a segment that didn't keep its activations, go forward through it again from the checkpoint below it
+            if (i % Interval == 0 && i <= LastCheckpoint)
+            {
+                for (uint32_t j = i - Interval + 1; j <= i; j++)
+                {
+                    SW_Layer *SegmentLayer = &network->layers[j];
+                    SW_LayerBatch *SegmentBatch = &Batches[j];
+
+                    SegmentBatch->input = Activations[j - 1];
+                    SegmentBatch->output = Scratch;
+                    SegmentBatch->workspace = SW_WorkspaceBufferAt(Workspace, &Plan[j * SW_TRAINING_BUFFER_AMOUNT + SW_TRAINING_BUFFER_LAYER]);
+
+                    // The checkpoint on top already has its outputs, it only goes again if it keeps something in its workspace
+                    if (j == i && SegmentBatch->workspace == NULL)
+                        break;
+
+                    SW_PROFILE_START(RecomputeStart);
+                    uint64_t RecomputeBegin = SWP_traceBegin();
+
+                    SegmentLayer->implementation->forwardBatch(SegmentLayer, SegmentBatch);
+
+                    if (j < i)
+                        SWM_convertFromFloat(Scratch, Activations[j], TrainingType, (size_t)CurrentBatchSize * SegmentLayer->neuronAmount);
+
+                    SW_PROFILE_STOP(RecomputeStart, network, j, SW_PROFILE_PHASE_FORWARD, CurrentBatchSize);
+                    SWP_traceEnd(RecomputeBegin, "recompute", "layer", j);
+                }
+            }
+
+            SW_PROFILE_START(BackwardStart);
+            TraceBegin = SWP_traceBegin();
+
+            SWM_convertToFloat(Errors[i], TrainingType, Scratch, (size_t)CurrentBatchSize * CurrentLayer->neuronAmount);
+
+            Batch->outputError = Errors[i];
+            Batch->outputErrorFloat = Scratch;
+            Batch->gradientScale = GradientScale;
+            Batch->inputError = i > 1 ? PreviousErrors : NULL;   // The input layer doesn't need an error
+
+            CurrentLayer->implementation->backwardBatch(CurrentLayer, Batch);
+
+            SWP_traceEnd(TraceBegin, "backward", "layer", i);
+            TraceBegin = SWP_traceBegin();
+
+            // The gradients are already summed over the batch, all that's left is checking them for a loss scale that was too big
+            for (size_t j = 0; j < WeightAmount && !Overflow; j++)
+                Overflow = !isfinite(Batch->weightGradient[j]);
+            for (uint32_t j = 0; j < Params[i].rows && !Overflow; j++)
+                Overflow = !isfinite(Batch->biasGradient[j]);
+
+            SWP_traceEnd(TraceBegin, "check gradients", "layer", i);
+
+            if (Overflow)
+                break;
+
+            if (i == 1)
+            {
+                SW_PROFILE_STOP(BackwardStart, network, i, SW_PROFILE_PHASE_BACKWARD, CurrentBatchSize);
+                continue;
+            }
+
+            TraceBegin = SWP_traceBegin();
+
+            // Pass the error on through the activation of the previous layer
+            size_t PreviousAmount = (size_t)CurrentBatchSize * PreviousLayer->neuronAmount;
+
+            SWM_convertToFloat(Activations[i - 1], TrainingType, PreviousOutputs, PreviousAmount);
+
+            SW_ActivationDerivativeTask Derivative = { PreviousErrors, PreviousOutputs, PreviousLayer->activationFunction };
+            SWP_parallelFor(0, PreviousAmount, SWP_grainFor(SW_ACTIVATION_COST), SW_MultiplyActivationDerivative, &Derivative);
+
+            SWM_convertFromFloat(PreviousErrors, Errors[i - 1], TrainingType, PreviousAmount);
+
+            SWP_traceEnd(TraceBegin, "activation backward", "layer", i - 1);
+            SW_PROFILE_STOP(BackwardStart, network, i, SW_PROFILE_PHASE_BACKWARD, CurrentBatchSize);
+        }
+
+        // An overflow means the scale is too large, skip the step and try again with a smaller one
+        if (Overflow)
+        {
+            network->lossScale = LossScale > 1.0f ? LossScale * 0.5f : 1.0f;
+            network->lossScaleGoodSteps = 0;
+            continue;
+        }
+
+        if (TrainingType != SWM_TYPE_FLOAT32 && ++network->lossScaleGoodSteps >= SW_LOSS_SCALE_GROWTH_INTERVAL)
+        {
+            if (network->lossScale < SW_MAX_LOSS_SCALE)
+                network->lossScale *= 2.0f;
+            network->lossScaleGoodSteps = 0;
+        }
+
+        TraceBegin = SWP_traceBegin();
+
+        for (uint32_t i = 1; i < LayerAmount; i++)
+        {
+            SW_Layer *CurrentLayer = &network->layers[i];
+            SW_LayerParams *LayerParams = &Params[i];
+            size_t WeightAmount = (size_t)LayerParams->rows * LayerParams->columns;
+
+            if (WeightAmount == 0) continue;
+
+            SW_PROFILE_START(UpdateStart);
+
+            for (size_t j = 0; j < WeightAmount; j++)
+                LayerParams->weights[j] -= Batches[i].weightGradient[j] * LearningRate;
+
+            // Pruned weights don't get to grow back
+            if (CurrentLayer->pruneMask != NULL)
+                for (size_t j = 0; j < WeightAmount; j++)
+                    if (!CurrentLayer->pruneMask[j])
+                        LayerParams->weights[j] = 0.0f;
+
+            for (uint32_t j = 0; j < LayerParams->rows; j++)
+                LayerParams->biases[j] -= Batches[i].biasGradient[j] * LearningRate;
+
+            // Keep the half precision copies in line with the master weights
+            if (WeightCopies[i] != NULL)
+                SWM_convertFromFloat(LayerParams->weights, WeightCopies[i], TrainingType, WeightAmount);
+            else if (TrainingType != SWM_TYPE_FLOAT32)
+                SW_UpdateHalfWeights(network, i);
+
+            SW_PROFILE_STOP(UpdateStart, network, i, SW_PROFILE_PHASE_UPDATE, CurrentBatchSize);
+        }
+
+        SWP_traceEnd(TraceBegin, "optimizer step", "step", -1);
+
+        SW_AutosaveStep(network);
+
+        if (BatchLoss / CurrentBatchSize <= targetLoss)
+            break;
+    }
+
+    free(Activations);
+    free(Errors);
+    free(Params);
+    free(Batches);
+    free(WeightCopies);
+    free(Plan);
+    free(OwnWorkspace);
+
+    // Iterative pruning, cubic schedule so most of it happens early while the network can still recover
+    SW_PruningSchedule *Schedule = &network->pruningSchedule;
+    if (Schedule->passesDone < Schedule->passAmount)
+    {
+        Schedule->passesDone++;
+
+        float Remaining = 1.0f - (float)Schedule->passesDone / Schedule->passAmount;
+        SW_PruneNetwork(network, Schedule->targetSparsity * (1.0f - Remaining * Remaining * Remaining), Schedule->scope);
+    }
+
+    for (uint32_t i = 1; i < LayerAmount; i++)
+    {
+        SW_UpdateHalfWeights(network, i);
+        SW_UpdateLayerSparsity(network, i);
+    }
+
+    return TotalLoss / SampleAmount;
+}
+
+void SW_ExucuteNetwork(SW_Network *network)
+{
+    if (network->layerAmount <= 2)
+    {
+        fputs("You can't execute a network without any layers, stupid", stderr);
+        return;
+    }
+
+    // Calculate the output for each neuron in each layer
+    for (uint32_t i = 1; i < network->layerAmount; i++)
+    {
+        SW_PROFILE_START(ExecuteStart);
+        network->layers[i].implementation->execute(network, i);
+        SW_PROFILE_STOP(ExecuteStart, network, i, SW_PROFILE_PHASE_FORWARD, 1);
+    }
+}
+
+void SW_PrepareNetwork(SW_Network *network)
+{
+    for (uint32_t i = 1; i < network->layerAmount; i++)
+        if (network->layers[i].implementation->prepare != NULL)
+            network->layers[i].implementation->prepare(&network->layers[i]);
+}
+
+void SW_ExecuteNetworkBatch(SW_Network *network, const float *input, float *output, uint32_t batchSize, void *workspace, size_t workspaceSize)
+{
+    if (network->layerAmount < 2)
+    {
+        fputs("You can't execute a network without any layers, stupid", stderr);
+        return;
+    }
+
+    // Nothing gets allocated here, the outputs of the layers take turns on the two buffers in the workspace
+    size_t SecondOffset, ScratchOffset;
+    size_t PlannedSize = SW_PlanInferenceWorkspace(network, batchSize, &SecondOffset, &ScratchOffset);
+    char *Workspace = SW_AlignWorkspace(workspace);
+
+    if (PlannedSize != 0 && (workspace == NULL || Workspace + PlannedSize > (char *)workspace + workspaceSize))
+    {
+        fputs("That workspace is too small, ask SW_QueryWorkspaceSize how much this batch needs", stderr);
+        return;
+    }
+
+    float *Buffers[2] = { (float *)Workspace, (float *)(Workspace + SecondOffset) };
+    void *Scratch = PlannedSize > ScratchOffset ? Workspace + ScratchOffset : NULL;
+    const float *Input = input;
+
+    for (uint32_t i = 1; i < network->layerAmount; i++)
+    {
+        SW_Layer *CurrentLayer = &network->layers[i];
+        float *Output = i + 1 < network->layerAmount ? Buffers[(i + 1) % 2] : output;
+
+        SW_LayerBatch Batch = { 0 };
+        Batch.batchSize = batchSize;
+        Batch.inference = true;
+        Batch.type = SWM_TYPE_FLOAT32;
+        Batch.input = Input;
+        Batch.weights = CurrentLayer->halfWeights != NULL ? CurrentLayer->halfWeights : (const void *)CurrentLayer->weights;
+        Batch.weightType = CurrentLayer->weightType;
+        Batch.workspace = Scratch;
+        Batch.output = Output;
+
+        SW_PROFILE_START(ForwardStart);
+        uint64_t TraceBegin = SWP_traceBegin();
+
+        CurrentLayer->implementation->forwardBatch(CurrentLayer, &Batch);
+
+        SWP_traceEnd(TraceBegin, "forward", "layer", i);
+        SW_PROFILE_STOP(ForwardStart, network, i, SW_PROFILE_PHASE_FORWARD, batchSize);
+
+        Input = Output;
+    }
+}
+
+float SW_CalculateLoss(SW_Network *network, SW_LossFunction lossFunction, float *input, float *correctOutput)
+{      
+    SW_SetNetworkInput(network, input);
+    SW_ExucuteNetwork(network);
+
+    SW_Layer *LastLayer = &network->layers[network->layerAmount - 1];
+
+    float *Output = network->executionBuffer;
+    for (uint32_t i = 0; i < LastLayer->neuronAmount; i++)
+        Output[i] = LastLayer->neurons[i].output;
+
+    return SW_SampleLoss(Output, correctOutput, LastLayer->neuronAmount, lossFunction);
+}
+
+// Copies size bytes to image at position unless image is NULL, only counting them then
+static void SW_PutImage(uint8_t *image, size_t *position, const void *data, size_t size)
+{
+    if (image != NULL)
+        memcpy(image + *position, data, size);
+
+    *position += size;
+}
+
+size_t SW_SerializeNetwork(SW_Network *network, void *image)
+{
+    uint8_t *Image = image;
+    size_t Position = 0;
+
+    uint32_t Header[3] = { SW_FILE_MAGIC, SW_FILE_VERSION, network->layerAmount };
+    SW_PutImage(Image, &Position, Header, sizeof(Header));
+
+    for (uint32_t i = 0; i < network->layerAmount; i++)
+    {
+        SW_Layer *CurrentLayer = &network->layers[i];
+
+        uint32_t Layer[6] = { CurrentLayer->activationFunction, CurrentLayer->neuronAmount, CurrentLayer->type, CurrentLayer->channels, CurrentLayer->height, CurrentLayer->width };
+        SW_PutImage(Image, &Position, Layer, sizeof(Layer));
+
+        if (CurrentLayer->implementation->save != NULL)
+            Position += CurrentLayer->implementation->save(CurrentLayer, Image != NULL ? Image + Position : NULL);
+
+        // neurons store connections to last layer, first layer is... the first, skip that
+        if (i == 0) continue;
+
+        uint32_t InputAmount = CurrentLayer->weightColumns;
+        uint32_t Storage = SW_WEIGHT_STORAGE_FLOAT32;
+
+        if (CurrentLayer->quantized != NULL)
+            Storage = SW_WEIGHT_STORAGE_INT8;
+        else if (CurrentLayer->weightType == SWM_TYPE_BFLOAT16)
+            Storage = SW_WEIGHT_STORAGE_BFLOAT16;
+        else if (CurrentLayer->weightType == SWM_TYPE_FLOAT16)
+            Storage = SW_WEIGHT_STORAGE_FLOAT16;
+
+        SW_PutImage(Image, &Position, &Storage, sizeof(uint32_t));
+
+        if (Storage == SW_WEIGHT_STORAGE_INT8)
+        {
+            SW_QuantizedLayer *Quantized = CurrentLayer->quantized;
+            uint32_t ZeroPoint = Quantized->inputZeroPoint;
+
+            SW_PutImage(Image, &Position, &Quantized->inputScale, sizeof(float));
+            SW_PutImage(Image, &Position, &ZeroPoint, sizeof(uint32_t));
+
+            for (uint32_t j = 0; j < CurrentLayer->neuronAmount; j++)
+            {
+                SW_PutImage(Image, &Position, &Quantized->weights[(size_t)j * Quantized->paddedInputAmount], sizeof(int8_t) * InputAmount);
+                SW_PutImage(Image, &Position, &Quantized->weightScales[j], sizeof(float));
+                SW_PutImage(Image, &Position, &CurrentLayer->biases[j], sizeof(float));
+            }
+
+            continue;
+        }
+
+        // Half precision rows come straight from the float weights, the copy might lag behind them in the middle of training
+        size_t RowSize = Storage == SW_WEIGHT_STORAGE_FLOAT32 ? sizeof(float) * InputAmount : SWM_typeSize(CurrentLayer->weightType) * InputAmount;
+
+        for (uint32_t j = 0; j < CurrentLayer->weightRows; j++)
+        {
+            const float *Row = &CurrentLayer->weights[(size_t)j * InputAmount];
+
+            if (Image != NULL && Storage != SW_WEIGHT_STORAGE_FLOAT32)
+                SWM_convertFromFloat(Row, Image + Position, CurrentLayer->weightType, InputAmount);
+            else if (Image != NULL)
+                memcpy(Image + Position, Row, RowSize);
+
+            Position += RowSize;
+            SW_PutImage(Image, &Position, &CurrentLayer->biases[j], sizeof(float));
+        }
+    }
+
+    // Where training was, so picking it up again from a saved network carries on the same way
+    SW_PruningSchedule *Schedule = &network->pruningSchedule;
+    uint32_t Training[4] = { network->trainingType, network->lossScaleGoodSteps, Schedule->scope, Schedule->passAmount };
+    float Scales[2] = { network->lossScale, Schedule->targetSparsity };
+
+    SW_PutImage(Image, &Position, Training, sizeof(Training));
+    SW_PutImage(Image, &Position, Scales, sizeof(Scales));
+    SW_PutImage(Image, &Position, &Schedule->passesDone, sizeof(uint32_t));
+
+    return Position;
+}
+
+void SW_SaveNetwork(SW_Network *network, char *fileName)
+{
+    uint64_t TraceBegin = SWP_traceBegin();
+    FILE *File = fopen(fileName, "wb");
+
+    if (File == NULL)
+    {
+        fputs("Looks like your hard drive is dumb", stderr);
+        return;
+    }
+
+    // The whole file in memory first, so it goes out in one write instead of one per row
+    size_t Size = SW_SerializeNetwork(network, NULL);
+    void *Image = malloc(Size);
+    if (Image == NULL)
+    {
+        fputs("Please get better RAM", stderr);
+        abort();
+    }
+
+    SW_SerializeNetwork(network, Image);
+
+    if (fwrite(Image, 1, Size, File) != Size)
+        fputs("Your hard drive gave up halfway through saving, the file is broken", stderr);
+
+    free(Image);
+    fclose(File);
+    SWP_traceEnd(TraceBegin, "save network", "io", (int64_t)Size);
+}
+
+/* fails if input network is already loaded */
+void SW_LoadNetwork(SW_Network *network, char *fileName)
+{
+    if (network->layerAmount)
+    {
+        fputs("Attempting to load into existing network, watch out, that shit's fatal cuh\n", stderr);
+        abort();
+    }
+
+    FILE *file = fopen(fileName, "rb");
+
+    if (file == NULL)
+    {
+        fputs("An oopsie happend with loading ur flies :(", stderr);
+        return;
+    }
+
+    // Files from before the header existed start with the layer amount straight away
+    uint32_t version = 0;
+    uint32_t layerAmount;
+    fread(&layerAmount, sizeof(uint32_t), 1, file);
+
+    if (layerAmount == SW_FILE_MAGIC)
+    {
+        fread(&version, sizeof(uint32_t), 1, file);
+        fread(&layerAmount, sizeof(uint32_t), 1, file);
+
+        if (version > SW_FILE_VERSION)
+        {
+            fputs("This network comes from the future, update Swan to load it", stderr);
+            fclose(file);
+            return;
+        }
+    }
+
+    for (uint32_t i = 0; i < layerAmount; i++)
+    {
+        uint32_t activationFunction;
+        fread(&activationFunction, sizeof(SW_LossFunction), 1, file);
+
+        uint32_t neuronAmount;
+        fread(&neuronAmount, sizeof(uint32_t), 1, file);
+
+        // Everything before version 3 is dense
+        uint32_t shape[4] = { SW_LAYER_TYPE_DENSE, neuronAmount, 1, 1 };
+        if (version >= 3)
+            fread(shape, sizeof(uint32_t), 4, file);
+
+        const SW_LayerInterface *implementation = SW_GetLayerInterface(shape[0]);
+        if (implementation != NULL)
+            implementation->load(network, neuronAmount, activationFunction, &shape[1], file);
+
+        if (network->layerAmount != i + 1 || network->layers[i].neuronAmount != neuronAmount)
+        {
+            fputs("This network file makes no sense, giving up on it", stderr);
+            break;
+        }
+
+        // neurons store connections to last layer, first layer is... the first, skip that
+        if (i == 0) continue;
+
+        SW_Layer *currentLayer = &network->layers[i];
+        uint32_t weightRows = currentLayer->weightRows;
+        uint32_t inputAmount = currentLayer->weightColumns;
+
+        uint32_t storage = SW_WEIGHT_STORAGE_FLOAT32;
+        if (version >= 1)
+            fread(&storage, sizeof(uint32_t), 1, file);
+
+        if (storage == SW_WEIGHT_STORAGE_INT8)
+        {
+            float inputScale;
+            uint32_t zeroPoint;
+            fread(&inputScale, sizeof(float), 1, file);
+            fread(&zeroPoint, sizeof(uint32_t), 1, file);
+
+            int8_t *quantizedWeights = malloc(sizeof(int8_t) * inputAmount);
+            if (quantizedWeights == NULL)
+            {
+                fputs("Please get better RAM", stderr);
+                abort();
+            }
+
+            // The float weights are the dequantized int8 ones, quantizing those again gives back the exact same int8 weights
+            for (uint32_t j = 0; j < weightRows; j++)
+            {
+                float weightScale;
+                fread(quantizedWeights, sizeof(int8_t), inputAmount, file);
+                fread(&weightScale, sizeof(float), 1, file);
+                fread(&currentLayer->biases[j], sizeof(float), 1, file);
+
+                for (uint32_t k = 0; k < inputAmount; k++)
+                    currentLayer->weights[(size_t)j * inputAmount + k] = quantizedWeights[k] * weightScale;
+            }
+
+            free(quantizedWeights);
+
+            SW_QuantizeLayer(currentLayer, inputAmount, inputScale, (uint8_t)zeroPoint);
+        }
+        else if (storage == SW_WEIGHT_STORAGE_BFLOAT16 || storage == SW_WEIGHT_STORAGE_FLOAT16)
+        {
+            SWM_Type weightType = storage == SW_WEIGHT_STORAGE_BFLOAT16 ? SWM_TYPE_BFLOAT16 : SWM_TYPE_FLOAT16;
+            uint16_t *halfRow = malloc(sizeof(uint16_t) * inputAmount);
+            if (halfRow == NULL)
+            {
+                fputs("Please get better RAM", stderr);
+                abort();
+            }
+
+            // Widening to float and back is exact, so the half precision copy ends up identical to the file
+            for (uint32_t j = 0; j < weightRows; j++)
+            {
+                fread(halfRow, sizeof(uint16_t), inputAmount, file);
+                fread(&currentLayer->biases[j], sizeof(float), 1, file);
+
+                SWM_convertToFloat(halfRow, weightType, &currentLayer->weights[(size_t)j * inputAmount], inputAmount);
+            }
+
+            free(halfRow);
+
+            SW_SetLayerWeightType(network, i, weightType);
+        }
+        else
+        {
+            for (uint32_t j = 0; j < weightRows; j++)
+            {
+                fread(&currentLayer->weights[(size_t)j * inputAmount], sizeof(float), inputAmount, file);
+                fread(&currentLayer->biases[j], sizeof(float), 1, file);
+            }
+        }
+
+        // Pruned networks get their sparse kernels back automatically, whatever type their weights were saved in
+        SW_UpdateLayerSparsity(network, i);
+    }
+
+    // Version 5 added where training was
+    if (version >= 5 && network->layerAmount == layerAmount)
+    {
+        uint32_t training[4];
+        float scales[2];
+        uint32_t passesDone;
+
+        if (fread(training, sizeof(uint32_t), 4, file) == 4 && fread(scales, sizeof(float), 2, file) == 2 && fread(&passesDone, sizeof(uint32_t), 1, file) == 1)
+        {
+            network->trainingType = (SWM_Type)training[0];
+            network->lossScaleGoodSteps = training[1];
+            network->lossScale = scales[0];
+            network->pruningSchedule = (SW_PruningSchedule){ scales[1], (SW_PruneScope)training[2], training[3], passesDone };
+        }
+    }
+
+    fclose(file);
+}
+
+// Zeros up to the next multiple of alignment
+static uint64_t SW_PadFile(FILE *file, uint64_t position, uint64_t alignment)
+{
+    static const char Zeros[SW_MAPPED_PAGE_SIZE] = { 0 };
+    uint64_t Padding = (alignment - position % alignment) % alignment;
+
+    fwrite(Zeros, 1, (size_t)Padding, file);
+    return position + Padding;
+}
+
+void SW_SaveMappedNetwork(SW_Network *network, char *fileName)
+{
+    uint64_t TraceBegin = SWP_traceBegin();
+    FILE *File = fopen(fileName, "wb");
+
+    if (File == NULL)
+    {
+        fputs("Looks like your hard drive is dumb", stderr);
+        return;
+    }
+
+    // The offsets of each layer's weights and biases come right after the header, once the layers are written it's known where they go
+    uint32_t Header[3] = { SW_MAPPED_FILE_MAGIC, SW_MAPPED_FILE_VERSION, network->layerAmount };
+    fwrite(Header, sizeof(uint32_t), 3, File);
+
+    uint64_t *Offsets = calloc((size_t)network->layerAmount * 2, sizeof(uint64_t));
+    if (Offsets == NULL)
+    {
+        fputs("Please get better RAM", stderr);
+        abort();
+    }
+
+    fwrite(Offsets, sizeof(uint64_t), (size_t)network->layerAmount * 2, File);
+
+    for (uint32_t i = 0; i < network->layerAmount; i++)
+    {
+        SW_Layer *CurrentLayer = &network->layers[i];
+
+        uint32_t Layer[6] = { CurrentLayer->activationFunction, CurrentLayer->neuronAmount, CurrentLayer->type, CurrentLayer->channels, CurrentLayer->height, CurrentLayer->width };
+        fwrite(Layer, sizeof(uint32_t), 6, File);
+
+        if (CurrentLayer->implementation->save != NULL)
+        {
+            size_t SettingsSize = CurrentLayer->implementation->save(CurrentLayer, NULL);
+            void *Settings = malloc(SettingsSize);
+            if (Settings == NULL)
+            {
+                fputs("Please get better RAM", stderr);
+                abort();
+            }
+
+            CurrentLayer->implementation->save(CurrentLayer, Settings);
+            fwrite(Settings, 1, SettingsSize, File);
+            free(Settings);
+        }
+
+        if (i == 0) continue;
+
+        SW_MappedLayer Mapped = { CurrentLayer->weightType, CurrentLayer->quantized != NULL, 0.0f, 0 };
+        if (CurrentLayer->quantized != NULL)
+        {
+            Mapped.inputScale = CurrentLayer->quantized->inputScale;
+            Mapped.inputZeroPoint = CurrentLayer->quantized->inputZeroPoint;
+        }
+
+        fwrite(&Mapped, sizeof(SW_MappedLayer), 1, File);
+    }
+
+    // The header is small, everything after it gets counted instead of asking the file, ftell is only a long on some systems
+    uint64_t Position = (uint64_t)ftell(File);
+
+    for (uint32_t i = 1; i < network->layerAmount; i++)
+    {
+        SW_Layer *CurrentLayer = &network->layers[i];
+        size_t WeightAmount = (size_t)CurrentLayer->weightRows * CurrentLayer->weightColumns;
+
+        // Pooling layers don't have any
+        if (CurrentLayer->weightRows == 0)
+            continue;
+
+        Position = SW_PadFile(File, Position, SW_MAPPED_PAGE_SIZE);
+        Offsets[i * 2] = Position;
+        fwrite(CurrentLayer->weights, sizeof(float), WeightAmount, File);
+        Position += sizeof(float) * WeightAmount;
+
+        Position = SW_PadFile(File, Position, SW_MAPPED_BIAS_ALIGNMENT);
+        Offsets[i * 2 + 1] = Position;
+        fwrite(CurrentLayer->biases, sizeof(float), CurrentLayer->weightRows, File);
+        Position += sizeof(float) * CurrentLayer->weightRows;
+    }
+
+    fseek(File, sizeof(uint32_t) * 3, SEEK_SET);
+    fwrite(Offsets, sizeof(uint64_t), (size_t)network->layerAmount * 2, File);
+
+    free(Offsets);
+    fclose(File);
+    SWP_traceEnd(TraceBegin, "save network", "io", -1);
+}
+
+bool SW_MapNetwork(SW_Network *network, char *fileName)
+{
+    if (network->layerAmount)
+    {
+        fputs("Attempting to map into existing network, that's not going to fit", stderr);
+        return false;
+    }
+
+    FILE *File = fopen(fileName, "rb");
+
+    if (File == NULL)
+    {
+        fputs("An oopsie happend with loading ur flies :(", stderr);
+        return false;
+    }
+
+    uint64_t TraceBegin = SWP_traceBegin();
+    uint32_t Header[3] = { 0 };
+    fread(Header, sizeof(uint32_t), 3, File);
+
+    if (Header[0] != SW_MAPPED_FILE_MAGIC || Header[1] != SW_MAPPED_FILE_VERSION || Header[2] == 0)
+    {
+        fputs("That's not a mapped network, SW_SaveMappedNetwork makes those", stderr);
+        fclose(File);
+        return false;
+    }
+
+    uint32_t LayerAmount = Header[2];
+    uint64_t *Offsets = malloc(sizeof(uint64_t) * 2 * LayerAmount);
+    SW_MappedLayer *MappedLayers = calloc(LayerAmount, sizeof(SW_MappedLayer));
+    if (Offsets == NULL || MappedLayers == NULL)
+    {
+        fputs("Please get better RAM", stderr);
+        abort();
+    }
+
+    bool Valid = fread(Offsets, sizeof(uint64_t), (size_t)LayerAmount * 2, File) == (size_t)LayerAmount * 2;
+
+    // The layers get made the usual way, with weights of their own for now
+    for (uint32_t i = 0; i < LayerAmount && Valid; i++)
+    {
+        uint32_t Layer[6];
+        Valid = fread(Layer, sizeof(uint32_t), 6, File) == 6;
+
+        const SW_LayerInterface *Implementation = Valid ? SW_GetLayerInterface(Layer[2]) : NULL;
+        if (Implementation != NULL)
+            Implementation->load(network, Layer[1], Layer[0], &Layer[3], File);
+
+        Valid = network->layerAmount == i + 1 && network->layers[i].neuronAmount == Layer[1];
+
+        if (i != 0 && Valid)
+            Valid = fread(&MappedLayers[i], sizeof(SW_MappedLayer), 1, File) == 1;
+    }
+
+    size_t Size = 0;
+    void *Mapping = Valid ? SW_MapFile(File, &Size) : NULL;
+
+    fclose(File);
+
+    // Every layer has to fit in the file, with the weights where floats can be
+    for (uint32_t i = 1; i < LayerAmount && Mapping != NULL; i++)
+    {
+        SW_Layer *CurrentLayer = &network->layers[i];
+        if (CurrentLayer->weightRows == 0)
+            continue;
+
+        uint64_t WeightSize = sizeof(float) * (uint64_t)CurrentLayer->weightRows * CurrentLayer->weightColumns;
+        uint64_t BiasSize = sizeof(float) * (uint64_t)CurrentLayer->weightRows;
+
+        if (Offsets[i * 2] % sizeof(float) != 0 || Offsets[i * 2 + 1] % sizeof(float) != 0 || Offsets[i * 2] > Size || WeightSize > Size - Offsets[i * 2] || Offsets[i * 2 + 1] > Size || BiasSize > Size - Offsets[i * 2 + 1])
+        {
+            SW_UnmapFile(Mapping, Size);
+            Mapping = NULL;
+        }
+    }
+
+    if (Mapping == NULL)
+    {
+        fputs("This network file makes no sense, giving up on it", stderr);
+        SW_UnloadNetwork(network);
+        SW_InitNetwork(network);
+        free(Offsets);
+        free(MappedLayers);
+        return false;
+    }
+
+    network->mapping = Mapping;
+    network->mappingSize = Size;
+
+    for (uint32_t i = 1; i < LayerAmount; i++)
+    {
+        SW_Layer *CurrentLayer = &network->layers[i];
+        SW_MappedLayer *Mapped = &MappedLayers[i];
+
+        if (CurrentLayer->weightRows == 0)
+            continue;
+
+        free(CurrentLayer->weights);
+        free(CurrentLayer->biases);
+
+        CurrentLayer->weights = (float *)((char *)Mapping + Offsets[i * 2]);
+        CurrentLayer->biases = (float *)((char *)Mapping + Offsets[i * 2 + 1]);
+
+        if (CurrentLayer->type == SW_LAYER_TYPE_DENSE)
+            for (uint32_t j = 0; j < CurrentLayer->neuronAmount; j++)
+                CurrentLayer->neurons[j].weights = &CurrentLayer->weights[(size_t)j * CurrentLayer->weightColumns];
+
+        // The same as loading, these are private copies next to the shared float weights
+        if (Mapped->quantized)
+            SW_QuantizeLayer(CurrentLayer, CurrentLayer->weightColumns, Mapped->inputScale, (uint8_t)Mapped->inputZeroPoint);
+        else if (Mapped->weightType == SWM_TYPE_BFLOAT16 || Mapped->weightType == SWM_TYPE_FLOAT16)
+            SW_SetLayerWeightType(network, i, (SWM_Type)Mapped->weightType);
+
+        SW_UpdateLayerSparsity(network, i);
+    }
+
+    free(Offsets);
+    free(MappedLayers);
+    SWP_traceEnd(TraceBegin, "map network", "io", -1);
+
+    return true;
+}
@@ -1,24 +1,46 @@
 #ifndef SW_NETWORK_H
 #define SW_NETWORK_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "SW_types.h"
 
 void SW_InitNetwork(SW_Network *network);
 void SW_AddNetworkLayer(SW_Network *network, uint32_t neuronAmount, SW_ActivationFunction activationFunction);
+void SW_AddNetworkImageLayer(SW_Network *network, uint32_t channels, uint32_t height, uint32_t width); // an input layer of channels x height x width, in that order
+void SW_AddNetworkConvolutionLayer(SW_Network *network, uint32_t channels, uint32_t kernelSize, uint32_t stride, uint32_t padding, SW_ActivationFunction activationFunction); // needs an image or convolution layer before it
+void SW_AddNetworkPoolingLayer(SW_Network *network, SW_PoolingType type, uint32_t size, uint32_t stride); // size and stride are ignored for global average pooling
 void SW_UnloadNetwork(SW_Network *network);
 
 void SW_RandomizeNetwork(SW_Network *network);
 
+// Streams the weights as bfloat16 or float16 during execution (or back as float), saved networks keep the type too
+void SW_SetLayerWeightType(SW_Network *network, uint32_t layerIndex, SWM_Type weightType);
+void SW_SetNetworkWeightType(SW_Network *network, SWM_Type weightType);
+
+// Runs the training gemms on bfloat16 or float16 copies of the weights, activations and errors, with dynamic loss scaling
+// The float weights stay the master copy, falls back to float on CPUs that can't convert quickly
+void SW_SetTrainingType(SW_Network *network, SWM_Type trainingType);
+
 void SW_SetNetworkInput(SW_Network *network, float *input);   // input should have the same length as the first layer in the network
 
-void SW_TrainNeuralNetwork(SW_Network *network, float **input, float **correctOutput, uint32_t dataAmount, uint32_t batchSize, float targetLoss, SW_LossFunction lossFunction); // input and correctOutput should be arrays of length dataAmount, each containing more arrays, for input of the size of the first layer, for correctOutput of the size of the last layer
+float SW_TrainNeuralNetwork(SW_Network *network, float **input, float **correctOutput, uint32_t dataAmount, uint32_t batchSize, float targetLoss, SW_LossFunction lossFunction); // one pass over the data in batches of batchSize, stops early once a batch gets below targetLoss, returns the average loss. input and correctOutput should be arrays of length dataAmount, each containing more arrays, for input of the size of the first layer, for correctOutput of the size of the last layer
 void SW_ExucuteNetwork(SW_Network *network);
+void SW_PrepareNetwork(SW_Network *network); // does what the first batch would otherwise do to the layers (autotuning, copies of the weights), after it threads can share the network for SW_ExecuteNetworkBatch with a workspace each
+void SW_ExecuteNetworkBatch(SW_Network *network, const float *input, float *output, uint32_t batchSize, void *workspace, size_t workspaceSize); // input and output have one row per sample, the workspace should be SW_QueryWorkspaceSize(network, batchSize, SW_WORKSPACE_USE_INFERENCE) bytes, nothing gets allocated
 float SW_CalculateLoss(SW_Network *network, SW_LossFunction lossFunction, float *input, float *correctOutput); // input should have the same length as the first layer in the network, and correctOutput should have the same length as the last layer in the network
 
+size_t SW_SerializeNetwork(SW_Network *network, void *image); // Writes what SW_SaveNetwork would save to image, unless it's NULL, returns how many bytes that is
 void SW_SaveNetwork(SW_Network *network, char *fileName);
 void SW_LoadNetwork(SW_Network *network, char *fileName);
 
+// A file for SW_MapNetwork, every layer's weights and biases on their own pages in the layout Swan executes them in
+// Mapping it reads nothing up front, and every process mapping the same file shares one copy of the weights until someone changes them
+void SW_SaveMappedNetwork(SW_Network *network, char *fileName);
+bool SW_MapNetwork(SW_Network *network, char *fileName); // like SW_LoadNetwork for files from SW_SaveMappedNetwork, false if it couldn't
+
+void SW_FreeWeights(SW_Network *network, void *weights); // free() for the weights and biases of a layer, leaves the ones in a mapped file alone
+
 #endif // SW_NETWORK_H
 
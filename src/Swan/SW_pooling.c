@@ -0,0 +1,168 @@
+#include "SW_pooling.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "SW_types.h"
+#include "SW_network.h"
+#include "SW_layer.h"
+#include "SW_matrix.h"
+
+void SW_FreePooling(SW_Layer *layer)
+{
+    free(layer->pooling);
+    layer->pooling = NULL;
+}
+
+void SW_PoolingForward(SW_Layer *layer, const float *input, float *output, uint32_t *maxIndices)
+{
+    SW_Pooling *Pooling = layer->pooling;
+    uint32_t InputPixels = Pooling->inputHeight * Pooling->inputWidth;
+
+    if (Pooling->type == SW_POOLING_TYPE_GLOBAL_AVERAGE)
+    {
+        for (uint32_t c = 0; c < layer->channels; c++)
+            output[c] = SWM_sum(&input[(size_t)c * InputPixels], InputPixels) / InputPixels;
+
+        return;
+    }
+
+    // Average pooling doesn't have any indices to give
+    if (Pooling->type != SW_POOLING_TYPE_MAX)
+        maxIndices = NULL;
+
+    for (uint32_t c = 0; c < layer->channels; c++)
+        for (uint32_t y = 0; y < layer->height; y++)
+        {
+            size_t Row = ((size_t)c * layer->height + y) * layer->width;
+            size_t InputRow = (size_t)c * InputPixels + y * Pooling->stride * Pooling->inputWidth;
+
+            SWM_poolRow(&input[InputRow], Pooling->inputWidth, Pooling->size, Pooling->stride, Pooling->type == SW_POOLING_TYPE_MAX, layer->width, &output[Row], maxIndices != NULL ? &maxIndices[Row] : NULL, (uint32_t)InputRow);
+        }
+}
+
+void SW_PoolingBackward(SW_Layer *layer, const float *outputError, const uint32_t *maxIndices, float *inputError)
+{
+    SW_Pooling *Pooling = layer->pooling;
+    uint32_t InputPixels = Pooling->inputHeight * Pooling->inputWidth;
+
+    if (Pooling->type == SW_POOLING_TYPE_GLOBAL_AVERAGE)
+    {
+        for (uint32_t c = 0; c < layer->channels; c++)
+            for (uint32_t p = 0; p < InputPixels; p++)
+                inputError[(size_t)c * InputPixels + p] = outputError[c] / InputPixels;
+
+        return;
+    }
+
+    memset(inputError, 0, sizeof(float) * Pooling->inputChannels * InputPixels);
+
+    // Only the maximum of each window had any influence on the output
+    if (Pooling->type == SW_POOLING_TYPE_MAX)
+    {
+        for (uint32_t i = 0; i < layer->neuronAmount; i++)
+            inputError[maxIndices[i]] += outputError[i];
+
+        return;
+    }
+
+    float Scale = 1.0f / (Pooling->size * Pooling->size);
+
+    for (uint32_t c = 0; c < layer->channels; c++)
+        for (uint32_t y = 0; y < layer->height; y++)
+            for (uint32_t x = 0; x < layer->width; x++)
+            {
+                float Error = outputError[((size_t)c * layer->height + y) * layer->width + x] * Scale;
+
+                for (uint32_t ky = 0; ky < Pooling->size; ky++)
+                    for (uint32_t kx = 0; kx < Pooling->size; kx++)
+                        inputError[(size_t)c * InputPixels + (y * Pooling->stride + ky) * Pooling->inputWidth + x * Pooling->stride + kx] += Error;
+            }
+}
+
+// The workspace has the float input of the batch, then the max indices, both needed again for backward
+static size_t SW_PoolingWorkspaceSize(SW_Layer *layer, uint32_t batchSize)
+{
+    size_t InputAmount = (size_t)layer->pooling->inputChannels * layer->pooling->inputHeight * layer->pooling->inputWidth;
+
+    return sizeof(float) * batchSize * InputAmount + sizeof(uint32_t) * batchSize * layer->neuronAmount;
+}
+
+// No weights, no bias and no activation, just the pooling
+static void SW_PoolingForwardBatch(SW_Layer *layer, SW_LayerBatch *batch)
+{
+    size_t InputAmount = (size_t)layer->pooling->inputChannels * layer->pooling->inputHeight * layer->pooling->inputWidth;
+
+    if (batch->inference)
+    {
+        for (uint32_t b = 0; b < batch->batchSize; b++)
+            SW_PoolingForward(layer, &((const float *)batch->input)[b * InputAmount], &batch->output[(size_t)b * layer->neuronAmount], NULL);
+
+        return;
+    }
+
+    float *Input = batch->workspace;
+    uint32_t *MaxIndices = (uint32_t *)&Input[batch->batchSize * InputAmount];
+
+    SWM_convertToFloat(batch->input, batch->type, Input, batch->batchSize * InputAmount);
+
+    for (uint32_t b = 0; b < batch->batchSize; b++)
+        SW_PoolingForward(layer, &Input[b * InputAmount], &batch->output[(size_t)b * layer->neuronAmount], &MaxIndices[(size_t)b * layer->neuronAmount]);
+}
+
+static void SW_PoolingBackwardBatch(SW_Layer *layer, SW_LayerBatch *batch)
+{
+    if (batch->inputError == NULL)
+        return;
+
+    size_t InputAmount = (size_t)layer->pooling->inputChannels * layer->pooling->inputHeight * layer->pooling->inputWidth;
+    const uint32_t *MaxIndices = (const uint32_t *)&((const float *)batch->workspace)[batch->batchSize * InputAmount];
+
+    for (uint32_t b = 0; b < batch->batchSize; b++)
+        SW_PoolingBackward(layer, &batch->outputErrorFloat[(size_t)b * layer->neuronAmount], &MaxIndices[(size_t)b * layer->neuronAmount], &batch->inputError[b * InputAmount]);
+}
+
+static void SW_PoolingExecute(SW_Network *network, uint32_t layerIndex)
+{
+    SW_Layer *CurrentLayer = &network->layers[layerIndex];
+    float *Input = SW_GatherLayerInput(network, layerIndex);
+    float *Output = Input + network->layers[layerIndex - 1].neuronAmount;
+
+    SW_PoolingForward(CurrentLayer, Input, Output, NULL);
+    SW_SetLayerOutput(CurrentLayer, Output);
+}
+
+static size_t SW_PoolingSave(SW_Layer *layer, void *settings)
+{
+    uint32_t Window[3] = { layer->pooling->type, layer->pooling->size, layer->pooling->stride };
+    if (settings != NULL)
+        memcpy(settings, Window, sizeof(Window));
+
+    return sizeof(Window);
+}
+
+static void SW_PoolingLoad(SW_Network *network, uint32_t neuronAmount, SW_ActivationFunction activationFunction, const uint32_t shape[3], FILE *file)
+{
+    (void)neuronAmount;
+    (void)activationFunction;
+    (void)shape;
+
+    uint32_t Window[3] = { 0, 0, 0 };
+    fread(Window, sizeof(uint32_t), 3, file);
+
+    SW_AddNetworkPoolingLayer(network, Window[0], Window[1], Window[2]);
+}
+
+const SW_LayerInterface SW_PoolingLayerInterface =
+{
+    .forwardBatch = SW_PoolingForwardBatch,
+    .backwardBatch = SW_PoolingBackwardBatch,
+    .execute = SW_PoolingExecute,
+    .params = SW_NoLayerParams,
+    .workspaceSize = SW_PoolingWorkspaceSize,
+    .save = SW_PoolingSave,
+    .load = SW_PoolingLoad,
+    .free = SW_FreePooling
+};
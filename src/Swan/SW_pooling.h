@@ -0,0 +1,18 @@
+#ifndef SW_POOLING_H
+#define SW_POOLING_H
+
+#include <stdint.h>
+
+#include "SW_types.h"
+
+// Images are in channels x height x width order, for a single image at a time
+// Max pooling writes the index in the input of every output's maximum to maxIndices (when it isn't NULL), backward needs those
+
+extern const SW_LayerInterface SW_PoolingLayerInterface;
+
+void SW_FreePooling(SW_Layer *layer);
+
+void SW_PoolingForward(SW_Layer *layer, const float *input, float *output, uint32_t *maxIndices);
+void SW_PoolingBackward(SW_Layer *layer, const float *outputError, const uint32_t *maxIndices, float *inputError);
+
+#endif // SW_POOLING_H
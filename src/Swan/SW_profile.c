@@ -0,0 +1,197 @@
+#include "SW_profile.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "SW_types.h"
+#include "SW_matrix.h"
+
+static const char *SW_PhaseNames[SW_PROFILE_PHASE_AMOUNT] = { "forward", "backward", "update" };
+
+static const char *SW_LayerTypeName(SW_LayerType type)
+{
+    switch (type)
+    {
+    case SW_LAYER_TYPE_DENSE:
+        return "dense";
+
+    case SW_LAYER_TYPE_CONVOLUTION:
+        return "convolution";
+
+    case SW_LAYER_TYPE_POOLING:
+        return "pooling";
+
+    default:
+        return "unknown";
+    }
+}
+
+uint64_t SW_ProfileClock(void)
+{
+    struct timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+
+    return (uint64_t)Time.tv_sec * 1000000000u + (uint64_t)Time.tv_nsec;
+}
+
+// Dense and convolution layers do one multiply add per weight column for every output, the rest is counted once per value touched
+static void SW_ProfileCost(const SW_Layer *layer, const SW_Layer *previousLayer, bool firstLayer, SW_ProfilePhase phase, uint32_t batchSize, uint64_t *flops, uint64_t *bytes)
+{
+    uint64_t Inputs = (uint64_t)batchSize * previousLayer->neuronAmount;
+    uint64_t Outputs = (uint64_t)batchSize * layer->neuronAmount;
+    uint64_t WeightAmount = (uint64_t)layer->weightRows * layer->weightColumns;
+    uint64_t MultiplyAdds = Outputs * layer->weightColumns;
+    uint64_t WeightBytes = WeightAmount * SWM_typeSize(layer->weightType);
+
+    // Pooling has no weights, every output looks at a whole window
+    if (layer->type == SW_LAYER_TYPE_POOLING)
+    {
+        const SW_Pooling *Pooling = layer->pooling;
+        uint64_t Window = Pooling->type == SW_POOLING_TYPE_GLOBAL_AVERAGE ? (uint64_t)Pooling->inputHeight * Pooling->inputWidth : (uint64_t)Pooling->size * Pooling->size;
+
+        *flops = phase == SW_PROFILE_PHASE_UPDATE ? 0 : Outputs * Window;
+        *bytes = phase == SW_PROFILE_PHASE_UPDATE ? 0 : sizeof(float) * (Inputs + Outputs) * (phase == SW_PROFILE_PHASE_BACKWARD ? 2 : 1);
+        return;
+    }
+
+    switch (phase)
+    {
+    case SW_PROFILE_PHASE_FORWARD:
+        *flops = 2 * MultiplyAdds + 2 * Outputs;
+        *bytes = sizeof(float) * (Inputs + Outputs) + WeightBytes;
+        break;
+
+    // The weight gradient, and the error of the input unless it's the input layer
+    case SW_PROFILE_PHASE_BACKWARD:
+        *flops = 2 * MultiplyAdds + Outputs + (firstLayer ? 0 : 2 * MultiplyAdds + 2 * Inputs);
+        *bytes = sizeof(float) * (Inputs + Outputs + WeightAmount + layer->weightRows) + (firstLayer ? 0 : WeightBytes + 2 * sizeof(float) * Inputs);
+        break;
+
+    // Read the weight and its gradient, write the weight
+    case SW_PROFILE_PHASE_UPDATE:
+        *flops = 2 * (WeightAmount + layer->weightRows);
+        *bytes = 3 * sizeof(float) * (WeightAmount + layer->weightRows);
+        break;
+
+    default:
+        *flops = 0;
+        *bytes = 0;
+        break;
+    }
+}
+
+void SW_RecordProfile(SW_Network *network, uint32_t layerIndex, SW_ProfilePhase phase, uint32_t batchSize, uint64_t nanoseconds)
+{
+    if (network->profile == NULL || network->profileLayerAmount != network->layerAmount)
+    {
+        free(network->profile);
+
+        network->profile = calloc((size_t)network->layerAmount * SW_PROFILE_PHASE_AMOUNT, sizeof(SW_ProfileCounter));
+        network->profileLayerAmount = network->profile != NULL ? network->layerAmount : 0;
+
+        // Not worth stopping anything over
+        if (network->profile == NULL)
+            return;
+    }
+
+    uint64_t Flops, Bytes;
+    SW_ProfileCost(&network->layers[layerIndex], &network->layers[layerIndex - 1], layerIndex == 1, phase, batchSize, &Flops, &Bytes);
+
+    SW_ProfileCounter *Counter = &network->profile[(size_t)layerIndex * SW_PROFILE_PHASE_AMOUNT + phase];
+    Counter->calls++;
+    Counter->nanoseconds += nanoseconds;
+    Counter->flops += Flops;
+    Counter->bytes += Bytes;
+}
+
+void SW_ResetProfile(SW_Network *network)
+{
+    free(network->profile);
+    network->profile = NULL;
+    network->profileLayerAmount = 0;
+}
+
+static bool SW_HasProfile(SW_Network *network, FILE *file)
+{
+#ifndef SW_PROFILE
+    (void)network;
+    fputs("Swan was built without SW_PROFILE, turn on the SWAN_PROFILE option to get a profile\n", file);
+    return false;
+#else
+    if (network->profile == NULL || network->profileLayerAmount != network->layerAmount)
+    {
+        fputs("Nothing profiled yet, execute or train the network first\n", file);
+        return false;
+    }
+
+    return true;
+#endif
+}
+
+void SW_PrintProfile(SW_Network *network, FILE *file)
+{
+    if (!SW_HasProfile(network, file))
+        return;
+
+    uint64_t Total = 0;
+    for (size_t i = 0; i < (size_t)network->layerAmount * SW_PROFILE_PHASE_AMOUNT; i++)
+        Total += network->profile[i].nanoseconds;
+
+    fprintf(file, "%5s  %-11s  %-8s  %10s  %12s  %6s  %10s  %8s\n", "layer", "type", "phase", "calls", "time (ms)", "%", "GFLOP/s", "GB/s");
+
+    for (uint32_t i = 1; i < network->layerAmount; i++)
+    {
+        for (uint32_t p = 0; p < SW_PROFILE_PHASE_AMOUNT; p++)
+        {
+            const SW_ProfileCounter *Counter = &network->profile[(size_t)i * SW_PROFILE_PHASE_AMOUNT + p];
+            if (Counter->calls == 0) continue;
+
+            // Flops per nanosecond are GFLOP/s
+            double Nanoseconds = Counter->nanoseconds != 0 ? (double)Counter->nanoseconds : 1.0;
+
+            fprintf(file, "%5u  %-11s  %-8s  %10llu  %12.3f  %6.2f  %10.2f  %8.2f\n", i, SW_LayerTypeName(network->layers[i].type), SW_PhaseNames[p],
+                (unsigned long long)Counter->calls, Counter->nanoseconds / 1e6, Total != 0 ? 100.0 * Counter->nanoseconds / Total : 0.0,
+                Counter->flops / Nanoseconds, Counter->bytes / Nanoseconds);
+        }
+    }
+
+    fprintf(file, "total %.3f ms\n", Total / 1e6);
+}
+
+void SW_WriteProfileJson(SW_Network *network, FILE *file)
+{
+#ifndef SW_PROFILE
+    (void)network;
+    fputs("{\"profiled\": false, \"layers\": []}\n", file);
+#else
+    if (network->profile == NULL || network->profileLayerAmount != network->layerAmount)
+    {
+        fputs("{\"profiled\": true, \"layers\": []}\n", file);
+        return;
+    }
+
+    fputs("{\"profiled\": true, \"layers\": [", file);
+
+    for (uint32_t i = 1; i < network->layerAmount; i++)
+    {
+        fprintf(file, "%s\n  {\"index\": %u, \"type\": \"%s\", \"neurons\": %u", i > 1 ? "," : "", i, SW_LayerTypeName(network->layers[i].type), network->layers[i].neuronAmount);
+
+        for (uint32_t p = 0; p < SW_PROFILE_PHASE_AMOUNT; p++)
+        {
+            const SW_ProfileCounter *Counter = &network->profile[(size_t)i * SW_PROFILE_PHASE_AMOUNT + p];
+            double Nanoseconds = Counter->nanoseconds != 0 ? (double)Counter->nanoseconds : 1.0;
+
+            fprintf(file, ", \"%s\": {\"calls\": %llu, \"nanoseconds\": %llu, \"flops\": %llu, \"bytes\": %llu, \"gflopsPerSecond\": %.4f, \"gbytesPerSecond\": %.4f}",
+                SW_PhaseNames[p], (unsigned long long)Counter->calls, (unsigned long long)Counter->nanoseconds, (unsigned long long)Counter->flops, (unsigned long long)Counter->bytes,
+                Counter->flops / Nanoseconds, Counter->bytes / Nanoseconds);
+        }
+
+        fputc('}', file);
+    }
+
+    fputs("\n]}\n", file);
+#endif
+}
@@ -0,0 +1,28 @@
+#ifndef SW_PROFILE_H
+#define SW_PROFILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "SW_types.h"
+
+// Per layer timings of executing and training, only recorded when Swan is built with SW_PROFILE defined (the SWAN_PROFILE CMake option)
+// Without it the timing compiles away completely, and the functions below only say there's nothing to show
+
+void SW_ResetProfile(SW_Network *network);
+void SW_PrintProfile(SW_Network *network, FILE *file);     // A table of time, calls, GFLOP/s and GB/s per layer and phase
+void SW_WriteProfileJson(SW_Network *network, FILE *file); // The same as JSON, raw counters included
+
+// Adds one call that took nanoseconds to a layer's totals, working out its flops and bytes from batchSize and the layer's shape
+void SW_RecordProfile(SW_Network *network, uint32_t layerIndex, SW_ProfilePhase phase, uint32_t batchSize, uint64_t nanoseconds);
+uint64_t SW_ProfileClock(void); // Nanoseconds from some fixed point
+
+#ifdef SW_PROFILE
+#define SW_PROFILE_START(name) uint64_t name = SW_ProfileClock()
+#define SW_PROFILE_STOP(name, network, layerIndex, phase, batchSize) SW_RecordProfile(network, layerIndex, phase, batchSize, SW_ProfileClock() - name)
+#else
+#define SW_PROFILE_START(name)
+#define SW_PROFILE_STOP(name, network, layerIndex, phase, batchSize)
+#endif
+
+#endif // SW_PROFILE_H
@@ -0,0 +1,451 @@
+#include "SW_prune.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "SW_types.h"
+#include "SW_network.h"
+#include "SW_quantize.h"
+#include "SW_matrix.h"
+#include "SW_convolution.h"
+#include "SW_jit.h"
+
+static void *SW_PruneAlloc(size_t size)
+{
+    void *Memory = malloc(size);
+
+    if (Memory == NULL)
+    {
+        fputs("Pruning was supposed to save memory, not run out of it", stderr);
+        abort();
+    }
+
+    return Memory;
+}
+
+static inline size_t SW_LayerWeightAmount(SW_Network *network, uint32_t layerIndex)
+{
+    SW_LayerParams Params = network->layers[layerIndex].implementation->params(&network->layers[layerIndex]);
+    return (size_t)Params.rows * Params.columns;
+}
+
+// Finds the k-th smallest value (quickselect), shuffles the values around while doing so
+static float SW_SelectSmallest(float *values, size_t amount, size_t k)
+{
+    size_t Left = 0, Right = amount - 1;
+
+    while (Left < Right)
+    {
+        float Pivot = values[Left + (Right - Left) / 2];
+        size_t i = Left, j = Right;
+
+        while (i <= j)
+        {
+            while (values[i] < Pivot) i++;
+            while (values[j] > Pivot) j--;
+
+            if (i <= j)
+            {
+                float Temp = values[i];
+                values[i] = values[j];
+                values[j] = Temp;
+
+                i++;
+                if (j == 0) break;
+                j--;
+            }
+        }
+
+        if (k <= j)
+            Right = j;
+        else if (k >= i)
+            Left = i;
+        else
+            break;
+    }
+
+    return values[k];
+}
+
+// Zeroes pruneAmount weights of the layer with a magnitude of at most threshold, smallest ones first
+static void SW_PruneLayer(SW_Network *network, uint32_t layerIndex, float threshold, size_t pruneAmount)
+{
+    SW_Layer *CurrentLayer = &network->layers[layerIndex];
+    size_t WeightAmount = SW_LayerWeightAmount(network, layerIndex);
+
+    if (WeightAmount == 0)
+        return;
+
+    if (CurrentLayer->pruneMask == NULL)
+    {
+        CurrentLayer->pruneMask = SW_PruneAlloc(WeightAmount);
+        memset(CurrentLayer->pruneMask, 1, WeightAmount);
+    }
+
+    size_t Pruned = 0;
+
+    // Everything below the threshold first, then the ones exactly at it until there's enough
+    for (size_t i = 0; i < WeightAmount && Pruned < pruneAmount; i++)
+        if (fabsf(CurrentLayer->weights[i]) < threshold)
+        {
+            CurrentLayer->weights[i] = 0.0f;
+            CurrentLayer->pruneMask[i] = 0;
+            Pruned++;
+        }
+
+    for (size_t i = 0; i < WeightAmount && Pruned < pruneAmount; i++)
+        if (fabsf(CurrentLayer->weights[i]) == threshold && CurrentLayer->pruneMask[i])
+        {
+            CurrentLayer->weights[i] = 0.0f;
+            CurrentLayer->pruneMask[i] = 0;
+            Pruned++;
+        }
+
+    // The other copies of the weights have to follow
+    if (CurrentLayer->halfWeights != NULL)
+        SW_SetLayerWeightType(network, layerIndex, CurrentLayer->weightType);
+
+    if (CurrentLayer->quantized != NULL)
+        SW_QuantizeLayer(CurrentLayer, network->layers[layerIndex - 1].neuronAmount, CurrentLayer->quantized->inputScale, CurrentLayer->quantized->inputZeroPoint);
+
+    SW_UpdateLayerSparsity(network, layerIndex);
+}
+
+void SW_PruneNetwork(SW_Network *network, float sparsity, SW_PruneScope scope)
+{
+    if (sparsity <= 0.0f)
+        return;
+
+    if (sparsity >= 1.0f)
+    {
+        fputs("Pruning every single weight, at that point just delete the network", stderr);
+        return;
+    }
+
+    if (scope == SW_PRUNE_SCOPE_LAYER)
+    {
+        for (uint32_t i = 1; i < network->layerAmount; i++)
+        {
+            size_t WeightAmount = SW_LayerWeightAmount(network, i);
+            size_t PruneAmount = (size_t)(sparsity * WeightAmount);
+            if (PruneAmount == 0) continue;
+
+            float *Magnitudes = SW_PruneAlloc(sizeof(float) * WeightAmount);
+            for (size_t j = 0; j < WeightAmount; j++)
+                Magnitudes[j] = fabsf(network->layers[i].weights[j]);
+
+            float Threshold = SW_SelectSmallest(Magnitudes, WeightAmount, PruneAmount - 1);
+            free(Magnitudes);
+
+            SW_PruneLayer(network, i, Threshold, PruneAmount);
+        }
+
+        return;
+    }
+
+    // Global, one threshold for all layers, so layers with many small weights lose more of them
+    size_t TotalAmount = 0;
+    for (uint32_t i = 1; i < network->layerAmount; i++)
+        TotalAmount += SW_LayerWeightAmount(network, i);
+
+    size_t PruneAmount = (size_t)(sparsity * TotalAmount);
+    if (PruneAmount == 0)
+        return;
+
+    float *Magnitudes = SW_PruneAlloc(sizeof(float) * TotalAmount);
+    size_t Index = 0;
+
+    for (uint32_t i = 1; i < network->layerAmount; i++)
+        for (size_t j = 0, l = SW_LayerWeightAmount(network, i); j < l; j++)
+            Magnitudes[Index++] = fabsf(network->layers[i].weights[j]);
+
+    float Threshold = SW_SelectSmallest(Magnitudes, TotalAmount, PruneAmount - 1);
+    free(Magnitudes);
+
+    // Ties at the threshold go to the first layers, which only matters when a lot of weights share the exact same magnitude
+    size_t BelowThreshold = 0;
+    for (uint32_t i = 1; i < network->layerAmount; i++)
+        for (size_t j = 0, l = SW_LayerWeightAmount(network, i); j < l; j++)
+            BelowThreshold += fabsf(network->layers[i].weights[j]) < Threshold;
+
+    size_t TiesLeft = PruneAmount - BelowThreshold;
+
+    for (uint32_t i = 1; i < network->layerAmount; i++)
+    {
+        size_t LayerBelow = 0, LayerTies = 0;
+
+        for (size_t j = 0, l = SW_LayerWeightAmount(network, i); j < l; j++)
+        {
+            float Magnitude = fabsf(network->layers[i].weights[j]);
+            LayerBelow += Magnitude < Threshold;
+            LayerTies += Magnitude == Threshold;
+        }
+
+        if (LayerTies > TiesLeft)
+            LayerTies = TiesLeft;
+        TiesLeft -= LayerTies;
+
+        SW_PruneLayer(network, i, Threshold, LayerBelow + LayerTies);
+    }
+}
+
+void SW_SetPruningSchedule(SW_Network *network, float targetSparsity, SW_PruneScope scope, uint32_t passAmount)
+{
+    network->pruningSchedule.targetSparsity = targetSparsity;
+    network->pruningSchedule.scope = scope;
+    network->pruningSchedule.passAmount = passAmount;
+    network->pruningSchedule.passesDone = 0;
+}
+
+void SW_UpdateLayerSparsity(SW_Network *network, uint32_t layerIndex)
+{
+    // Every change to the weights comes through here, the compiled code has the old ones built in
+    SW_FreeCompiledNetwork(network);
+
+    SW_Layer *CurrentLayer = &network->layers[layerIndex];
+    size_t WeightAmount = SW_LayerWeightAmount(network, layerIndex);
+
+    if (CurrentLayer->sparseWeights != NULL)
+    {
+        SWM_destroyCsr(CurrentLayer->sparseWeights);
+        free(CurrentLayer->sparseWeights);
+        CurrentLayer->sparseWeights = NULL;
+    }
+
+    // Convolutions don't have a sparse kernel, only their blocked and winograd copies need remaking
+    if (CurrentLayer->type != SW_LAYER_TYPE_DENSE)
+    {
+        SW_ResetConvolutionWeights(CurrentLayer);
+        return;
+    }
+
+    size_t NonZeroAmount = 0;
+    for (size_t i = 0; i < WeightAmount; i++)
+        NonZeroAmount += CurrentLayer->weights[i] != 0.0f;
+
+    if (NonZeroAmount >= SW_SPARSE_DENSITY_THRESHOLD * WeightAmount)
+        return;
+
+    CurrentLayer->sparseWeights = SW_PruneAlloc(sizeof(SWM_CsrMatrix));
+    SWM_csrFromDense(CurrentLayer->sparseWeights, CurrentLayer->weights, CurrentLayer->weightRows, CurrentLayer->weightColumns);
+}
+
+void SW_FreeLayerSparsity(SW_Layer *layer)
+{
+    if (layer->sparseWeights != NULL)
+    {
+        SWM_destroyCsr(layer->sparseWeights);
+        free(layer->sparseWeights);
+        layer->sparseWeights = NULL;
+    }
+
+    free(layer->pruneMask);
+    layer->pruneMask = NULL;
+}
+
+typedef struct SW_ScoredNeuron
+{
+    float score;
+    uint32_t index;
+} SW_ScoredNeuron;
+
+static int SW_CompareScoredNeurons(const void *a, const void *b)
+{
+    const SW_ScoredNeuron *A = a, *B = b;
+
+    if (A->score != B->score)
+        return A->score < B->score ? -1 : 1;
+
+    return A->index < B->index ? -1 : (A->index > B->index);
+}
+
+static int SW_CompareIndices(const void *a, const void *b)
+{
+    uint32_t A = *(const uint32_t *)a, B = *(const uint32_t *)b;
+    return A < B ? -1 : (A > B);
+}
+
+// Remakes a layer with only the kept neurons (rows) and the layer after it with only the kept inputs (columns)
+static void SW_ShrinkLayer(SW_Network *network, uint32_t layerIndex, const uint32_t *keep, uint32_t keepAmount)
+{
+    SW_Layer *CurrentLayer = &network->layers[layerIndex];
+    SW_Layer *NextLayer = &network->layers[layerIndex + 1];
+    uint32_t InputAmount = network->layers[layerIndex - 1].neuronAmount;
+    uint32_t OldAmount = CurrentLayer->neuronAmount;
+
+    // The rows of the current layer
+    float *Weights = SW_PruneAlloc(sizeof(float) * keepAmount * InputAmount);
+    float *Biases = SW_PruneAlloc(sizeof(float) * keepAmount);
+    SW_Neuron *Neurons = SW_PruneAlloc(sizeof(SW_Neuron) * keepAmount);
+    uint8_t *Mask = CurrentLayer->pruneMask != NULL ? SW_PruneAlloc((size_t)keepAmount * InputAmount) : NULL;
+
+    for (uint32_t i = 0; i < keepAmount; i++)
+    {
+        memcpy(&Weights[(size_t)i * InputAmount], &CurrentLayer->weights[(size_t)keep[i] * InputAmount], sizeof(float) * InputAmount);
+        if (Mask != NULL)
+            memcpy(&Mask[(size_t)i * InputAmount], &CurrentLayer->pruneMask[(size_t)keep[i] * InputAmount], InputAmount);
+
+        Biases[i] = CurrentLayer->biases[keep[i]];
+        Neurons[i] = CurrentLayer->neurons[keep[i]];
+        Neurons[i].weights = &Weights[(size_t)i * InputAmount];
+    }
+
+    SW_FreeWeights(network, CurrentLayer->weights);
+    SW_FreeWeights(network, CurrentLayer->biases);
+    free(CurrentLayer->neurons);
+    free(CurrentLayer->pruneMask);
+
+    CurrentLayer->weights = Weights;
+    CurrentLayer->biases = Biases;
+    CurrentLayer->neurons = Neurons;
+    CurrentLayer->pruneMask = Mask;
+    CurrentLayer->neuronAmount = keepAmount;
+    CurrentLayer->channels = keepAmount;
+    CurrentLayer->weightRows = keepAmount;
+
+    // The columns of the next layer
+    Weights = SW_PruneAlloc(sizeof(float) * NextLayer->neuronAmount * keepAmount);
+    Mask = NextLayer->pruneMask != NULL ? SW_PruneAlloc((size_t)NextLayer->neuronAmount * keepAmount) : NULL;
+
+    for (uint32_t i = 0; i < NextLayer->neuronAmount; i++)
+    {
+        for (uint32_t j = 0; j < keepAmount; j++)
+        {
+            Weights[(size_t)i * keepAmount + j] = NextLayer->weights[(size_t)i * OldAmount + keep[j]];
+            if (Mask != NULL)
+                Mask[(size_t)i * keepAmount + j] = NextLayer->pruneMask[(size_t)i * OldAmount + keep[j]];
+        }
+
+        NextLayer->neurons[i].weights = &Weights[(size_t)i * keepAmount];
+    }
+
+    SW_FreeWeights(network, NextLayer->weights);
+    free(NextLayer->pruneMask);
+
+    NextLayer->weights = Weights;
+    NextLayer->pruneMask = Mask;
+    NextLayer->weightColumns = keepAmount;
+
+    // Every other copy of the weights of both layers is now the wrong shape
+    for (uint32_t i = layerIndex; i <= layerIndex + 1; i++)
+    {
+        SW_Layer *Layer = &network->layers[i];
+
+        SW_SetLayerWeightType(network, i, Layer->weightType);
+
+        if (Layer->quantized != NULL)
+            SW_QuantizeLayer(Layer, network->layers[i - 1].neuronAmount, Layer->quantized->inputScale, Layer->quantized->inputZeroPoint);
+
+        SW_UpdateLayerSparsity(network, i);
+    }
+}
+
+void SW_RemoveNeurons(SW_Network *network, uint32_t layerIndex, uint32_t removeAmount, SW_NeuronScore score, float **data, uint32_t dataAmount)
+{
+    if (layerIndex == 0 || layerIndex + 1 >= network->layerAmount)
+    {
+        fputs("Only hidden layers can lose neurons, the input and output sizes are kind of important", stderr);
+        return;
+    }
+
+    if (network->layers[layerIndex].type != SW_LAYER_TYPE_DENSE || network->layers[layerIndex + 1].type != SW_LAYER_TYPE_DENSE)
+    {
+        fputs("Removing neurons from a convolution would mean removing pixels, try a smaller convolution instead", stderr);
+        return;
+    }
+
+    SW_Layer *CurrentLayer = &network->layers[layerIndex];
+    SW_Layer *NextLayer = &network->layers[layerIndex + 1];
+    uint32_t InputAmount = network->layers[layerIndex - 1].neuronAmount;
+    uint32_t NeuronAmount = CurrentLayer->neuronAmount;
+
+    if (removeAmount == 0)
+        return;
+    if (removeAmount >= NeuronAmount)
+        removeAmount = NeuronAmount - 1;
+
+    if (score == SW_NEURON_SCORE_ACTIVATION && (data == NULL || dataAmount == 0))
+    {
+        fputs("Activation scores need some data to look at, using weight norms instead", stderr);
+        score = SW_NEURON_SCORE_WEIGHT_NORM;
+    }
+
+    // Average output of every neuron on the data
+    float *AverageOutputs = NULL;
+
+    if (score == SW_NEURON_SCORE_ACTIVATION)
+    {
+        AverageOutputs = calloc(NeuronAmount, sizeof(float));
+        if (AverageOutputs == NULL)
+        {
+            fputs("Pruning was supposed to save memory, not run out of it", stderr);
+            abort();
+        }
+
+        for (uint32_t i = 0; i < dataAmount; i++)
+        {
+            SW_SetNetworkInput(network, data[i]);
+            SW_ExucuteNetwork(network);
+
+            for (uint32_t j = 0; j < NeuronAmount; j++)
+                AverageOutputs[j] += CurrentLayer->neurons[j].output / dataAmount;
+        }
+    }
+
+    SW_ScoredNeuron *Scores = SW_PruneAlloc(sizeof(SW_ScoredNeuron) * NeuronAmount);
+
+    for (uint32_t i = 0; i < NeuronAmount; i++)
+    {
+        float Outgoing = 0.0f;
+        for (uint32_t j = 0; j < NextLayer->neuronAmount; j++)
+            Outgoing += NextLayer->weights[(size_t)j * NeuronAmount + i] * NextLayer->weights[(size_t)j * NeuronAmount + i];
+
+        float Incoming = 0.0f;
+        if (score == SW_NEURON_SCORE_WEIGHT_NORM)
+            for (uint32_t j = 0; j < InputAmount; j++)
+                Incoming += CurrentLayer->weights[(size_t)i * InputAmount + j] * CurrentLayer->weights[(size_t)i * InputAmount + j];
+        else
+            Incoming = AverageOutputs[i] * AverageOutputs[i];
+
+        Scores[i].score = sqrtf(Incoming) * sqrtf(Outgoing);
+        Scores[i].index = i;
+    }
+
+    qsort(Scores, NeuronAmount, sizeof(SW_ScoredNeuron), SW_CompareScoredNeurons);
+
+    // A removed neuron still added its average output to the next layer, keep that bit in the biases
+    if (AverageOutputs != NULL)
+        for (uint32_t i = 0; i < removeAmount; i++)
+            for (uint32_t j = 0; j < NextLayer->neuronAmount; j++)
+                NextLayer->biases[j] += NextLayer->weights[(size_t)j * NeuronAmount + Scores[i].index] * AverageOutputs[Scores[i].index];
+
+    // Keep the rest in their original order
+    uint32_t KeepAmount = NeuronAmount - removeAmount;
+    uint32_t *Keep = SW_PruneAlloc(sizeof(uint32_t) * KeepAmount);
+
+    for (uint32_t i = 0; i < KeepAmount; i++)
+        Keep[i] = Scores[removeAmount + i].index;
+
+    qsort(Keep, KeepAmount, sizeof(uint32_t), SW_CompareIndices);
+
+    SW_ShrinkLayer(network, layerIndex, Keep, KeepAmount);
+
+    free(Keep);
+    free(Scores);
+    free(AverageOutputs);
+}
+
+void SW_PruneNeurons(SW_Network *network, float keepFraction, SW_NeuronScore score, float **data, uint32_t dataAmount)
+{
+    // Later layers get scored with the already shrunk earlier layers
+    for (uint32_t i = 1; i + 1 < network->layerAmount; i++)
+    {
+        uint32_t KeepAmount = (uint32_t)ceilf(keepFraction * network->layers[i].neuronAmount);
+        if (KeepAmount >= network->layers[i].neuronAmount) continue;
+        if (network->layers[i].type != SW_LAYER_TYPE_DENSE || network->layers[i + 1].type != SW_LAYER_TYPE_DENSE) continue;
+
+        SW_RemoveNeurons(network, i, network->layers[i].neuronAmount - KeepAmount, score, data, dataAmount);
+    }
+}
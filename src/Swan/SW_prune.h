@@ -0,0 +1,28 @@
+#ifndef SW_PRUNE_H
+#define SW_PRUNE_H
+
+#include <stdint.h>
+
+#include "SW_types.h"
+
+// Layers with less than this fraction of non zero weights get executed as sparse matrices
+#define SW_SPARSE_DENSITY_THRESHOLD 0.3f
+
+// Magnitude pruning, zeroes the smallest weights until sparsity (0 to 1) of them are zero
+// Pruned weights stay zero when training afterwards
+void SW_PruneNetwork(SW_Network *network, float sparsity, SW_PruneScope scope);
+
+// Iterative pruning, every call to SW_TrainNeuralNetwork prunes a bit more until targetSparsity is reached after passAmount calls
+void SW_SetPruningSchedule(SW_Network *network, float targetSparsity, SW_PruneScope scope, uint32_t passAmount);
+
+// Structured pruning, removes whole neurons from hidden layers so the layers (and the next layer's weights) physically shrink
+// data is only used by SW_NEURON_SCORE_ACTIVATION, an array of dataAmount inputs of the size of the first layer
+// With activation scores the average output of a removed neuron gets folded into the next layer's biases
+void SW_RemoveNeurons(SW_Network *network, uint32_t layerIndex, uint32_t removeAmount, SW_NeuronScore score, float **data, uint32_t dataAmount);
+void SW_PruneNeurons(SW_Network *network, float keepFraction, SW_NeuronScore score, float **data, uint32_t dataAmount); // every hidden layer keeps keepFraction of its neurons
+
+// Picks between dense and sparse execution for a layer, call it after changing the weights by hand
+void SW_UpdateLayerSparsity(SW_Network *network, uint32_t layerIndex);
+void SW_FreeLayerSparsity(SW_Layer *layer);
+
+#endif // SW_PRUNE_H
@@ -0,0 +1,279 @@
+#include "SW_quantize.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "SW_types.h"
+#include "SW_util.h"
+#include "SW_network.h"
+#include "SW_matrix.h"
+#include "SW_jit.h"
+#include "SW_parallel.h"
+
+// Activations only use 7 bits, see SWM_gemmInt8
+#define SW_QUANTIZED_INPUT_MAX 127
+#define SW_QUANTIZED_WEIGHT_MAX 127
+
+static inline uint8_t SW_QuantizeValue(float value, float inverseScale, uint8_t zeroPoint)
+{
+    int32_t Quantized = (int32_t)lroundf(value * inverseScale) + zeroPoint;
+
+    if (Quantized < 0)
+        return 0;
+    if (Quantized > SW_QUANTIZED_INPUT_MAX)
+        return SW_QUANTIZED_INPUT_MAX;
+
+    return (uint8_t)Quantized;
+}
+
+// Takes the input zero point back out of an accumulator, scales it back to float, adds the bias and applies the activation
+static inline float SW_RequantizeOutput(const SW_Layer *layer, int32_t accumulator, uint32_t neuron)
+{
+    const SW_QuantizedLayer *Quantized = layer->quantized;
+    int32_t Accumulator = accumulator - (int32_t)Quantized->inputZeroPoint * Quantized->weightSums[neuron];
+
+    return SW_ApplyActivation((float)Accumulator * Quantized->inputScale * Quantized->weightScales[neuron] + layer->biases[neuron], layer->activationFunction);
+}
+
+static void *SW_QuantizeAlloc(size_t size)
+{
+    void *Memory = calloc(1, size);
+
+    if (Memory == NULL)
+    {
+        fputs("Not even 8 bits per weight fit in your RAM", stderr);
+        abort();
+    }
+
+    return Memory;
+}
+
+void SW_QuantizeLayer(SW_Layer *layer, uint32_t inputAmount, float inputScale, uint8_t inputZeroPoint)
+{
+    SW_FreeQuantizedLayer(layer);
+
+    SW_QuantizedLayer *Quantized = SW_QuantizeAlloc(sizeof(SW_QuantizedLayer));
+
+    // Pad the rows so the kernels never have to deal with a tail
+    Quantized->paddedInputAmount = (inputAmount + SWM_INT8_K_ALIGNMENT - 1) / SWM_INT8_K_ALIGNMENT * SWM_INT8_K_ALIGNMENT;
+
+    Quantized->weights = SW_QuantizeAlloc(sizeof(int8_t) * layer->neuronAmount * Quantized->paddedInputAmount);
+    Quantized->weightScales = SW_QuantizeAlloc(sizeof(float) * layer->neuronAmount);
+    Quantized->weightSums = SW_QuantizeAlloc(sizeof(int32_t) * layer->neuronAmount);
+    Quantized->input = SW_QuantizeAlloc(sizeof(uint8_t) * Quantized->paddedInputAmount);
+    Quantized->accumulators = SW_QuantizeAlloc(sizeof(int32_t) * layer->neuronAmount);
+
+    Quantized->inputScale = inputScale;
+    Quantized->inputZeroPoint = inputZeroPoint;
+
+    // Symmetric per channel quantization, the largest weight of each neuron maps to 127
+    for (uint32_t i = 0; i < layer->neuronAmount; i++)
+    {
+        float *Weights = &layer->weights[(size_t)i * inputAmount];
+        int8_t *QuantizedWeights = &Quantized->weights[(size_t)i * Quantized->paddedInputAmount];
+
+        float Largest = 0.0f;
+        for (uint32_t j = 0; j < inputAmount; j++)
+            if (fabsf(Weights[j]) > Largest)
+                Largest = fabsf(Weights[j]);
+
+        float Scale = Largest > 0.0f ? Largest / SW_QUANTIZED_WEIGHT_MAX : 1.0f;
+        int32_t Sum = 0;
+
+        for (uint32_t j = 0; j < inputAmount; j++)
+        {
+            int32_t Value = (int32_t)lroundf(Weights[j] / Scale);
+
+            if (Value > SW_QUANTIZED_WEIGHT_MAX)
+                Value = SW_QUANTIZED_WEIGHT_MAX;
+            if (Value < -SW_QUANTIZED_WEIGHT_MAX)
+                Value = -SW_QUANTIZED_WEIGHT_MAX;
+
+            QuantizedWeights[j] = (int8_t)Value;
+            Sum += Value;
+        }
+
+        Quantized->weightScales[i] = Scale;
+        Quantized->weightSums[i] = Sum;
+    }
+
+    layer->quantized = Quantized;
+}
+
+void SW_FreeQuantizedLayer(SW_Layer *layer)
+{
+    if (layer->quantized == NULL)
+        return;
+
+    free(layer->quantized->weights);
+    free(layer->quantized->weightScales);
+    free(layer->quantized->weightSums);
+    free(layer->quantized->input);
+    free(layer->quantized->accumulators);
+    free(layer->quantized);
+
+    layer->quantized = NULL;
+}
+
+void SW_QuantizeNetwork(SW_Network *network, float **calibrationInput, uint32_t calibrationAmount)
+{
+    if (network->layerAmount < 2)
+    {
+        fputs("Quantizing a network without weights, that's a bold way to save memory", stderr);
+        return;
+    }
+
+    // The compiled code would keep running the float weights
+    SW_FreeCompiledNetwork(network);
+
+    if (calibrationInput == NULL || calibrationAmount == 0)
+    {
+        fputs("Can't calibrate the quantization without any calibration data", stderr);
+        return;
+    }
+
+    // Calibrate using the float path
+    SW_DequantizeNetwork(network);
+
+    // The output range of each layer, which is the input range of the next one, zero always has to be in there
+    float *Minimum = SW_QuantizeAlloc(sizeof(float) * network->layerAmount);
+    float *Maximum = SW_QuantizeAlloc(sizeof(float) * network->layerAmount);
+
+    for (uint32_t i = 0; i < calibrationAmount; i++)
+    {
+        SW_SetNetworkInput(network, calibrationInput[i]);
+        SW_ExucuteNetwork(network);
+
+        for (uint32_t j = 0; j < network->layerAmount - 1; j++)
+            for (uint32_t k = 0; k < network->layers[j].neuronAmount; k++)
+            {
+                float Output = network->layers[j].neurons[k].output;
+
+                if (Output < Minimum[j])
+                    Minimum[j] = Output;
+                if (Output > Maximum[j])
+                    Maximum[j] = Output;
+            }
+    }
+
+    for (uint32_t i = 1; i < network->layerAmount; i++)
+    {
+        // Convolutions stay in float, the int8 kernels only do dense layers
+        if (network->layers[i].type != SW_LAYER_TYPE_DENSE)
+            continue;
+
+        float Range = Maximum[i - 1] - Minimum[i - 1];
+        float Scale = Range > 1e-8f ? Range / SW_QUANTIZED_INPUT_MAX : 1.0f;
+
+        long ZeroPoint = lroundf(-Minimum[i - 1] / Scale);
+        if (ZeroPoint > SW_QUANTIZED_INPUT_MAX)
+            ZeroPoint = SW_QUANTIZED_INPUT_MAX;
+
+        SW_QuantizeLayer(&network->layers[i], network->layers[i - 1].neuronAmount, Scale, (uint8_t)ZeroPoint);
+    }
+
+    free(Minimum);
+    free(Maximum);
+}
+
+void SW_DequantizeNetwork(SW_Network *network)
+{
+    for (uint32_t i = 0; i < network->layerAmount; i++)
+        SW_FreeQuantizedLayer(&network->layers[i]);
+}
+
+void SW_ExecuteQuantizedLayer(SW_Layer *previousLayer, SW_Layer *currentLayer, SW_Layer *nextLayer)
+{
+    SW_QuantizedLayer *Quantized = currentLayer->quantized;
+
+    // A quantized previous layer already wrote our input while requantizing its own output
+    if (previousLayer->quantized == NULL)
+    {
+        float InverseScale = 1.0f / Quantized->inputScale;
+
+        for (uint32_t i = 0; i < previousLayer->neuronAmount; i++)
+            Quantized->input[i] = SW_QuantizeValue(previousLayer->neurons[i].output, InverseScale, Quantized->inputZeroPoint);
+    }
+
+    SWM_gemmInt8(1, currentLayer->neuronAmount, Quantized->paddedInputAmount, Quantized->input, Quantized->paddedInputAmount, Quantized->weights, Quantized->paddedInputAmount, Quantized->accumulators, currentLayer->neuronAmount);
+
+    SW_QuantizedLayer *NextQuantized = nextLayer != NULL ? nextLayer->quantized : NULL;
+    float NextInverseScale = NextQuantized != NULL ? 1.0f / NextQuantized->inputScale : 0.0f;
+
+    // Requantize, add the bias and apply the activation in one go, and quantize straight into the next layer if possible
+    for (uint32_t i = 0; i < currentLayer->neuronAmount; i++)
+    {
+        float Output = SW_RequantizeOutput(currentLayer, Quantized->accumulators[i], i);
+        currentLayer->neurons[i].output = Output;
+
+        if (NextQuantized != NULL)
+            NextQuantized->input[i] = SW_QuantizeValue(Output, NextInverseScale, NextQuantized->inputZeroPoint);
+    }
+}
+
+// The accumulators come first, then the int8 input, its rows are a multiple of SWM_INT8_K_ALIGNMENT long so both stay aligned
+static size_t SW_AccumulatorSize(SW_Layer *layer, uint32_t batchSize)
+{
+    return (sizeof(int32_t) * batchSize * layer->neuronAmount + SWM_INT8_K_ALIGNMENT - 1) / SWM_INT8_K_ALIGNMENT * SWM_INT8_K_ALIGNMENT;
+}
+
+size_t SW_QuantizedWorkspaceSize(SW_Layer *layer, uint32_t batchSize)
+{
+    return SW_AccumulatorSize(layer, batchSize) + sizeof(uint8_t) * batchSize * layer->quantized->paddedInputAmount;
+}
+
+typedef struct SW_QuantizedBatchTask
+{
+    SW_Layer *layer;
+    const float *input;
+    float *output;
+    int32_t *accumulators;
+    uint8_t *quantizedInput;
+} SW_QuantizedBatchTask;
+
+// Quantizing, the gemm and requantizing all go over the same few samples, they're still in cache for the next step
+static void SW_ExecuteQuantizedSamples(void *context, size_t begin, size_t end, uint32_t thread)
+{
+    (void)thread;
+    SW_QuantizedBatchTask *Task = context;
+    SW_Layer *Layer = Task->layer;
+    SW_QuantizedLayer *Quantized = Layer->quantized;
+    uint32_t InputAmount = Layer->weightColumns;
+    uint32_t PaddedInputAmount = Quantized->paddedInputAmount;
+    float InverseScale = 1.0f / Quantized->inputScale;
+
+    uint8_t *QuantizedInput = &Task->quantizedInput[begin * PaddedInputAmount];
+    int32_t *Accumulators = &Task->accumulators[begin * Layer->neuronAmount];
+
+    for (size_t b = begin; b < end; b++)
+    {
+        const float *Input = &Task->input[b * InputAmount];
+        uint8_t *Row = &Task->quantizedInput[b * PaddedInputAmount];
+
+        for (uint32_t i = 0; i < InputAmount; i++)
+            Row[i] = SW_QuantizeValue(Input[i], InverseScale, Quantized->inputZeroPoint);
+
+        // The padded weights are zero, but the kernels want the input within 7 bits everywhere
+        memset(&Row[InputAmount], 0, PaddedInputAmount - InputAmount);
+    }
+
+    SWM_gemmInt8((uint32_t)(end - begin), Layer->neuronAmount, PaddedInputAmount, QuantizedInput, PaddedInputAmount, Quantized->weights, PaddedInputAmount, Accumulators, Layer->neuronAmount);
+
+    for (size_t b = begin; b < end; b++)
+    {
+        const int32_t *SampleAccumulators = &Task->accumulators[b * Layer->neuronAmount];
+        float *Output = &Task->output[b * Layer->neuronAmount];
+
+        for (uint32_t i = 0; i < Layer->neuronAmount; i++)
+            Output[i] = SW_RequantizeOutput(Layer, SampleAccumulators[i], i);
+    }
+}
+
+void SW_ExecuteQuantizedBatch(SW_Layer *layer, const float *input, float *output, uint32_t batchSize, void *workspace)
+{
+    SW_QuantizedBatchTask Task = { layer, input, output, workspace, (uint8_t *)workspace + SW_AccumulatorSize(layer, batchSize) };
+
+    SWP_parallelFor(0, batchSize, SWP_grainFor((size_t)layer->neuronAmount * layer->quantized->paddedInputAmount), SW_ExecuteQuantizedSamples, &Task);
+}
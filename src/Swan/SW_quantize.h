@@ -0,0 +1,26 @@
+#ifndef SW_QUANTIZE_H
+#define SW_QUANTIZE_H
+
+#include <stdint.h>
+
+#include "SW_types.h"
+
+// Post training int8 quantization
+// Weights get one scale per neuron, the input of every layer gets a scale and zero point calibrated on sample data
+
+void SW_QuantizeNetwork(SW_Network *network, float **calibrationInput, uint32_t calibrationAmount); // calibrationInput should be an array of length calibrationAmount, each containing an array of the size of the first layer
+void SW_DequantizeNetwork(SW_Network *network); // drops the int8 weights, the float weights are kept the whole time
+
+// Lower level functions, mostly used for loading quantized networks
+void SW_QuantizeLayer(SW_Layer *layer, uint32_t inputAmount, float inputScale, uint8_t inputZeroPoint);
+void SW_FreeQuantizedLayer(SW_Layer *layer);
+
+// Runs a layer in int8, nextLayer may be NULL, if it's quantized as well its input gets written directly
+void SW_ExecuteQuantizedLayer(SW_Layer *previousLayer, SW_Layer *currentLayer, SW_Layer *nextLayer);
+
+// The same for batchSize samples of float input, with the int8 input and the accumulators in workspace instead of the layer
+// so several threads can run the same layer, workspace has to be SW_QuantizedWorkspaceSize bytes and 64 byte aligned
+void SW_ExecuteQuantizedBatch(SW_Layer *layer, const float *input, float *output, uint32_t batchSize, void *workspace);
+size_t SW_QuantizedWorkspaceSize(SW_Layer *layer, uint32_t batchSize);
+
+#endif // SW_QUANTIZE_H
@@ -0,0 +1,188 @@
+#include "SW_registry.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+#include "SW_network.h"
+#include "SW_trace.h"
+
+void SW_InitModelRegistry(SW_ModelRegistry *registry)
+{
+    for (uint32_t i = 0; i < SW_REGISTRY_MAX_MODELS; i++)
+    {
+        registry->models[i].name[0] = '\0';
+        atomic_init(&registry->models[i].current, NULL);
+        registry->models[i].versionAmount = 0;
+    }
+
+    atomic_init(&registry->modelAmount, 0);
+    atomic_init(&registry->epoch, 0);
+    atomic_init(&registry->readers[0], 0);
+    atomic_init(&registry->readers[1], 0);
+
+    pthread_mutex_init(&registry->writer, NULL);
+}
+
+// Needs the writer lock, returns once no reader can still have anything it got before the call
+static void SW_WaitForReaders(SW_ModelRegistry *registry)
+{
+    uint64_t TraceBegin = SWP_traceBegin();
+
+    // New readers count under the next epoch, the ones under this one have to be done before anything they saw can go
+    uint64_t Epoch = atomic_fetch_add(&registry->epoch, 1);
+
+    while (atomic_load(&registry->readers[Epoch & 1]) != 0)
+        sched_yield();
+
+    SWP_traceEnd(TraceBegin, "model grace period", "registry", -1);
+}
+
+static void SW_FreeModelVersion(SW_ModelVersion *version)
+{
+    if (version == NULL)
+        return;
+
+    SW_UnloadNetwork(&version->network);
+    free(version);
+}
+
+void SW_FreeModelRegistry(SW_ModelRegistry *registry)
+{
+    for (uint32_t i = 0; i < atomic_load(&registry->modelAmount); i++)
+        SW_FreeModelVersion(atomic_exchange(&registry->models[i].current, NULL));
+
+    pthread_mutex_destroy(&registry->writer);
+}
+
+int32_t SW_FindModel(SW_ModelRegistry *registry, const char *name)
+{
+    uint32_t ModelAmount = atomic_load(&registry->modelAmount);
+
+    for (uint32_t i = 0; i < ModelAmount; i++)
+        if (strncmp(registry->models[i].name, name, SW_MODEL_NAME_LENGTH) == 0)
+            return (int32_t)i;
+
+    return -1;
+}
+
+int32_t SW_LoadModel(SW_ModelRegistry *registry, const char *name, char *fileName)
+{
+    if (strlen(name) >= SW_MODEL_NAME_LENGTH)
+    {
+        fputs("That model name is way too long, nobody is typing that", stderr);
+        return -1;
+    }
+
+    SW_ModelVersion *Version = malloc(sizeof(SW_ModelVersion));
+    if (Version == NULL)
+    {
+        fputs("Please get better RAM", stderr);
+        abort();
+    }
+
+    // Mapping happens before the lock, the current version keeps going while the new one loads
+    SW_InitNetwork(&Version->network);
+    if (!SW_MapNetwork(&Version->network, fileName))
+    {
+        SW_UnloadNetwork(&Version->network);
+        free(Version);
+        return -1;
+    }
+
+    pthread_mutex_lock(&registry->writer);
+
+    // Tuning changes the layers, it has to be done before any reader can see them
+    SW_PrepareNetwork(&Version->network);
+
+    int32_t Model = SW_FindModel(registry, name);
+
+    if (Model < 0)
+    {
+        uint32_t ModelAmount = atomic_load(&registry->modelAmount);
+        if (ModelAmount == SW_REGISTRY_MAX_MODELS)
+        {
+            pthread_mutex_unlock(&registry->writer);
+            fputs("The registry is full, nobody needs that many models", stderr);
+            SW_FreeModelVersion(Version);
+            return -1;
+        }
+
+        // The name is written before the amount says it's there
+        strcpy(registry->models[ModelAmount].name, name);
+        atomic_store(&registry->modelAmount, ModelAmount + 1);
+        Model = (int32_t)ModelAmount;
+    }
+
+    SW_RegisteredModel *Registered = &registry->models[Model];
+    Version->version = ++Registered->versionAmount;
+
+    SW_ModelVersion *Old = atomic_exchange(&Registered->current, Version);
+    if (Old != NULL)
+        SW_WaitForReaders(registry);
+
+    pthread_mutex_unlock(&registry->writer);
+
+    SW_FreeModelVersion(Old);
+
+    return Model;
+}
+
+bool SW_UnloadModel(SW_ModelRegistry *registry, uint32_t model)
+{
+    if (model >= atomic_load(&registry->modelAmount))
+        return false;
+
+    pthread_mutex_lock(&registry->writer);
+
+    SW_ModelVersion *Old = atomic_exchange(&registry->models[model].current, NULL);
+    if (Old != NULL)
+        SW_WaitForReaders(registry);
+
+    pthread_mutex_unlock(&registry->writer);
+
+    SW_FreeModelVersion(Old);
+
+    return Old != NULL;
+}
+
+SW_ModelReference SW_AcquireModel(SW_ModelRegistry *registry, uint32_t model)
+{
+    SW_ModelReference Reference = { NULL, 0, 0 };
+    uint64_t Epoch;
+
+    // Counting under an epoch only holds if the epoch didn't move on in between, otherwise the writer might have looked already
+    for (;;)
+    {
+        Epoch = atomic_load(&registry->epoch);
+        atomic_fetch_add(&registry->readers[Epoch & 1], 1);
+
+        if (atomic_load(&registry->epoch) == Epoch)
+            break;
+
+        atomic_fetch_sub(&registry->readers[Epoch & 1], 1);
+    }
+
+    Reference.epoch = (uint32_t)(Epoch & 1);
+
+    if (model < atomic_load(&registry->modelAmount))
+    {
+        SW_ModelVersion *Version = atomic_load(&registry->models[model].current);
+
+        if (Version != NULL)
+        {
+            Reference.network = &Version->network;
+            Reference.version = Version->version;
+        }
+    }
+
+    return Reference;
+}
+
+void SW_ReleaseModel(SW_ModelRegistry *registry, SW_ModelReference *reference)
+{
+    atomic_fetch_sub(&registry->readers[reference->epoch], 1);
+
+    reference->network = NULL;
+}
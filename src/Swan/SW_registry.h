@@ -0,0 +1,69 @@
+#ifndef SW_REGISTRY_H
+#define SW_REGISTRY_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <pthread.h>
+
+#include "SW_types.h"
+
+// Several networks hosted side by side under a name each, mapped from files made with SW_SaveMappedNetwork
+// Loading a name again swaps in the new version while the old one keeps executing: readers that already have the old one finish with it,
+// new readers get the new one, and the old one gets unloaded once nobody can have it anymore (the grace period)
+// Every process mapping the same file shares its weights, so a version costs its memory once per machine, not per process
+//
+// Readers don't lock anything, they go through SW_AcquireModel and SW_ReleaseModel around using the network
+// Loading, unloading and freeing are one at a time and wait for the readers, never call them between an acquire and its release
+
+#define SW_REGISTRY_MAX_MODELS 64
+#define SW_MODEL_NAME_LENGTH 64
+
+typedef struct SW_ModelVersion
+{
+    SW_Network network;
+    uint32_t version;                               // 1 for the first file loaded under a name, one more for every reload
+} SW_ModelVersion;
+
+typedef struct SW_RegisteredModel
+{
+    char name[SW_MODEL_NAME_LENGTH];
+    _Atomic(SW_ModelVersion *) current;             // NULL once unloaded
+    uint32_t versionAmount;                         // Versions loaded under this name so far
+} SW_RegisteredModel;
+
+typedef struct SW_ModelRegistry
+{
+    SW_RegisteredModel models[SW_REGISTRY_MAX_MODELS];
+    _Atomic uint32_t modelAmount;                   // Names only get added, so an index stays good
+
+    pthread_mutex_t writer;                         // One load or unload at a time
+
+    // Readers count themselves under one of two epochs, a swap moves on to the other one and waits for the old one to empty
+    _Atomic uint64_t epoch;
+    _Alignas(64) _Atomic uint64_t readers[2];
+} SW_ModelRegistry;
+
+// What a reader holds between SW_AcquireModel and SW_ReleaseModel
+typedef struct SW_ModelReference
+{
+    SW_Network *network;                            // NULL if the model isn't loaded
+    uint32_t version;
+    uint32_t epoch;
+} SW_ModelReference;
+
+void SW_InitModelRegistry(SW_ModelRegistry *registry);
+void SW_FreeModelRegistry(SW_ModelRegistry *registry);      // Unloads every model, nobody may be reading anymore
+
+int32_t SW_LoadModel(SW_ModelRegistry *registry, const char *name, char *fileName);    // Maps the file and makes it the name's current version, returns the model's index or -1
+bool SW_UnloadModel(SW_ModelRegistry *registry, uint32_t model);                        // Waits for the readers of the current version, false if it wasn't loaded
+int32_t SW_FindModel(SW_ModelRegistry *registry, const char *name);                    // The index of a name, -1 if it was never loaded
+
+// The network stays usable until the release, even if a new version gets loaded in between
+// Readers of the same version share one network, it got prepared under the writer lock before anyone could see it (SW_PrepareNetwork),
+// so SW_ExecuteNetworkBatch with a workspace each is safe at the same time, anything that changes the network isn't
+SW_ModelReference SW_AcquireModel(SW_ModelRegistry *registry, uint32_t model);
+void SW_ReleaseModel(SW_ModelRegistry *registry, SW_ModelReference *reference);
+
+#endif // SW_REGISTRY_H
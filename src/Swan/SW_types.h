@@ -1,18 +1,18 @@
 #ifndef SW_TYPES_H
 #define SW_TYPES_H
 
+#include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "SW_matrix.h"
 
 typedef struct SW_Neuron
 {
-    float *weights;             // The weights for each connection with a neurons in the previous layer
-    float bias;                 // The bias for the neuron
-
-    float output;               // Its output
+    float *weights;             // The weights for each connection with a neurons in the previous layer (dense layers only)
 
-    // These are used during back propagation for the previous layer
-    float error;
-    float activationDerivative;
+    float output;               // Its output, training keeps its activations and errors in the workspace instead
 } SW_Neuron;
 
 typedef enum SW_ActivationFunction
@@ -20,15 +20,153 @@ typedef enum SW_ActivationFunction
     SW_ACTIVATION_FUNCTION_RELU = 0,
     SW_ACTIVATION_FUNCTION_SOFTMAX,
     SW_ACTIVATION_FUNCTION_SIGMOID,
-    SW_ACTIVATION_FUNCTION_TANH
+    SW_ACTIVATION_FUNCTION_TANH,
+    SW_ACTIVATION_FUNCTION_NONE
 } SW_ActivationFunction;
 
+typedef enum SW_LayerType
+{
+    SW_LAYER_TYPE_DENSE = 0,
+    SW_LAYER_TYPE_CONVOLUTION,
+    SW_LAYER_TYPE_POOLING
+} SW_LayerType;
+
+// How a convolution gets executed, training always goes through im2col
+typedef enum SW_ConvolutionAlgorithm
+{
+    SW_CONVOLUTION_ALGORITHM_AUTO = 0,  // Times the others on the first execution, or in SW_PrepareNetwork, and keeps the fastest
+    SW_CONVOLUTION_ALGORITHM_IM2COL,
+    SW_CONVOLUTION_ALGORITHM_DIRECT,    // Output channels in blocks of 8, no im2col buffer
+    SW_CONVOLUTION_ALGORITHM_WINOGRAD   // F(2x2, 3x3), only for 3x3 kernels with a stride of 1
+} SW_ConvolutionAlgorithm;
+
 typedef enum SW_LossFunction
 {
     SW_LOSS_FUNCTION_CROSS_ENTROPY = 0,
     SW_LOSS_FUNCTION_MEAN_SQUARED_ERROR
 } SW_LossFunction;
 
+// The int8 version of a layer's weights, made by SW_QuantizeNetwork
+typedef struct SW_QuantizedLayer
+{
+    int8_t *weights;            // neuronAmount rows of paddedInputAmount weights, padding is zero
+    float *weightScales;        // One scale per neuron (the per channel scale)
+    int32_t *weightSums;        // The sum of each row, used to cancel out the input zero point
+
+    uint32_t paddedInputAmount;
+
+    // Calibrated on sample data, maps the previous layer's outputs to [0, 127]
+    float inputScale;
+    uint8_t inputZeroPoint;
+
+    // Scratch buffers for execution
+    uint8_t *input;
+    int32_t *accumulators;
+} SW_QuantizedLayer;
+
+// A 2D convolution over the previous layer's output, seen as channels x height x width
+typedef struct SW_Convolution
+{
+    uint32_t kernelSize;
+    uint32_t stride;
+    uint32_t padding;
+
+    uint32_t inputChannels, inputHeight, inputWidth;
+
+    SW_ConvolutionAlgorithm algorithm;
+
+    // im2col buffers for training a single image, (inputChannels * kernelSize * kernelSize) x (output height * output width), only made once used
+    float *columns;
+    float *columnErrors;
+
+    // Copies of the weights in the layout of the other algorithms, remade after the weights change
+    float *blockedWeights;      // [output channels / 8][inputChannels][kernelSize][kernelSize][8]
+    float *winogradWeights;     // [16][output channels][inputChannels]
+
+    // What the algorithm needs while executing one image, the im2col columns, the padded input of the direct kernel or the winograd tiles
+    // Only SW_ExecuteConvolution uses this one, batches have theirs in the inference workspace so threads can share the layer
+    float *scratch;
+} SW_Convolution;
+
+typedef enum SW_PoolingType
+{
+    SW_POOLING_TYPE_MAX = 0,
+    SW_POOLING_TYPE_AVERAGE,
+    SW_POOLING_TYPE_GLOBAL_AVERAGE  // One output per channel, size and stride are the whole image
+} SW_PoolingType;
+
+// Pooling over size x size windows of the previous layer's output, per channel, without padding
+typedef struct SW_Pooling
+{
+    SW_PoolingType type;
+    uint32_t size;
+    uint32_t stride;
+
+    uint32_t inputChannels, inputHeight, inputWidth;
+} SW_Pooling;
+
+struct SW_Layer;
+struct SW_Network;
+
+// Everything a layer gets to go forward or backward over a whole batch, each row is one sample
+typedef struct SW_LayerBatch
+{
+    uint32_t batchSize;
+    bool inference;                 // Forward only, the input is float, the workspace is only scratch and nothing has to be kept for backward
+    SWM_Type type;                  // The type of input and outputError
+    const void *input;              // The previous layer's outputs
+    const void *weights;            // The weights in weightType, the float weights or a copy made for training
+    SWM_Type weightType;
+    void *workspace;                // workspaceSize bytes for this layer alone, it stays the same between forward and backward
+                                    // When inferring it's inferenceWorkspaceSize bytes of scratch instead, shared with the other layers
+
+    float *output;                  // Forward: this layer's outputs, after the bias and activation
+
+    const void *outputError;        // Backward: the error of this layer before the activation, in type
+    const float *outputErrorFloat;  // The same error as float
+    float gradientScale;            // The gradients get multiplied with this
+    float *weightGradient;          // Overwritten, not added to
+    float *biasGradient;
+    float *inputError;              // The error of the previous layer's outputs, NULL when nothing needs it
+} SW_LayerBatch;
+
+// What a layer trains, a rows x columns matrix of weights with a bias for each row
+typedef struct SW_LayerParams
+{
+    float *weights;
+    float *biases;
+    uint32_t rows, columns;
+} SW_LayerParams;
+
+// What makes each type of layer its own, the network only goes through these
+typedef struct SW_LayerInterface
+{
+    void (*forwardBatch)(struct SW_Layer *layer, SW_LayerBatch *batch);
+    void (*backwardBatch)(struct SW_Layer *layer, SW_LayerBatch *batch);
+
+    // Inference on a single sample, from the outputs of the previous layer's neurons to this layer's neurons
+    void (*execute)(struct SW_Network *network, uint32_t layerIndex);
+
+    SW_LayerParams (*params)(struct SW_Layer *layer);
+
+    // Bytes of workspace forwardBatch and backwardBatch need for batchSize samples
+    size_t (*workspaceSize)(struct SW_Layer *layer, uint32_t batchSize);
+
+    // Bytes of scratch forwardBatch needs for batchSize samples when it's only inferring, NULL if it doesn't need any
+    size_t (*inferenceWorkspaceSize)(struct SW_Layer *layer, uint32_t batchSize);
+
+    // Does what the first inference would otherwise do to the layer (tuning, copies of the weights), NULL if there's nothing
+    // After that inference only reads the layer
+    void (*prepare)(struct SW_Layer *layer);
+
+    // The settings of the layer besides its shape and weights (NULL if there are none), save writes them to settings unless it's NULL and returns their size
+    // load reads them back and adds the layer to the network
+    size_t (*save)(struct SW_Layer *layer, void *settings);
+    void (*load)(struct SW_Network *network, uint32_t neuronAmount, SW_ActivationFunction activationFunction, const uint32_t shape[3], FILE *file);
+
+    void (*free)(struct SW_Layer *layer);   // Frees what only this type of layer has, NULL if there's nothing
+} SW_LayerInterface;
+
 typedef struct SW_Layer
 {
     SW_Neuron *neurons;
@@ -36,13 +174,109 @@ typedef struct SW_Layer
     uint32_t neuronAmount;
 
     SW_ActivationFunction activationFunction;
+
+    SW_LayerType type;
+    const SW_LayerInterface *implementation;
+    uint32_t channels, height, width;   // The shape of the output, channels x 1 x 1 for dense layers
+    SW_Convolution *convolution;        // NULL unless type is SW_LAYER_TYPE_CONVOLUTION
+    SW_Pooling *pooling;                // NULL unless type is SW_LAYER_TYPE_POOLING, pooling layers don't have weights
+
+    // The weights are a weightRows x weightColumns matrix, dense layers have one row per neuron and convolutions one per output channel
+    uint32_t weightRows, weightColumns;
+    float *weights;               // All weights of the layer in one block, each neuron's weights point to its own row in here
+    float *biases;                // One per weight row
+    SWM_Type weightType;          // The type the weights are streamed as during execution, the float weights stay the master copy
+    void *halfWeights;            // The bfloat16 or float16 copy of weights, NULL when weightType is SWM_TYPE_FLOAT32
+
+    SW_QuantizedLayer *quantized; // NULL unless the network was quantized
+
+    uint8_t *pruneMask;           // 0 for every pruned weight, those stay zero while training, NULL if nothing was pruned
+    SWM_CsrMatrix *sparseWeights; // The weights as a sparse matrix, only made when the layer is sparse enough for that to be faster
 } SW_Layer;
 
+typedef enum SW_PruneScope
+{
+    SW_PRUNE_SCOPE_GLOBAL = 0,    // One magnitude threshold for all weights in the network
+    SW_PRUNE_SCOPE_LAYER          // Every layer gets pruned to the same sparsity
+} SW_PruneScope;
+
+// How SW_RemoveNeurons decides which neurons matter least
+typedef enum SW_NeuronScore
+{
+    SW_NEURON_SCORE_WEIGHT_NORM = 0,  // Size of the incoming weights times size of the outgoing weights
+    SW_NEURON_SCORE_ACTIVATION        // Average output on a dataset times size of the outgoing weights
+} SW_NeuronScore;
+
+// Prunes a little more after every training pass, see SW_SetPruningSchedule
+typedef struct SW_PruningSchedule
+{
+    float targetSparsity;
+    SW_PruneScope scope;
+    uint32_t passAmount;
+    uint32_t passesDone;
+} SW_PruningSchedule;
+
+// The forward pass of a network as x86-64 machine code, see SW_CompileNetwork
+typedef struct SW_CompiledNetwork
+{
+    void *memory;               // The code with the weights right after it, mapped executable
+    size_t size;
+    void (*execute)(const float *input, float *output);
+} SW_CompiledNetwork;
+
+// What a layer was doing, for the profiler
+typedef enum SW_ProfilePhase
+{
+    SW_PROFILE_PHASE_FORWARD = 0,   // Executing, and going forward while training (recomputed segments included)
+    SW_PROFILE_PHASE_BACKWARD,      // The gradients and passing the error back through the previous layer's activation
+    SW_PROFILE_PHASE_UPDATE,        // Applying the gradients to the weights
+    SW_PROFILE_PHASE_AMOUNT
+} SW_ProfilePhase;
+
+// Totals of one layer and phase, the flops and bytes are worked out from the shape of the layer
+typedef struct SW_ProfileCounter
+{
+    uint64_t calls;
+    uint64_t nanoseconds;
+    uint64_t flops;
+    uint64_t bytes;
+} SW_ProfileCounter;
+
+// What SW_QueryWorkspaceSize plans the workspace for
+typedef enum SW_WorkspaceUse
+{
+    SW_WORKSPACE_USE_INFERENCE = 0,   // SW_ExecuteNetworkBatch, two buffers the layers take turns on
+    SW_WORKSPACE_USE_TRAINING         // SW_TrainNeuralNetwork, every activation, error, gradient and layer workspace of a step
+} SW_WorkspaceUse;
+
 typedef struct SW_Network
 {
     SW_Layer *layers;
 
     uint32_t layerAmount;
+
+    float *executionBuffer;       // Room for the input and output of the widest layer while executing
+
+    void *workspace;              // Memory from the caller for training, NULL to let training allocate its own, see SW_SetNetworkWorkspace
+    size_t workspaceSize;
+    size_t trainingMemoryBudget;  // What the training workspace may take, 0 for no limit, see SW_SetTrainingMemoryBudget
+    uint32_t checkpointInterval;  // Only every checkpointInterval-th layer keeps its activations while training, picked from the budget
+
+    SWM_Type trainingType;        // The type the training gemms run in, see SW_SetTrainingType
+    float lossScale;              // Dynamic loss scale for half precision training
+    uint32_t lossScaleGoodSteps;  // Steps since the loss scale last overflowed
+
+    SW_PruningSchedule pruningSchedule;
+
+    SW_CompiledNetwork *compiled; // NULL unless SW_CompileNetwork worked, dropped whenever the weights change
+
+    SW_ProfileCounter *profile;   // layerAmount x SW_PROFILE_PHASE_AMOUNT, only filled in when Swan is built with SW_PROFILE
+    uint32_t profileLayerAmount;  // The layers profile has room for, adding layers starts it over
+
+    void *mapping;                // The file SW_MapNetwork mapped, the weights and biases of the layers point into it, NULL otherwise
+    size_t mappingSize;
+
+    struct SW_Autosave *autosave; // NULL unless SW_StartAutosave was called
 } SW_Network;
 
 #endif // SW_TYPES_H
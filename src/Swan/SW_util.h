@@ -2,8 +2,11 @@
 #define SW_UTIL_H
 
 #include <stdint.h>
+#include <stdio.h>
 #include <math.h>
 
+#include "SW_types.h"
+
 static inline float SW_Sigmoid(float input)
 {
     return 1.0f / (1.0f + expf(-input));
@@ -63,5 +66,57 @@ static inline float SW_CrossEntropy(float *p, float *q, uint32_t nValues)
     return -r;
 }
 
+static inline float SW_ApplyActivation(float input, SW_ActivationFunction activationFunction)
+{
+    switch (activationFunction)
+    {
+    case SW_ACTIVATION_FUNCTION_RELU:
+        return SW_ReLu(input);
+
+    case SW_ACTIVATION_FUNCTION_SOFTMAX:
+        // unimplemented
+        return input;
+
+    case SW_ACTIVATION_FUNCTION_SIGMOID:
+        return SW_Sigmoid(input);
+
+    case SW_ACTIVATION_FUNCTION_TANH:
+        return SW_Tanh(input);
+
+    case SW_ACTIVATION_FUNCTION_NONE:
+        return input;
+
+    default:
+        fputs("OH GOD YOU HAVE NO ACTIVATION FUNCTION WHAT HAVE YOU DONE", stderr);
+        return 0.0f;
+    }
+}
+
+/* expects the output of the activation function, not its input */
+static inline float SW_ApplyActivationDerivative(float output, SW_ActivationFunction activationFunction)
+{
+    switch (activationFunction)
+    {
+    case SW_ACTIVATION_FUNCTION_RELU:
+        return SW_ReLu_Derivative(output);
+
+    case SW_ACTIVATION_FUNCTION_SOFTMAX:
+        // unimplemented
+        return 0.0f;
+
+    case SW_ACTIVATION_FUNCTION_SIGMOID:
+        return SW_Sigmoid_Derivative(output);
+
+    case SW_ACTIVATION_FUNCTION_TANH:
+        return SW_Tanh_Derivative(output);
+
+    case SW_ACTIVATION_FUNCTION_NONE:
+        return 1.0f;
+
+    default:
+        fputs("Uh oh there's no activation function here", stderr);
+        return 0.0f;
+    }
+}
 
 #endif // SW_UTIL_H
\ No newline at end of file
@@ -0,0 +1,270 @@
+#include "SW_workspace.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "SW_types.h"
+#include "SW_matrix.h"
+
+static size_t SW_AlignSize(size_t size)
+{
+    return (size + SW_WORKSPACE_ALIGNMENT - 1) / SW_WORKSPACE_ALIGNMENT * SW_WORKSPACE_ALIGNMENT;
+}
+
+void *SW_AlignWorkspace(void *workspace)
+{
+    return (void *)SW_AlignSize((uintptr_t)workspace);
+}
+
+void *SW_WorkspaceBufferAt(void *workspace, const SW_WorkspaceBuffer *buffer)
+{
+    return buffer->size != 0 ? (char *)workspace + buffer->offset : NULL;
+}
+
+size_t SW_PlanWorkspace(SW_WorkspaceBuffer *buffers, uint32_t bufferAmount)
+{
+    // Biggest buffers first, each one goes in the lowest spot that doesn't overlap a placed buffer it's alive together with
+    uint32_t *Order = malloc(sizeof(uint32_t) * (bufferAmount + 1));
+    if (Order == NULL)
+    {
+        fputs("Not even the plan for the memory fits in memory", stderr);
+        abort();
+    }
+
+    uint32_t OrderAmount = 0;
+    for (uint32_t i = 0; i < bufferAmount; i++)
+    {
+        buffers[i].offset = 0;
+        if (buffers[i].size == 0) continue;
+
+        uint32_t j = OrderAmount++;
+        for (; j > 0 && buffers[Order[j - 1]].size < buffers[i].size; j--)
+            Order[j] = Order[j - 1];
+        Order[j] = i;
+    }
+
+    size_t Total = 0;
+
+    for (uint32_t i = 0; i < OrderAmount; i++)
+    {
+        SW_WorkspaceBuffer *Buffer = &buffers[Order[i]];
+        size_t Size = SW_AlignSize(Buffer->size);
+        size_t Offset = 0;
+
+        // Every time the spot overlaps something move past it and check everything again, the placed buffers aren't sorted by offset
+        bool Moved = true;
+        while (Moved)
+        {
+            Moved = false;
+
+            for (uint32_t j = 0; j < i; j++)
+            {
+                SW_WorkspaceBuffer *Placed = &buffers[Order[j]];
+
+                if (Placed->lastUse < Buffer->firstUse || Buffer->lastUse < Placed->firstUse)
+                    continue;
+
+                if (Offset < Placed->offset + SW_AlignSize(Placed->size) && Placed->offset < Offset + Size)
+                {
+                    Offset = Placed->offset + SW_AlignSize(Placed->size);
+                    Moved = true;
+                }
+            }
+        }
+
+        Buffer->offset = Offset;
+        if (Offset + Size > Total)
+            Total = Offset + Size;
+    }
+
+    free(Order);
+
+    return Total;
+}
+
+uint32_t SW_LastCheckpoint(uint32_t layerAmount, uint32_t checkpointInterval)
+{
+    // Without checkpointing every layer keeps everything, as if it was all one last segment
+    if (checkpointInterval <= 1 || layerAmount < 2)
+        return 0;
+
+    return (layerAmount - 2) / checkpointInterval * checkpointInterval;
+}
+
+size_t SW_PlanTrainingWorkspace(SW_Network *network, uint32_t batchSize, uint32_t checkpointInterval, SW_WorkspaceBuffer *buffers)
+{
+    // A step goes forward through layer i at step i, gets the loss at step L, goes backward through layer i at step 2L - i and updates at step 2L
+    // A segment that gets recomputed does so at the step its top layer goes backward
+    uint32_t LayerAmount = network->layerAmount;
+    uint32_t Update = 2 * LayerAmount;
+    uint32_t Interval = checkpointInterval > 1 ? checkpointInterval : 1;
+    uint32_t LastCheckpoint = SW_LastCheckpoint(LayerAmount, Interval);
+    SWM_Type TrainingType = network->trainingType;
+    size_t TypeSize = SWM_typeSize(TrainingType);
+
+    uint32_t WidestLayer = 0;
+    for (uint32_t i = 0; i < LayerAmount; i++)
+        if (network->layers[i].neuronAmount > WidestLayer)
+            WidestLayer = network->layers[i].neuronAmount;
+
+    size_t ForwardOutputSize = 0;
+    size_t ForwardLayerSize = 0;
+
+    for (uint32_t i = 0; i < LayerAmount; i++)
+    {
+        SW_Layer *CurrentLayer = &network->layers[i];
+        SW_WorkspaceBuffer *Buffers = &buffers[i * SW_TRAINING_BUFFER_AMOUNT];
+        size_t OutputSize = TypeSize * batchSize * CurrentLayer->neuronAmount;
+
+        bool Checkpoint = i % Interval == 0;
+        bool LastSegment = i > LastCheckpoint;
+        uint32_t Top = i == 0 ? 0 : ((i - 1) / Interval + 1) * Interval;
+        uint32_t Recompute = LastSegment ? i : Update - Top;
+
+        for (uint32_t j = 0; j < SW_TRAINING_BUFFER_AMOUNT; j++)
+            Buffers[j] = (SW_WorkspaceBuffer){ 0, 0, 0, 0 };
+
+        // The next layer needs the outputs again when it goes backward, the loss reads the outputs of the last layer as float
+        if (i + 1 < LayerAmount)
+            Buffers[SW_TRAINING_BUFFER_ACTIVATIONS] = (SW_WorkspaceBuffer){ OutputSize, Checkpoint ? i : Recompute, Update - (i + 1), 0 };
+
+        if (!Checkpoint && !LastSegment && i + 1 < LayerAmount && OutputSize > ForwardOutputSize)
+            ForwardOutputSize = OutputSize;
+
+        if (i == 0) continue;
+
+        // Made by the layer after it (or the loss) right before this layer goes backward, so errors fit where the activations of later layers were
+        Buffers[SW_TRAINING_BUFFER_ERRORS] = (SW_WorkspaceBuffer){ OutputSize, Update - i - 1, Update - i, 0 };
+
+        size_t LayerSize = CurrentLayer->implementation->workspaceSize(CurrentLayer, batchSize);
+        Buffers[SW_TRAINING_BUFFER_LAYER] = (SW_WorkspaceBuffer){ LayerSize, Recompute, Update - i, 0 };
+
+        if (!LastSegment && LayerSize > ForwardLayerSize)
+            ForwardLayerSize = LayerSize;
+
+        SW_LayerParams Params = CurrentLayer->implementation->params(CurrentLayer);
+        size_t WeightAmount = (size_t)Params.rows * Params.columns;
+
+        Buffers[SW_TRAINING_BUFFER_WEIGHT_GRADIENT] = (SW_WorkspaceBuffer){ sizeof(float) * WeightAmount, Update - i, Update, 0 };
+        Buffers[SW_TRAINING_BUFFER_BIAS_GRADIENT] = (SW_WorkspaceBuffer){ sizeof(float) * Params.rows, Update - i, Update, 0 };
+
+        // Copies live as long as the training does
+        if (TrainingType != SWM_TYPE_FLOAT32 && WeightAmount != 0 && CurrentLayer->weightType != TrainingType)
+            Buffers[SW_TRAINING_BUFFER_WEIGHT_COPY] = (SW_WorkspaceBuffer){ TypeSize * WeightAmount, 0, Update, 0 };
+    }
+
+    size_t SharedSize = sizeof(float) * batchSize * WidestLayer;
+    buffers[SW_TRAINING_BUFFER_SCRATCH(LayerAmount)] = (SW_WorkspaceBuffer){ SharedSize, 0, Update, 0 };
+    buffers[SW_TRAINING_BUFFER_PREVIOUS_OUTPUTS(LayerAmount)] = (SW_WorkspaceBuffer){ SharedSize, 0, Update, 0 };
+    buffers[SW_TRAINING_BUFFER_PREVIOUS_ERRORS(LayerAmount)] = (SW_WorkspaceBuffer){ SharedSize, 0, Update, 0 };
+
+    // Only needed during the forward pass
+    buffers[SW_TRAINING_BUFFER_FORWARD_OUTPUTS(LayerAmount)] = (SW_WorkspaceBuffer){ ForwardOutputSize, 0, LayerAmount, 0 };
+    buffers[SW_TRAINING_BUFFER_FORWARD_OUTPUTS(LayerAmount) + 1] = (SW_WorkspaceBuffer){ ForwardOutputSize, 0, LayerAmount, 0 };
+    buffers[SW_TRAINING_BUFFER_FORWARD_LAYER(LayerAmount)] = (SW_WorkspaceBuffer){ ForwardLayerSize, 0, LayerAmount, 0 };
+
+    return SW_PlanWorkspace(buffers, SW_TRAINING_BUFFER_TOTAL(LayerAmount));
+}
+
+uint32_t SW_ChooseCheckpointInterval(SW_Network *network, uint32_t batchSize, SW_WorkspaceBuffer *buffers)
+{
+    if (network->trainingMemoryBudget == 0)
+        return 1;
+
+    uint32_t BestInterval = 1;
+    size_t BestSize = SIZE_MAX;
+
+    // Longer segments keep fewer activations but hold more of them at once while recomputing, so the size doesn't just go down with the interval
+    for (uint32_t Interval = 1; Interval < network->layerAmount; Interval++)
+    {
+        size_t Size = SW_PlanTrainingWorkspace(network, batchSize, Interval, buffers);
+
+        if (Size <= network->trainingMemoryBudget)
+            return Interval;
+
+        if (Size < BestSize)
+        {
+            BestSize = Size;
+            BestInterval = Interval;
+        }
+    }
+
+    fputs("Training doesn't fit in that memory budget even with checkpointing, using as little as it can\n", stderr);
+
+    return BestInterval;
+}
+
+size_t SW_PlanInferenceWorkspace(SW_Network *network, uint32_t batchSize, size_t *secondOffset, size_t *scratchOffset)
+{
+    // The first layer reads the caller's input and the last one writes the caller's output, only the layers in between need a buffer
+    size_t Sizes[2] = { 0, 0 };
+    size_t ScratchSize = 0;
+
+    for (uint32_t i = 1; i < network->layerAmount; i++)
+    {
+        SW_Layer *CurrentLayer = &network->layers[i];
+
+        if (i + 1 < network->layerAmount)
+        {
+            size_t Size = sizeof(float) * batchSize * CurrentLayer->neuronAmount;
+
+            if (Size > Sizes[(i + 1) % 2])
+                Sizes[(i + 1) % 2] = Size;
+        }
+
+        // One layer runs at a time, they can all have the same scratch
+        if (CurrentLayer->implementation->inferenceWorkspaceSize != NULL)
+        {
+            size_t Size = CurrentLayer->implementation->inferenceWorkspaceSize(CurrentLayer, batchSize);
+
+            if (Size > ScratchSize)
+                ScratchSize = Size;
+        }
+    }
+
+    *secondOffset = SW_AlignSize(Sizes[0]);
+    *scratchOffset = *secondOffset + SW_AlignSize(Sizes[1]);
+
+    return *scratchOffset + SW_AlignSize(ScratchSize);
+}
+
+size_t SW_QueryWorkspaceSize(SW_Network *network, uint32_t batchSize, SW_WorkspaceUse use)
+{
+    if (network->layerAmount < 2 || batchSize == 0)
+        return 0;
+
+    size_t Size;
+
+    if (use == SW_WORKSPACE_USE_INFERENCE)
+    {
+        size_t SecondOffset, ScratchOffset;
+        Size = SW_PlanInferenceWorkspace(network, batchSize, &SecondOffset, &ScratchOffset);
+    }
+    else
+    {
+        SW_WorkspaceBuffer *Buffers = malloc(sizeof(SW_WorkspaceBuffer) * SW_TRAINING_BUFFER_TOTAL(network->layerAmount));
+        if (Buffers == NULL)
+        {
+            fputs("Not even the plan for the memory fits in memory", stderr);
+            abort();
+        }
+
+        Size = SW_PlanTrainingWorkspace(network, batchSize, SW_ChooseCheckpointInterval(network, batchSize, Buffers), Buffers);
+        free(Buffers);
+    }
+
+    // Room to align whatever the caller hands over
+    return Size + SW_WORKSPACE_ALIGNMENT - 1;
+}
+
+void SW_SetNetworkWorkspace(SW_Network *network, void *workspace, size_t workspaceSize)
+{
+    network->workspace = workspace;
+    network->workspaceSize = workspace != NULL ? workspaceSize : 0;
+}
+
+void SW_SetTrainingMemoryBudget(SW_Network *network, size_t memoryBudget)
+{
+    network->trainingMemoryBudget = memoryBudget;
+}
@@ -0,0 +1,79 @@
+#ifndef SW_WORKSPACE_H
+#define SW_WORKSPACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "SW_types.h"
+
+// Every buffer in a workspace starts on a cache line
+#define SW_WORKSPACE_ALIGNMENT 64
+
+// Bytes of workspace SW_ExecuteNetworkBatch or SW_TrainNeuralNetwork need for batches of up to batchSize samples, any alignment will do
+// Quantized layers need scratch of their own for inference, ask again after SW_QuantizeNetwork
+size_t SW_QueryWorkspaceSize(SW_Network *network, uint32_t batchSize, SW_WorkspaceUse use);
+
+// Lets training run in memory from the caller instead of allocating its own, NULL to go back to that
+// The memory has to stay around until training is done and the network never frees it
+void SW_SetNetworkWorkspace(SW_Network *network, void *workspace, size_t workspaceSize);
+
+// Gradient checkpointing, training keeps the activations of only every k-th layer and recomputes the others going backward
+// k is the smallest that fits the training workspace in memoryBudget bytes, 0 keeps every activation again
+void SW_SetTrainingMemoryBudget(SW_Network *network, size_t memoryBudget);
+
+// A buffer that's needed from step firstUse to step lastUse, buffers that are never needed at the same time get the same memory
+typedef struct SW_WorkspaceBuffer
+{
+    size_t size;
+    uint32_t firstUse, lastUse;
+    size_t offset;              // Filled in by SW_PlanWorkspace
+} SW_WorkspaceBuffer;
+
+// Packs the buffers into one block, returns its size, buffers with a size of 0 get no memory
+size_t SW_PlanWorkspace(SW_WorkspaceBuffer *buffers, uint32_t bufferAmount);
+
+// The buffers of every layer in a training step, the buffer of layer i and kind k is at i * SW_TRAINING_BUFFER_AMOUNT + k
+typedef enum SW_TrainingBuffer
+{
+    SW_TRAINING_BUFFER_ACTIVATIONS = 0, // The outputs of the layer in the training type
+    SW_TRAINING_BUFFER_ERRORS,          // The error before the activation in the training type
+    SW_TRAINING_BUFFER_LAYER,           // The workspace of the layer itself
+    SW_TRAINING_BUFFER_WEIGHT_GRADIENT,
+    SW_TRAINING_BUFFER_BIAS_GRADIENT,
+    SW_TRAINING_BUFFER_WEIGHT_COPY,     // Half precision weights the layer doesn't have already
+    SW_TRAINING_BUFFER_AMOUNT
+} SW_TrainingBuffer;
+
+// After all the layers come the float buffers of batchSize x the widest layer, used by every layer
+#define SW_TRAINING_BUFFER_SCRATCH(layerAmount) ((layerAmount) * SW_TRAINING_BUFFER_AMOUNT)
+#define SW_TRAINING_BUFFER_PREVIOUS_OUTPUTS(layerAmount) ((layerAmount) * SW_TRAINING_BUFFER_AMOUNT + 1)
+#define SW_TRAINING_BUFFER_PREVIOUS_ERRORS(layerAmount) ((layerAmount) * SW_TRAINING_BUFFER_AMOUNT + 2)
+
+// With checkpointing the forward pass runs the layers that get recomputed later on these, two outputs to take turns on and one layer workspace
+#define SW_TRAINING_BUFFER_FORWARD_OUTPUTS(layerAmount) ((layerAmount) * SW_TRAINING_BUFFER_AMOUNT + 3)
+#define SW_TRAINING_BUFFER_FORWARD_LAYER(layerAmount) ((layerAmount) * SW_TRAINING_BUFFER_AMOUNT + 5)
+#define SW_TRAINING_BUFFER_TOTAL(layerAmount) ((layerAmount) * SW_TRAINING_BUFFER_AMOUNT + 6)
+
+// The layers go in segments of checkpointInterval, each starting after a layer that keeps its activations (a checkpoint)
+// Before going backward through a segment its layers go forward again, except for the last segment which keeps everything from the forward pass
+// Returns the checkpoint that starts the last segment, every layer after it keeps its activations and workspace
+uint32_t SW_LastCheckpoint(uint32_t layerAmount, uint32_t checkpointInterval);
+
+// Fills in SW_TRAINING_BUFFER_TOTAL buffers and plans them, returns the size of the workspace
+size_t SW_PlanTrainingWorkspace(SW_Network *network, uint32_t batchSize, uint32_t checkpointInterval, SW_WorkspaceBuffer *buffers);
+
+// The smallest checkpoint interval that fits in the network's memory budget, or the one that needs the least memory if none fit
+uint32_t SW_ChooseCheckpointInterval(SW_Network *network, uint32_t batchSize, SW_WorkspaceBuffer *buffers);
+
+// Inference only ever needs the input and output of one layer, so the layers take turns on two buffers
+// Layers with an odd index write to the first one, after the second one comes the scratch of the layer that needs the most
+// Returns the size of the workspace and where the second buffer and the scratch start
+size_t SW_PlanInferenceWorkspace(SW_Network *network, uint32_t batchSize, size_t *secondOffset, size_t *scratchOffset);
+
+// Where a planned buffer is in a workspace, NULL if it has no size
+void *SW_WorkspaceBufferAt(void *workspace, const SW_WorkspaceBuffer *buffer);
+
+// Rounds a pointer up to SW_WORKSPACE_ALIGNMENT
+void *SW_AlignWorkspace(void *workspace);
+
+#endif // SW_WORKSPACE_H
@@ -6,5 +6,18 @@
 
 #include "SW_types.h"
 #include "SW_network.h"
+#include "SW_layer.h"
+#include "SW_dense.h"
+#include "SW_quantize.h"
+#include "SW_prune.h"
+#include "SW_convolution.h"
+#include "SW_pooling.h"
+#include "SW_workspace.h"
+#include "SW_jit.h"
+#include "SW_parallel.h"
+#include "SW_profile.h"
+#include "SW_registry.h"
+#include "SW_autosave.h"
+#include "SW_trace.h"
 
 #endif // SWAN_H
\ No newline at end of file
@@ -3,7 +3,11 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <pthread.h>
+
 #include "SW_matrix.h"
+#include "SW_matrix_kernels.h"
+#include "SW_parallel.h"
 
 // matrix operations
 
@@ -66,6 +70,494 @@ SWM_Matrix SWM_multiplyScalar(SWM_Matrix *a, float scalar)
 }
 
 
+// dispatch
+
+static SWM_Kernels SWM_selectedKernels;
+static pthread_once_t SWM_kernelsOnce = PTHREAD_ONCE_INIT;
+
+/* the best of every kernel the CPU can run, SWAN_ISA=generic or avx2 stops it from going further to compare them on one machine */
+static void SWM_selectKernels(void)
+{
+    SWM_Kernels *kernels = &SWM_selectedKernels;
+    *kernels = (SWM_Kernels){ SWM_convertToFloatScalar, SWM_convertFromFloatScalar, SWM_gemmKernelGeneric, SWM_csrRowDotGeneric, SWM_gemmInt8Scalar, SWM_convolutionTileGeneric, SWM_poolRowGeneric, SWM_sumGeneric, "generic" };
+
+#ifdef SWM_X86
+    const char *limit = getenv("SWAN_ISA");
+    if (limit != NULL && *limit != '\0' && strcmp(limit, "generic") != 0 && strcmp(limit, "avx2") != 0 && strcmp(limit, "avx512") != 0)
+    {
+        fputs("SWAN_ISA can be generic, avx2 or avx512, using whatever the CPU has instead\n", stderr);
+        limit = NULL;
+    }
+
+    bool allowAvx2 = limit == NULL || *limit == '\0' || strcmp(limit, "generic") != 0;
+    bool allowAvx512 = allowAvx2 && (limit == NULL || *limit == '\0' || strcmp(limit, "avx512") == 0);
+
+    __builtin_cpu_init();
+
+    if (!allowAvx2 || !__builtin_cpu_supports("avx2") || !__builtin_cpu_supports("fma") || !__builtin_cpu_supports("f16c"))
+        return;
+
+    kernels->convertToFloat = SWM_convertToFloatAvx2;
+    kernels->convertFromFloat = SWM_convertFromFloatAvx2;
+    kernels->gemm = SWM_gemmKernelAvx2;
+    kernels->csrRowDot = SWM_csrRowDotAvx2;
+    kernels->gemmInt8 = SWM_gemmInt8Avx2;
+    kernels->convolutionTile = SWM_convolutionTileAvx2;
+    kernels->poolRow = SWM_poolRowAvx2;
+    kernels->sum = SWM_sumAvx2;
+    kernels->name = "avx2";
+
+    if (!allowAvx512)
+        return;
+
+    if (__builtin_cpu_supports("avx512bf16"))
+    {
+        kernels->convertFromFloat = SWM_convertFromFloatAvx512Bf16;
+        kernels->name = "avx512";
+    }
+
+    if (__builtin_cpu_supports("avx512vnni") && __builtin_cpu_supports("avx512bw"))
+    {
+        kernels->gemmInt8 = SWM_gemmInt8Avx512Vnni;
+        kernels->name = "avx512";
+    }
+#endif
+}
+
+const SWM_Kernels *SWM_kernels(void)
+{
+    pthread_once(&SWM_kernelsOnce, SWM_selectKernels);
+    return &SWM_selectedKernels;
+}
+
+const char *SWM_kernelName(void)
+{
+    return SWM_kernels()->name;
+}
+
+
+// half precision
+
+void SWM_convertToFloat(const void *source, SWM_Type type, float *destination, size_t amount)
+{
+    SWM_kernels()->convertToFloat(source, type, destination, amount);
+}
+
+void SWM_convertFromFloat(const float *source, void *destination, SWM_Type type, size_t amount)
+{
+    SWM_kernels()->convertFromFloat(source, destination, type, amount);
+}
+
+/* the AVX2 converters do float16 with F16C and bfloat16 with integer shifts and adds, AVX-512 BF16 only makes narrowing faster still */
+bool SWM_hasFastConversion(SWM_Type type)
+{
+    return type == SWM_TYPE_FLOAT32 || SWM_kernels()->convertToFloat != SWM_convertToFloatScalar;
+}
+
+// gemm
+
+/* blocking sizes, a KC x NC panel of B stays in L2 and a MC x KC block of A in L1/L2 */
+#define SWM_GEMM_MC 72
+#define SWM_GEMM_KC 256
+#define SWM_GEMM_NC 1024
+
+/* multiply adds a gemm needs before it's split over the thread pool */
+#define SWM_GEMM_PARALLEL_WORK (1u << 18)
+
+/* scratch space that grows as needed, one per thread so the kernels can run in parallel */
+static _Thread_local float *SWM_gemmBuffers[3];
+static _Thread_local size_t SWM_gemmBufferSizes[3];
+
+static float *SWM_gemmBuffer(uint32_t index, size_t amount)
+{
+    if (SWM_gemmBufferSizes[index] < amount)
+    {
+        free(SWM_gemmBuffers[index]);
+
+        // 64 byte aligned so full vectors never split a cache line
+        size_t bytes = (amount * sizeof(float) + 63) / 64 * 64;
+        SWM_gemmBuffers[index] = aligned_alloc(64, bytes);
+        if (SWM_gemmBuffers[index] == NULL) { fputs("Error allocating gemm buffers\n", stdout); exit(1); }
+
+        SWM_gemmBufferSizes[index] = bytes / sizeof(float);
+    }
+
+    return SWM_gemmBuffers[index];
+}
+
+static inline size_t SWM_offset(bool trans, uint32_t row, uint32_t column, uint32_t ld)
+{
+    return trans ? (size_t)column * ld + row : (size_t)row * ld + column;
+}
+
+/* packs op(A)[i0 .. i0 + mc][k0 .. k0 + kc] into MR row slivers, k major within each sliver, padded with zeros */
+static void SWM_packA(bool transA, const void *A, SWM_Type typeA, uint32_t lda, uint32_t i0, uint32_t mc, uint32_t k0, uint32_t kc, float *packed, float *row)
+{
+    for (uint32_t i = 0; i < mc; i += SWM_GEMM_MR)
+    {
+        float *sliver = packed + (size_t)i * kc;
+        uint32_t rows = mc - i < SWM_GEMM_MR ? mc - i : SWM_GEMM_MR;
+
+        if (rows < SWM_GEMM_MR)
+            memset(sliver, 0, sizeof(float) * SWM_GEMM_MR * kc);
+
+        if (!transA)
+        {
+            // rows of A are contiguous in k
+            for (uint32_t r = 0; r < rows; r++)
+            {
+                SWM_convertToFloat((const char *)A + SWM_offset(false, i0 + i + r, k0, lda) * SWM_typeSize(typeA), typeA, row, kc);
+                for (uint32_t k = 0; k < kc; k++)
+                    sliver[k * SWM_GEMM_MR + r] = row[k];
+            }
+        }
+        else
+        {
+            // columns of op(A) are contiguous
+            for (uint32_t k = 0; k < kc; k++)
+                SWM_convertToFloat((const char *)A + SWM_offset(true, i0 + i, k0 + k, lda) * SWM_typeSize(typeA), typeA, sliver + k * SWM_GEMM_MR, rows);
+        }
+    }
+}
+
+/* packs op(B)[k0 .. k0 + kc][j0 .. j0 + nc] into NR column slivers, k major within each sliver, padded with zeros */
+static void SWM_packB(bool transB, const void *B, SWM_Type typeB, uint32_t ldb, uint32_t k0, uint32_t kc, uint32_t j0, uint32_t nc, float *packed, float *row)
+{
+    for (uint32_t j = 0; j < nc; j += SWM_GEMM_NR)
+    {
+        float *sliver = packed + (size_t)j * kc;
+        uint32_t columns = nc - j < SWM_GEMM_NR ? nc - j : SWM_GEMM_NR;
+
+        if (columns < SWM_GEMM_NR)
+            memset(sliver, 0, sizeof(float) * SWM_GEMM_NR * kc);
+
+        if (transB)
+        {
+            // columns of op(B) are rows of B, contiguous in k
+            for (uint32_t c = 0; c < columns; c++)
+            {
+                SWM_convertToFloat((const char *)B + SWM_offset(true, k0, j0 + j + c, ldb) * SWM_typeSize(typeB), typeB, row, kc);
+                for (uint32_t k = 0; k < kc; k++)
+                    sliver[k * SWM_GEMM_NR + c] = row[k];
+            }
+        }
+        else
+        {
+            for (uint32_t k = 0; k < kc; k++)
+                SWM_convertToFloat((const char *)B + SWM_offset(false, k0 + k, j0 + j, ldb) * SWM_typeSize(typeB), typeB, sliver + k * SWM_GEMM_NR, columns);
+        }
+    }
+}
+
+/* matrix vector products, packing B would touch every weight twice, so convert a bit at a time and dot straight away, only columns j0 .. j1 of C */
+static void SWM_gemmRowTimesRows(uint32_t M, uint32_t j0, uint32_t j1, uint32_t K, float alpha, const void *A, SWM_Type typeA, uint32_t lda, const void *B, SWM_Type typeB, uint32_t ldb, float *C, uint32_t ldc)
+{
+    float *a = SWM_gemmBuffer(0, K);
+    float *b = SWM_gemmBuffer(1, SWM_GEMM_KC);
+
+    for (uint32_t i = 0; i < M; i++)
+    {
+        SWM_convertToFloat((const char *)A + (size_t)i * lda * SWM_typeSize(typeA), typeA, a, K);
+
+        for (uint32_t j = j0; j < j1; j++)
+        {
+            const char *row = (const char *)B + (size_t)j * ldb * SWM_typeSize(typeB);
+            float sum = 0.0f;
+
+            for (uint32_t k0 = 0; k0 < K; k0 += SWM_GEMM_KC)
+            {
+                uint32_t kc = K - k0 < SWM_GEMM_KC ? K - k0 : SWM_GEMM_KC;
+                const float *bk = b;
+
+                if (typeB == SWM_TYPE_FLOAT32)
+                    bk = (const float *)row + k0;
+                else
+                    SWM_convertToFloat(row + (size_t)k0 * SWM_typeSize(typeB), typeB, b, kc);
+
+                // independent partial sums, otherwise the additions can't be vectorized
+                float partial[SWM_GEMM_NR] = { 0 };
+                uint32_t k = 0;
+
+                for (; k + SWM_GEMM_NR <= kc; k += SWM_GEMM_NR)
+                    for (uint32_t p = 0; p < SWM_GEMM_NR; p++)
+                        partial[p] += a[k0 + k + p] * bk[k + p];
+
+                for (; k < kc; k++)
+                    sum += a[k0 + k] * bk[k];
+
+                for (uint32_t p = 0; p < SWM_GEMM_NR; p++)
+                    sum += partial[p];
+            }
+
+            C[(size_t)i * ldc + j] += alpha * sum;
+        }
+    }
+}
+
+/* everything the parallel parts of a gemm need, the tiles of C are mb x nb and go through M first so neighbouring tiles read the same columns of the B panel */
+typedef struct SWM_GemmTask
+{
+    SWM_GemmKernel kernel;
+    bool transA, transB;
+    uint32_t M, N, K;
+    float alpha;
+    const void *A;
+    SWM_Type typeA;
+    uint32_t lda;
+    const void *B;
+    SWM_Type typeB;
+    uint32_t ldb;
+    float *C;
+    uint32_t ldc;
+
+    uint32_t j0, nc, k0, kc;
+    float *packedB;                 /* shared by all threads, packed once per panel */
+    uint32_t mb, nb, mTiles;
+} SWM_GemmTask;
+
+static void SWM_gemmRowTimesRowsTask(void *context, size_t begin, size_t end, uint32_t thread)
+{
+    (void)thread;
+    const SWM_GemmTask *t = context;
+
+    SWM_gemmRowTimesRows(t->M, (uint32_t)begin, (uint32_t)end, t->K, t->alpha, t->A, t->typeA, t->lda, t->B, t->typeB, t->ldb, t->C, t->ldc);
+}
+
+/* begin and end count NR slivers of the panel */
+static void SWM_gemmPackBTask(void *context, size_t begin, size_t end, uint32_t thread)
+{
+    (void)thread;
+    const SWM_GemmTask *t = context;
+
+    uint32_t j = (uint32_t)begin * SWM_GEMM_NR;
+    uint32_t columns = t->nc - j < (uint32_t)(end - begin) * SWM_GEMM_NR ? t->nc - j : (uint32_t)(end - begin) * SWM_GEMM_NR;
+
+    SWM_packB(t->transB, t->B, t->typeB, t->ldb, t->k0, t->kc, t->j0 + j, columns, t->packedB + (size_t)j * t->kc, SWM_gemmBuffer(2, t->kc));
+}
+
+static void SWM_gemmTileTask(void *context, size_t begin, size_t end, uint32_t thread)
+{
+    (void)thread;
+    const SWM_GemmTask *t = context;
+
+    // A gets packed by every thread on its own, in its own buffers
+    float *packedA = SWM_gemmBuffer(0, (size_t)t->kc * ((t->mb + SWM_GEMM_MR - 1) / SWM_GEMM_MR * SWM_GEMM_MR));
+    float *row = SWM_gemmBuffer(2, t->kc);
+
+    for (size_t tile = begin; tile < end; tile++)
+    {
+        uint32_t i0 = (uint32_t)(tile % t->mTiles) * t->mb;
+        uint32_t jt = (uint32_t)(tile / t->mTiles) * t->nb;
+        uint32_t mc = t->M - i0 < t->mb ? t->M - i0 : t->mb;
+        uint32_t nc = t->nc - jt < t->nb ? t->nc - jt : t->nb;
+
+        SWM_packA(t->transA, t->A, t->typeA, t->lda, i0, mc, t->k0, t->kc, packedA, row);
+
+        for (uint32_t j = 0; j < nc; j += SWM_GEMM_NR)
+        for (uint32_t i = 0; i < mc; i += SWM_GEMM_MR)
+        {
+            uint32_t rows = mc - i < SWM_GEMM_MR ? mc - i : SWM_GEMM_MR;
+            uint32_t columns = nc - j < SWM_GEMM_NR ? nc - j : SWM_GEMM_NR;
+
+            t->kernel(t->kc, t->alpha, packedA + (size_t)i * t->kc, t->packedB + (size_t)(jt + j) * t->kc, t->C + (size_t)(i0 + i) * t->ldc + t->j0 + jt + j, t->ldc, rows, columns);
+        }
+    }
+}
+
+static inline uint32_t SWM_roundUp(uint32_t value, uint32_t multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+void SWM_gemm(bool transA, bool transB, uint32_t M, uint32_t N, uint32_t K, float alpha, const void *A, SWM_Type typeA, uint32_t lda, const void *B, SWM_Type typeB, uint32_t ldb, float beta, float *C, uint32_t ldc)
+{
+    SWM_GemmKernel kernel = SWM_kernels()->gemm;
+
+    // C = beta * C first, the kernels only ever add to C
+    for (uint32_t i = 0; i < M; i++)
+    {
+        float *c = C + (size_t)i * ldc;
+
+        if (beta == 0.0f)
+            memset(c, 0, sizeof(float) * N);
+        else if (beta != 1.0f)
+            for (uint32_t j = 0; j < N; j++)
+                c[j] *= beta;
+    }
+
+    if (M == 0 || N == 0 || K == 0 || alpha == 0.0f)
+        return;
+
+    SWM_GemmTask task = { kernel, transA, transB, M, N, K, alpha, A, typeA, lda, B, typeB, ldb, C, ldc, 0, 0, 0, 0, NULL, 0, 0, 0 };
+
+    // small products aren't worth waking the other threads for, with one block everything runs right here
+    uint32_t threads = (uint64_t)M * N * K >= SWM_GEMM_PARALLEL_WORK ? SWP_getThreadCount() : 1;
+
+    if (M < SWM_GEMM_MR / 2 && !transA && transB)
+    {
+        // every output is its own dot product, so the threads just take columns
+        size_t grain = threads > 1 ? SWM_roundUp((N + 2 * threads - 1) / (2 * threads), SWM_GEMM_NR) : N;
+        SWP_parallelFor(0, N, grain, SWM_gemmRowTimesRowsTask, &task);
+        return;
+    }
+
+    uint32_t ncMax = N < SWM_GEMM_NC ? N : SWM_GEMM_NC;
+    uint32_t kcMax = K < SWM_GEMM_KC ? K : SWM_GEMM_KC;
+
+    task.packedB = SWM_gemmBuffer(1, (size_t)kcMax * SWM_roundUp(ncMax, SWM_GEMM_NR));
+
+    for (uint32_t j0 = 0; j0 < N; j0 += SWM_GEMM_NC)
+    {
+        uint32_t nc = N - j0 < SWM_GEMM_NC ? N - j0 : SWM_GEMM_NC;
+        uint32_t slivers = (nc + SWM_GEMM_NR - 1) / SWM_GEMM_NR;
+
+        // tall and skinny products (big batch, small layer) only split M, every thread packs its own rows of A once
+        // when that's too few tiles N gets split too, at the cost of packing those rows of A again for every piece of N, and then M gets cut below MC
+        uint32_t wanted = 2 * threads;
+        uint32_t mb = M < SWM_GEMM_MC ? M : SWM_GEMM_MC;
+        uint32_t mTiles = (M + mb - 1) / mb;
+        uint32_t nTiles = 1;
+
+        if (threads > 1 && mTiles < wanted)
+        {
+            nTiles = (wanted + mTiles - 1) / mTiles;
+            if (nTiles > slivers) nTiles = slivers;
+
+            uint32_t mWanted = (wanted + nTiles - 1) / nTiles;
+            if (mTiles < mWanted)
+            {
+                mb = SWM_roundUp((M + mWanted - 1) / mWanted, SWM_GEMM_MR);
+                mTiles = (M + mb - 1) / mb;
+            }
+        }
+
+        task.j0 = j0;
+        task.nc = nc;
+        task.mb = mb;
+        task.nb = SWM_roundUp((nc + nTiles - 1) / nTiles, SWM_GEMM_NR);
+        task.mTiles = mTiles;
+
+        size_t tiles = (size_t)mTiles * ((nc + task.nb - 1) / task.nb);
+
+        for (uint32_t k0 = 0; k0 < K; k0 += SWM_GEMM_KC)
+        {
+            task.k0 = k0;
+            task.kc = K - k0 < SWM_GEMM_KC ? K - k0 : SWM_GEMM_KC;
+
+            // any conversion to float happens here, once per panel instead of once per use
+            SWP_parallelFor(0, slivers, threads > 1 ? (slivers + threads - 1) / threads : slivers, SWM_gemmPackBTask, &task);
+            SWP_parallelFor(0, tiles, threads > 1 ? 1 : tiles, SWM_gemmTileTask, &task);
+        }
+    }
+}
+
+
+// sparse
+
+void SWM_csrFromDense(SWM_CsrMatrix *matrix, const float *dense, uint32_t rows, uint32_t columns)
+{
+    size_t nonZeroAmount = 0;
+    for (size_t i = 0, l = (size_t)rows * columns; i < l; i++)
+        nonZeroAmount += dense[i] != 0.0f;
+
+    matrix->rows = rows;
+    matrix->columns = columns;
+    matrix->nonZeroAmount = (uint32_t)nonZeroAmount;
+
+    // one extra element so empty matrices still get valid pointers
+    matrix->values = malloc(sizeof(float) * (nonZeroAmount + 1));
+    matrix->columnIndices = malloc(sizeof(uint32_t) * (nonZeroAmount + 1));
+    matrix->rowOffsets = malloc(sizeof(uint32_t) * (rows + 1));
+
+    if (matrix->values == NULL || matrix->columnIndices == NULL || matrix->rowOffsets == NULL)
+    {
+        fputs("Error allocating sparse matrix\n", stdout);
+        exit(1);
+    }
+
+    uint32_t index = 0;
+
+    for (uint32_t i = 0; i < rows; i++)
+    {
+        matrix->rowOffsets[i] = index;
+
+        for (uint32_t j = 0; j < columns; j++)
+        {
+            float value = dense[(size_t)i * columns + j];
+            if (value == 0.0f) continue;
+
+            matrix->values[index] = value;
+            matrix->columnIndices[index] = j;
+            index++;
+        }
+    }
+
+    matrix->rowOffsets[rows] = index;
+}
+
+void SWM_destroyCsr(SWM_CsrMatrix *matrix)
+{
+    free(matrix->values);
+    free(matrix->columnIndices);
+    free(matrix->rowOffsets);
+}
+
+void SWM_spmm(uint32_t M, const float *X, uint32_t ldx, const SWM_CsrMatrix *A, float *C, uint32_t ldc)
+{
+    SWM_CsrRowDot rowDot = SWM_kernels()->csrRowDot;
+
+    // one input row at a time, it stays in L1 while every sparse row gathers from it
+    for (uint32_t i = 0; i < M; i++)
+    {
+        const float *x = X + (size_t)i * ldx;
+        float *c = C + (size_t)i * ldc;
+
+        for (uint32_t r = 0; r < A->rows; r++)
+        {
+            uint32_t begin = A->rowOffsets[r];
+            c[r] = rowDot(A->values + begin, A->columnIndices + begin, A->rowOffsets[r + 1] - begin, x);
+        }
+    }
+}
+
+
+// int8 kernels
+
+void SWM_gemmInt8(uint32_t M, uint32_t N, uint32_t K, const uint8_t *A, uint32_t lda, const int8_t *B, uint32_t ldb, int32_t *C, uint32_t ldc)
+{
+    SWM_GemmInt8Kernel kernel = SWM_kernels()->gemmInt8;
+
+    if (K % SWM_INT8_K_ALIGNMENT != 0)
+    {
+        fputs("SWM_gemmInt8 wants K padded to SWM_INT8_K_ALIGNMENT, go pad your rows\n", stderr);
+        exit(1);
+    }
+
+    kernel(M, N, K, A, lda, B, ldb, C, ldc);
+}
+
+
+// convolution
+
+void SWM_convolutionTile(const float *input, size_t channelStride, size_t rowStride, uint32_t channels, uint32_t kernelSize, uint32_t stride, const float *weights, float *tile)
+{
+    SWM_kernels()->convolutionTile(input, channelStride, rowStride, channels, kernelSize, stride, weights, tile);
+}
+
+
+// pooling
+
+void SWM_poolRow(const float *input, uint32_t inputWidth, uint32_t size, uint32_t stride, bool max, uint32_t width, float *output, uint32_t *indices, uint32_t indexOffset)
+{
+    SWM_kernels()->poolRow(input, inputWidth, size, stride, max, width, output, indices, indexOffset);
+}
+
+float SWM_sum(const float *values, size_t amount)
+{
+    return SWM_kernels()->sum(values, amount);
+}
+
+
 // util
 
 void SWM_printm(SWM_Matrix *matrix)
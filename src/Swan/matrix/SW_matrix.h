@@ -1,7 +1,9 @@
 #ifndef SW_MATRIX_H
 #define SW_MATRIX_H
 
+#include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -9,6 +11,14 @@
 typedef float SWM_MatrixValue_t;
 typedef SWM_MatrixValue_t* SWM_MatrixData_t;
 
+/* element types the kernels can read, everything is accumulated in float */
+typedef enum SWM_Type
+{
+    SWM_TYPE_FLOAT32 = 0,
+    SWM_TYPE_BFLOAT16,
+    SWM_TYPE_FLOAT16
+} SWM_Type;
+
 typedef struct SWM_Matrix
 {
 
@@ -17,6 +27,17 @@ typedef struct SWM_Matrix
 
 } SWM_Matrix;
 
+/* compressed sparse row matrix, only the non zero values of each row are stored */
+typedef struct SWM_CsrMatrix
+{
+
+    float *values;
+    uint32_t *columnIndices;
+    uint32_t *rowOffsets;           /* rows + 1 entries, row i is values[rowOffsets[i] .. rowOffsets[i + 1]] */
+    uint32_t rows, columns, nonZeroAmount;
+
+} SWM_CsrMatrix;
+
 static inline uint32_t SWM_index(SWM_Matrix *matrix, uint32_t row, uint32_t col)
 {
     return (row * matrix->columns + col);
@@ -46,19 +67,19 @@ static inline void SWM_initMatrix(SWM_Matrix *matrix, uint32_t rows, uint32_t co
     matrix->data = SWM_createData(rows, columns);
 }
 
-void SWM_initMatrixData(SWM_Matrix *matrix, uint32_t rows, uint32_t columns, SWM_MatrixData_t data)
+static inline void SWM_initMatrixData(SWM_Matrix *matrix, uint32_t rows, uint32_t columns, SWM_MatrixData_t data)
 {
     matrix->rows = rows;
     matrix->columns = columns;
     matrix->data = data;
 }
 
-void SWM_destroyMatrix(SWM_Matrix *matrix)
+static inline void SWM_destroyMatrix(SWM_Matrix *matrix)
 {
     free(matrix->data);
 }
 
-SWM_MatrixData_t SWM_copyMatrixData(SWM_Matrix *matrix) /* ret freed by caller */
+static inline SWM_MatrixData_t SWM_copyMatrixData(SWM_Matrix *matrix) /* ret freed by caller */
 {
     SWM_MatrixData_t data = SWM_createData(matrix->rows, matrix->columns);
     memcpy(data, matrix->data, matrix->columns * matrix->rows * sizeof(SWM_MatrixValue_t));
@@ -71,6 +92,143 @@ SWM_Matrix SWM_addMatrix(SWM_Matrix *a, SWM_Matrix *b); /* ret freed by caller *
 SWM_Matrix SWM_multiplyMatrix(SWM_Matrix *a, SWM_Matrix *b); /* ret freed by caller */
 SWM_Matrix SWM_multiplyScalar(SWM_Matrix *a, SWM_MatrixValue_t scalar); /* ret freed by caller */
 
+// half precision
+
+static inline size_t SWM_typeSize(SWM_Type type)
+{
+    return type == SWM_TYPE_FLOAT32 ? sizeof(float) : sizeof(uint16_t);
+}
+
+/* round to nearest even, NaN stays NaN */
+static inline uint16_t SWM_floatToBfloat16(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    if ((bits & 0x7FFFFFFFu) > 0x7F800000u)
+        return (uint16_t)((bits >> 16) | 0x0040u);
+
+    bits += 0x7FFFu + ((bits >> 16) & 1u);
+    return (uint16_t)(bits >> 16);
+}
+
+static inline float SWM_bfloat16ToFloat(uint16_t value)
+{
+    uint32_t bits = (uint32_t)value << 16;
+    float out;
+    memcpy(&out, &bits, sizeof(out));
+    return out;
+}
+
+/* IEEE binary16, round to nearest even */
+static inline uint16_t SWM_floatToFloat16(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint16_t sign = (uint16_t)((bits >> 16) & 0x8000u);
+    uint32_t absolute = bits & 0x7FFFFFFFu;
+
+    if (absolute > 0x7F800000u) return sign | 0x7E00u;                 // NaN
+    if (absolute >= 0x477FF000u) return sign | 0x7C00u;                // overflows (or is) infinity
+    if (absolute < 0x38800000u)                                         // subnormal or zero
+    {
+        if (absolute < 0x33000000u) return sign;
+
+        uint32_t exponent = absolute >> 23;
+        uint32_t mantissa = (absolute & 0x7FFFFFu) | 0x800000u;
+        uint32_t shift = 126 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+
+        if (remainder > halfway || (remainder == halfway && (half & 1u))) half++;
+        return sign | (uint16_t)half;
+    }
+
+    absolute += 0xC8000FFFu + ((absolute >> 13) & 1u);                 // rebias the exponent and round
+    return sign | (uint16_t)(absolute >> 13);
+}
+
+static inline float SWM_float16ToFloat(uint16_t value)
+{
+    uint32_t sign = (uint32_t)(value & 0x8000u) << 16;
+    uint32_t exponent = (value >> 10) & 0x1Fu;
+    uint32_t mantissa = value & 0x3FFu;
+    uint32_t bits;
+
+    if (exponent == 0x1Fu)
+        bits = sign | 0x7F800000u | (mantissa << 13);
+    else if (exponent != 0)
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    else if (mantissa == 0)
+        bits = sign;
+    else
+    {
+        // normalize the subnormal
+        exponent = 113;
+        while ((mantissa & 0x400u) == 0) { mantissa <<= 1; exponent--; }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3FFu) << 13);
+    }
+
+    float out;
+    memcpy(&out, &bits, sizeof(out));
+    return out;
+}
+
+/* bulk conversions, these use F16C and AVX512-BF16 when the CPU has them */
+void SWM_convertToFloat(const void *source, SWM_Type type, float *destination, size_t amount);
+void SWM_convertFromFloat(const float *source, void *destination, SWM_Type type, size_t amount);
+
+/* whether the CPU converts type to and from float in vectors, AVX2 is enough for both ways of float16 and bfloat16 */
+bool SWM_hasFastConversion(SWM_Type type);
+
+/* the instruction set the kernels were picked for, generic, avx2 or avx512, SWAN_ISA can hold it back */
+const char *SWM_kernelName(void);
+
+// gemm
+
+/* C[M x N] = alpha * op(A)[M x K] * op(B)[K x N] + beta * C, op(X) is X transposed when trans is set
+   A and B can be stored as any SWM_Type, they are converted to float while being packed and are accumulated in float */
+void SWM_gemm(bool transA, bool transB, uint32_t M, uint32_t N, uint32_t K, float alpha, const void *A, SWM_Type typeA, uint32_t lda, const void *B, SWM_Type typeB, uint32_t ldb, float beta, float *C, uint32_t ldc);
+
+// sparse
+
+void SWM_csrFromDense(SWM_CsrMatrix *matrix, const float *dense, uint32_t rows, uint32_t columns); /* ret freed with SWM_destroyCsr */
+void SWM_destroyCsr(SWM_CsrMatrix *matrix);
+
+/* C[M x A.rows] = X[M x A.columns] * A^T, so A has one row per output like a layer's weights do */
+void SWM_spmm(uint32_t M, const float *X, uint32_t ldx, const SWM_CsrMatrix *A, float *C, uint32_t ldc);
+
+// int8 kernels
+
+/* rows of A and B (the depth K) have to be padded with zeros to a multiple of this */
+#define SWM_INT8_K_ALIGNMENT 64
+
+/* C[M x N] = A[M x K] * B[N x K]^T with int32 accumulation
+   A is unsigned and has to stay within [0, 127], B is signed and has to stay within [-127, 127],
+   which keeps the pairwise 16 bit sums of vpmaddubsw from saturating */
+void SWM_gemmInt8(uint32_t M, uint32_t N, uint32_t K, const uint8_t *A, uint32_t lda, const int8_t *B, uint32_t ldb, int32_t *C, uint32_t ldc);
+
+// convolution
+
+/* the direct convolution kernel makes tiles of this many output pixels in a row times this many output channels */
+#define SWM_CONV_TILE_PIXELS 8
+#define SWM_CONV_TILE_CHANNELS 8
+
+/* tile[pixel][channel] = the sum over every input channel and kernel position of input * weights
+   input is the zero padded input where the first window of the tile starts, channelStride and rowStride are in floats,
+   weights are [input channel][ky][kx][SWM_CONV_TILE_CHANNELS], one block of output channels interleaved */
+void SWM_convolutionTile(const float *input, size_t channelStride, size_t rowStride, uint32_t channels, uint32_t kernelSize, uint32_t stride, const float *weights, float *tile);
+
+// pooling
+
+/* one output row of size x size windows, the max or the average of each, input is the first input row of the windows
+   indices can be NULL, otherwise they get indexOffset plus where in input each maximum was, the first one on ties */
+void SWM_poolRow(const float *input, uint32_t inputWidth, uint32_t size, uint32_t stride, bool max, uint32_t width, float *output, uint32_t *indices, uint32_t indexOffset);
+
+float SWM_sum(const float *values, size_t amount);
+
 // util
 
 void SWM_printm(SWM_Matrix *matrix);
@@ -0,0 +1,315 @@
+#include "SW_matrix_kernels.h"
+
+#ifdef SWM_X86
+
+#if !defined(__AVX2__) || !defined(__FMA__) || !defined(__F16C__)
+#error "SW_matrix_avx2.c has to be built with -mavx2 -mfma -mf16c, see matrix/CMakeLists.txt"
+#endif
+
+#include <immintrin.h>
+#include <math.h>
+
+// Only called once SWM_kernels has seen the CPU has AVX2, FMA and F16C, the whole file is built for them
+
+// half precision
+
+void SWM_convertToFloatAvx2(const void *source, SWM_Type type, float *destination, size_t amount)
+{
+    const uint16_t *half = source;
+    size_t i = 0;
+
+    if (type == SWM_TYPE_FLOAT16)
+    {
+        for (; i + 8 <= amount; i += 8)
+            _mm256_storeu_ps(destination + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(half + i))));
+    }
+    else if (type == SWM_TYPE_BFLOAT16)
+    {
+        // bfloat16 is the top half of a float, widening is just a shift
+        for (; i + 8 <= amount; i += 8)
+        {
+            __m256i widened = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(half + i)));
+            _mm256_storeu_ps(destination + i, _mm256_castsi256_ps(_mm256_slli_epi32(widened, 16)));
+        }
+    }
+
+    if (type == SWM_TYPE_FLOAT32)
+        SWM_convertToFloatScalar(source, type, destination, amount);
+    else
+        SWM_convertToFloatScalar(half + i, type, destination + i, amount - i);
+}
+
+void SWM_convertFromFloatAvx2(const float *source, void *destination, SWM_Type type, size_t amount)
+{
+    uint16_t *half = destination;
+    size_t i = 0;
+
+    if (type == SWM_TYPE_FLOAT16)
+    {
+        for (; i + 8 <= amount; i += 8)
+            _mm_storeu_si128((__m128i *)(half + i), _mm256_cvtps_ph(_mm256_loadu_ps(source + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+    }
+    else if (type == SWM_TYPE_BFLOAT16)
+    {
+        // SWM_floatToBfloat16 on 8 floats at once, so it's the same bits as the scalar tail
+        const __m256i absolute = _mm256_set1_epi32(0x7FFFFFFF), infinity = _mm256_set1_epi32(0x7F800000);
+        const __m256i one = _mm256_set1_epi32(1), bias = _mm256_set1_epi32(0x7FFF), quiet = _mm256_set1_epi32(0x00400000);
+
+        for (; i + 8 <= amount; i += 8)
+        {
+            __m256i bits = _mm256_castps_si256(_mm256_loadu_ps(source + i));
+            __m256i nan = _mm256_cmpgt_epi32(_mm256_and_si256(bits, absolute), infinity);
+            __m256i rounded = _mm256_add_epi32(bits, _mm256_add_epi32(bias, _mm256_and_si256(_mm256_srli_epi32(bits, 16), one)));
+            __m256i narrowed = _mm256_srli_epi32(_mm256_blendv_epi8(rounded, _mm256_or_si256(bits, quiet), nan), 16);
+
+            // packus works within the 128 bit lanes, the permute puts both halves next to each other
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(narrowed, narrowed), 0xD8);
+            _mm_storeu_si128((__m128i *)(half + i), _mm256_castsi256_si128(packed));
+        }
+    }
+
+    if (type == SWM_TYPE_FLOAT32)
+        SWM_convertFromFloatScalar(source, destination, type, amount);
+    else
+        SWM_convertFromFloatScalar(source + i, half + i, type, amount - i);
+}
+
+// gemm
+
+/* 6 x 16 outputs in 12 ymm accumulators, one broadcast of A feeds two FMAs */
+void SWM_gemmKernelAvx2(uint32_t kc, float alpha, const float *a, const float *b, float *C, uint32_t ldc, uint32_t rows, uint32_t columns)
+{
+    __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+    __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+    __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+    __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+    __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+
+    for (uint32_t k = 0; k < kc; k++, a += SWM_GEMM_MR, b += SWM_GEMM_NR)
+    {
+        __m256 b0 = _mm256_load_ps(b), b1 = _mm256_load_ps(b + 8);
+        __m256 av;
+
+        av = _mm256_broadcast_ss(a + 0); c00 = _mm256_fmadd_ps(av, b0, c00); c01 = _mm256_fmadd_ps(av, b1, c01);
+        av = _mm256_broadcast_ss(a + 1); c10 = _mm256_fmadd_ps(av, b0, c10); c11 = _mm256_fmadd_ps(av, b1, c11);
+        av = _mm256_broadcast_ss(a + 2); c20 = _mm256_fmadd_ps(av, b0, c20); c21 = _mm256_fmadd_ps(av, b1, c21);
+        av = _mm256_broadcast_ss(a + 3); c30 = _mm256_fmadd_ps(av, b0, c30); c31 = _mm256_fmadd_ps(av, b1, c31);
+        av = _mm256_broadcast_ss(a + 4); c40 = _mm256_fmadd_ps(av, b0, c40); c41 = _mm256_fmadd_ps(av, b1, c41);
+        av = _mm256_broadcast_ss(a + 5); c50 = _mm256_fmadd_ps(av, b0, c50); c51 = _mm256_fmadd_ps(av, b1, c51);
+    }
+
+    float accumulator[SWM_GEMM_MR][SWM_GEMM_NR] __attribute__((aligned(32)));
+    _mm256_store_ps(accumulator[0], c00); _mm256_store_ps(accumulator[0] + 8, c01);
+    _mm256_store_ps(accumulator[1], c10); _mm256_store_ps(accumulator[1] + 8, c11);
+    _mm256_store_ps(accumulator[2], c20); _mm256_store_ps(accumulator[2] + 8, c21);
+    _mm256_store_ps(accumulator[3], c30); _mm256_store_ps(accumulator[3] + 8, c31);
+    _mm256_store_ps(accumulator[4], c40); _mm256_store_ps(accumulator[4] + 8, c41);
+    _mm256_store_ps(accumulator[5], c50); _mm256_store_ps(accumulator[5] + 8, c51);
+
+    for (uint32_t r = 0; r < rows; r++)
+        for (uint32_t c = 0; c < columns; c++)
+            C[(size_t)r * ldc + c] += alpha * accumulator[r][c];
+}
+
+// sparse
+
+/* eight non zeros at a time, gathering the matching inputs */
+float SWM_csrRowDotAvx2(const float *values, const uint32_t *columnIndices, uint32_t amount, const float *x)
+{
+    __m256 acc = _mm256_setzero_ps();
+    uint32_t k = 0;
+
+    for (; k + 8 <= amount; k += 8)
+    {
+        __m256i indices = _mm256_loadu_si256((const __m256i *)(columnIndices + k));
+        acc = _mm256_fmadd_ps(_mm256_loadu_ps(values + k), _mm256_i32gather_ps(x, indices, 4), acc);
+    }
+
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+
+    // The tail stays in here rather than calling the generic one, so it's built with FMA whether or not the linker inlines across files
+    float tail = 0.0f;
+    for (; k < amount; k++)
+        tail += values[k] * x[columnIndices[k]];
+
+    return _mm_cvtss_f32(sum) + tail;
+}
+
+// int8
+
+static inline int32_t SWM_hsum256(__m256i v)
+{
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+}
+
+/* vpmaddubsw multiplies u8 * s8 into pairwise int16 sums, vpmaddwd widens those to int32 */
+void SWM_gemmInt8Avx2(uint32_t M, uint32_t N, uint32_t K, const uint8_t *A, uint32_t lda, const int8_t *B, uint32_t ldb, int32_t *C, uint32_t ldc)
+{
+    const __m256i ones = _mm256_set1_epi16(1);
+
+    for (uint32_t i = 0; i < M; i++)
+    {
+        const uint8_t *a = A + (size_t)i * lda;
+        uint32_t j = 0;
+
+        // four rows of B at a time so every load of A is used four times
+        for (; j + 4 <= N; j += 4)
+        {
+            const int8_t *b0 = B + (size_t)j * ldb;
+            const int8_t *b1 = b0 + ldb, *b2 = b1 + ldb, *b3 = b2 + ldb;
+
+            __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+            __m256i acc2 = _mm256_setzero_si256(), acc3 = _mm256_setzero_si256();
+
+            for (uint32_t k = 0; k < K; k += 32)
+            {
+                __m256i va = _mm256_loadu_si256((const __m256i *)(a + k));
+                acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(_mm256_maddubs_epi16(va, _mm256_loadu_si256((const __m256i *)(b0 + k))), ones));
+                acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(_mm256_maddubs_epi16(va, _mm256_loadu_si256((const __m256i *)(b1 + k))), ones));
+                acc2 = _mm256_add_epi32(acc2, _mm256_madd_epi16(_mm256_maddubs_epi16(va, _mm256_loadu_si256((const __m256i *)(b2 + k))), ones));
+                acc3 = _mm256_add_epi32(acc3, _mm256_madd_epi16(_mm256_maddubs_epi16(va, _mm256_loadu_si256((const __m256i *)(b3 + k))), ones));
+            }
+
+            int32_t *c = C + (size_t)i * ldc + j;
+            c[0] = SWM_hsum256(acc0);
+            c[1] = SWM_hsum256(acc1);
+            c[2] = SWM_hsum256(acc2);
+            c[3] = SWM_hsum256(acc3);
+        }
+
+        for (; j < N; j++)
+        {
+            const int8_t *b = B + (size_t)j * ldb;
+            __m256i acc = _mm256_setzero_si256();
+
+            for (uint32_t k = 0; k < K; k += 32)
+                acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i *)(a + k)), _mm256_loadu_si256((const __m256i *)(b + k))), ones));
+
+            C[(size_t)i * ldc + j] = SWM_hsum256(acc);
+        }
+    }
+}
+
+// convolution
+
+#if SWM_CONV_TILE_PIXELS != 8 || SWM_CONV_TILE_CHANNELS != 8
+#error "SWM_convolutionTileAvx2 keeps one ymm of 8 channels for each of 8 pixels"
+#endif
+
+/* the whole tile stays in 8 ymm accumulators, one load of weights feeds all 8 pixels */
+void SWM_convolutionTileAvx2(const float *input, size_t channelStride, size_t rowStride, uint32_t channels, uint32_t kernelSize, uint32_t stride, const float *weights, float *tile)
+{
+    __m256 t0 = _mm256_setzero_ps(), t1 = _mm256_setzero_ps(), t2 = _mm256_setzero_ps(), t3 = _mm256_setzero_ps();
+    __m256 t4 = _mm256_setzero_ps(), t5 = _mm256_setzero_ps(), t6 = _mm256_setzero_ps(), t7 = _mm256_setzero_ps();
+
+    for (uint32_t c = 0; c < channels; c++)
+    for (uint32_t ky = 0; ky < kernelSize; ky++)
+    {
+        const float *row = input + c * channelStride + ky * rowStride;
+        const float *w = weights + (size_t)(c * kernelSize + ky) * kernelSize * SWM_CONV_TILE_CHANNELS;
+
+        for (uint32_t kx = 0; kx < kernelSize; kx++)
+        {
+            __m256 wv = _mm256_loadu_ps(w + kx * SWM_CONV_TILE_CHANNELS);
+            const float *pixels = row + kx;
+
+            t0 = _mm256_fmadd_ps(wv, _mm256_broadcast_ss(pixels + 0 * stride), t0);
+            t1 = _mm256_fmadd_ps(wv, _mm256_broadcast_ss(pixels + 1 * stride), t1);
+            t2 = _mm256_fmadd_ps(wv, _mm256_broadcast_ss(pixels + 2 * stride), t2);
+            t3 = _mm256_fmadd_ps(wv, _mm256_broadcast_ss(pixels + 3 * stride), t3);
+            t4 = _mm256_fmadd_ps(wv, _mm256_broadcast_ss(pixels + 4 * stride), t4);
+            t5 = _mm256_fmadd_ps(wv, _mm256_broadcast_ss(pixels + 5 * stride), t5);
+            t6 = _mm256_fmadd_ps(wv, _mm256_broadcast_ss(pixels + 6 * stride), t6);
+            t7 = _mm256_fmadd_ps(wv, _mm256_broadcast_ss(pixels + 7 * stride), t7);
+        }
+    }
+
+    _mm256_storeu_ps(tile + 0 * SWM_CONV_TILE_CHANNELS, t0);
+    _mm256_storeu_ps(tile + 1 * SWM_CONV_TILE_CHANNELS, t1);
+    _mm256_storeu_ps(tile + 2 * SWM_CONV_TILE_CHANNELS, t2);
+    _mm256_storeu_ps(tile + 3 * SWM_CONV_TILE_CHANNELS, t3);
+    _mm256_storeu_ps(tile + 4 * SWM_CONV_TILE_CHANNELS, t4);
+    _mm256_storeu_ps(tile + 5 * SWM_CONV_TILE_CHANNELS, t5);
+    _mm256_storeu_ps(tile + 6 * SWM_CONV_TILE_CHANNELS, t6);
+    _mm256_storeu_ps(tile + 7 * SWM_CONV_TILE_CHANNELS, t7);
+}
+
+// pooling
+
+/* 8 output pixels at once, their windows are gathered with the stride between them */
+void SWM_poolRowAvx2(const float *input, uint32_t inputWidth, uint32_t size, uint32_t stride, bool max, uint32_t width, float *output, uint32_t *indices, uint32_t indexOffset)
+{
+    __m256i steps = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32((int)stride));
+    __m256 scale = _mm256_set1_ps(1.0f / (size * size));
+    uint32_t x = 0;
+
+    for (; x + 8 <= width; x += 8)
+    {
+        __m256 best = _mm256_set1_ps(-INFINITY), sum = _mm256_setzero_ps();
+        __m256i bestIndex = _mm256_setzero_si256();
+
+        for (uint32_t ky = 0; ky < size; ky++)
+            for (uint32_t kx = 0; kx < size; kx++)
+            {
+                __m256i index = _mm256_add_epi32(steps, _mm256_set1_epi32((int)(ky * inputWidth + x * stride + kx)));
+                __m256 value = _mm256_i32gather_ps(input, index, 4);
+
+                if (!max)
+                {
+                    sum = _mm256_add_ps(sum, value);
+                    continue;
+                }
+
+                // Strictly greater, so ties keep the first position like the generic one
+                __m256 greater = _mm256_cmp_ps(value, best, _CMP_GT_OQ);
+                if (ky == 0 && kx == 0)
+                    greater = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+                best = _mm256_blendv_ps(best, value, greater);
+                bestIndex = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(bestIndex), _mm256_castsi256_ps(index), greater));
+            }
+
+        if (!max)
+            _mm256_storeu_ps(output + x, _mm256_mul_ps(sum, scale));
+        else
+        {
+            _mm256_storeu_ps(output + x, best);
+            if (indices != NULL)
+                _mm256_storeu_si256((__m256i *)(indices + x), _mm256_add_epi32(bestIndex, _mm256_set1_epi32((int)indexOffset)));
+        }
+    }
+
+    if (x < width)
+        SWM_poolRowGeneric(input + (size_t)x * stride, inputWidth, size, stride, max, width - x, output + x, indices != NULL ? indices + x : NULL, indexOffset + x * stride);
+}
+
+float SWM_sumAvx2(const float *values, size_t amount)
+{
+    __m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+    size_t i = 0;
+
+    for (; i + 16 <= amount; i += 16)
+    {
+        sum0 = _mm256_add_ps(sum0, _mm256_loadu_ps(values + i));
+        sum1 = _mm256_add_ps(sum1, _mm256_loadu_ps(values + i + 8));
+    }
+
+    __m256 both = _mm256_add_ps(sum0, sum1);
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(both), _mm256_extractf128_ps(both, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+
+    float result = _mm_cvtss_f32(sum);
+    for (; i < amount; i++)
+        result += values[i];
+
+    return result;
+}
+
+#endif // SWM_X86
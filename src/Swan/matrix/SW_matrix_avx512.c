@@ -0,0 +1,84 @@
+#include "SW_matrix_kernels.h"
+
+#ifdef SWM_X86
+
+#if !defined(__AVX512F__) || !defined(__AVX512BW__) || !defined(__AVX512VNNI__) || !defined(__AVX512BF16__)
+#error "SW_matrix_avx512.c has to be built with -mavx512f -mavx512bw -mavx512vnni -mavx512bf16, see matrix/CMakeLists.txt"
+#endif
+
+#include <immintrin.h>
+
+// Every kernel here needs its own extension on top of AVX-512F, SWM_kernels checks for each one on its own
+
+// half precision
+
+/* vcvtneps2bf16 rounds to nearest even like SWM_floatToBfloat16, but it also flushes denormal inputs to zero and raises no exceptions,
+   so tiny values can come out differently from the scalar and AVX2 paths */
+void SWM_convertFromFloatAvx512Bf16(const float *source, void *destination, SWM_Type type, size_t amount)
+{
+    if (type != SWM_TYPE_BFLOAT16)
+    {
+        SWM_convertFromFloatAvx2(source, destination, type, amount);
+        return;
+    }
+
+    uint16_t *half = destination;
+    size_t i = 0;
+
+    for (; i + 16 <= amount; i += 16)
+    {
+        __m256bh converted = _mm512_cvtneps_pbh(_mm512_loadu_ps(source + i));
+        _mm256_storeu_si256((__m256i *)(half + i), (__m256i)converted);
+    }
+
+    SWM_convertFromFloatScalar(source + i, half + i, type, amount - i);
+}
+
+// int8
+
+/* vpdpbusd does the u8 * s8 multiply and int32 accumulation in a single instruction */
+void SWM_gemmInt8Avx512Vnni(uint32_t M, uint32_t N, uint32_t K, const uint8_t *A, uint32_t lda, const int8_t *B, uint32_t ldb, int32_t *C, uint32_t ldc)
+{
+    for (uint32_t i = 0; i < M; i++)
+    {
+        const uint8_t *a = A + (size_t)i * lda;
+        uint32_t j = 0;
+
+        for (; j + 4 <= N; j += 4)
+        {
+            const int8_t *b0 = B + (size_t)j * ldb;
+            const int8_t *b1 = b0 + ldb, *b2 = b1 + ldb, *b3 = b2 + ldb;
+
+            __m512i acc0 = _mm512_setzero_si512(), acc1 = _mm512_setzero_si512();
+            __m512i acc2 = _mm512_setzero_si512(), acc3 = _mm512_setzero_si512();
+
+            for (uint32_t k = 0; k < K; k += 64)
+            {
+                __m512i va = _mm512_loadu_si512(a + k);
+                acc0 = _mm512_dpbusd_epi32(acc0, va, _mm512_loadu_si512(b0 + k));
+                acc1 = _mm512_dpbusd_epi32(acc1, va, _mm512_loadu_si512(b1 + k));
+                acc2 = _mm512_dpbusd_epi32(acc2, va, _mm512_loadu_si512(b2 + k));
+                acc3 = _mm512_dpbusd_epi32(acc3, va, _mm512_loadu_si512(b3 + k));
+            }
+
+            int32_t *c = C + (size_t)i * ldc + j;
+            c[0] = _mm512_reduce_add_epi32(acc0);
+            c[1] = _mm512_reduce_add_epi32(acc1);
+            c[2] = _mm512_reduce_add_epi32(acc2);
+            c[3] = _mm512_reduce_add_epi32(acc3);
+        }
+
+        for (; j < N; j++)
+        {
+            const int8_t *b = B + (size_t)j * ldb;
+            __m512i acc = _mm512_setzero_si512();
+
+            for (uint32_t k = 0; k < K; k += 64)
+                acc = _mm512_dpbusd_epi32(acc, _mm512_loadu_si512(a + k), _mm512_loadu_si512(b + k));
+
+            C[(size_t)i * ldc + j] = _mm512_reduce_add_epi32(acc);
+        }
+    }
+}
+
+#endif // SWM_X86
@@ -0,0 +1,161 @@
+#include <math.h>
+#include <string.h>
+
+#include "SW_matrix_kernels.h"
+
+// The kernels every CPU can run, and the tails the vector ones leave over
+
+// half precision
+
+void SWM_convertToFloatScalar(const void *source, SWM_Type type, float *destination, size_t amount)
+{
+    const uint16_t *half = source;
+
+    switch (type)
+    {
+    case SWM_TYPE_FLOAT32:
+        memcpy(destination, source, amount * sizeof(float));
+        break;
+
+    case SWM_TYPE_BFLOAT16:
+        for (size_t i = 0; i < amount; i++)
+            destination[i] = SWM_bfloat16ToFloat(half[i]);
+        break;
+
+    case SWM_TYPE_FLOAT16:
+        for (size_t i = 0; i < amount; i++)
+            destination[i] = SWM_float16ToFloat(half[i]);
+        break;
+    }
+}
+
+void SWM_convertFromFloatScalar(const float *source, void *destination, SWM_Type type, size_t amount)
+{
+    uint16_t *half = destination;
+
+    switch (type)
+    {
+    case SWM_TYPE_FLOAT32:
+        memcpy(destination, source, amount * sizeof(float));
+        break;
+
+    case SWM_TYPE_BFLOAT16:
+        for (size_t i = 0; i < amount; i++)
+            half[i] = SWM_floatToBfloat16(source[i]);
+        break;
+
+    case SWM_TYPE_FLOAT16:
+        for (size_t i = 0; i < amount; i++)
+            half[i] = SWM_floatToFloat16(source[i]);
+        break;
+    }
+}
+
+// gemm
+
+/* C[MR x NR] += alpha * a * b over kc, only the top left rows x columns get written */
+void SWM_gemmKernelGeneric(uint32_t kc, float alpha, const float *a, const float *b, float *C, uint32_t ldc, uint32_t rows, uint32_t columns)
+{
+    float accumulator[SWM_GEMM_MR][SWM_GEMM_NR] = { { 0 } };
+
+    for (uint32_t k = 0; k < kc; k++)
+        for (uint32_t r = 0; r < SWM_GEMM_MR; r++)
+            for (uint32_t c = 0; c < SWM_GEMM_NR; c++)
+                accumulator[r][c] += a[k * SWM_GEMM_MR + r] * b[k * SWM_GEMM_NR + c];
+
+    for (uint32_t r = 0; r < rows; r++)
+        for (uint32_t c = 0; c < columns; c++)
+            C[(size_t)r * ldc + c] += alpha * accumulator[r][c];
+}
+
+// sparse
+
+float SWM_csrRowDotGeneric(const float *values, const uint32_t *columnIndices, uint32_t amount, const float *x)
+{
+    float sum = 0.0f;
+
+    for (uint32_t k = 0; k < amount; k++)
+        sum += values[k] * x[columnIndices[k]];
+
+    return sum;
+}
+
+// int8
+
+void SWM_gemmInt8Scalar(uint32_t M, uint32_t N, uint32_t K, const uint8_t *A, uint32_t lda, const int8_t *B, uint32_t ldb, int32_t *C, uint32_t ldc)
+{
+    for (uint32_t i = 0; i < M; i++)
+    for (uint32_t j = 0; j < N; j++)
+    {
+        const uint8_t *a = A + (size_t)i * lda;
+        const int8_t *b = B + (size_t)j * ldb;
+
+        int32_t sum = 0;
+        for (uint32_t k = 0; k < K; k++)
+            sum += (int32_t)a[k] * (int32_t)b[k];
+
+        C[(size_t)i * ldc + j] = sum;
+    }
+}
+
+// convolution
+
+void SWM_convolutionTileGeneric(const float *input, size_t channelStride, size_t rowStride, uint32_t channels, uint32_t kernelSize, uint32_t stride, const float *weights, float *tile)
+{
+    memset(tile, 0, sizeof(float) * SWM_CONV_TILE_PIXELS * SWM_CONV_TILE_CHANNELS);
+
+    for (uint32_t c = 0; c < channels; c++)
+    for (uint32_t ky = 0; ky < kernelSize; ky++)
+    {
+        const float *row = input + c * channelStride + ky * rowStride;
+        const float *w = weights + (size_t)(c * kernelSize + ky) * kernelSize * SWM_CONV_TILE_CHANNELS;
+
+        for (uint32_t kx = 0; kx < kernelSize; kx++)
+            for (uint32_t p = 0; p < SWM_CONV_TILE_PIXELS; p++)
+                for (uint32_t l = 0; l < SWM_CONV_TILE_CHANNELS; l++)
+                    tile[p * SWM_CONV_TILE_CHANNELS + l] += w[kx * SWM_CONV_TILE_CHANNELS + l] * row[kx + p * stride];
+    }
+}
+
+// pooling
+
+void SWM_poolRowGeneric(const float *input, uint32_t inputWidth, uint32_t size, uint32_t stride, bool max, uint32_t width, float *output, uint32_t *indices, uint32_t indexOffset)
+{
+    for (uint32_t x = 0; x < width; x++)
+    {
+        float best = -INFINITY, sum = 0.0f;
+        uint32_t bestIndex = 0;
+
+        for (uint32_t ky = 0; ky < size; ky++)
+            for (uint32_t kx = 0; kx < size; kx++)
+            {
+                uint32_t index = ky * inputWidth + x * stride + kx;
+
+                sum += input[index];
+                if (input[index] > best || (ky == 0 && kx == 0))
+                {
+                    best = input[index];
+                    bestIndex = index;
+                }
+            }
+
+        if (!max)
+            output[x] = sum / (size * size);
+        else
+        {
+            output[x] = best;
+            if (indices != NULL)
+                indices[x] = indexOffset + bestIndex;
+        }
+    }
+}
+
+float SWM_sumGeneric(const float *values, size_t amount)
+{
+    float sum = 0.0f;
+
+    for (size_t i = 0; i < amount; i++)
+        sum += values[i];
+
+    return sum;
+}
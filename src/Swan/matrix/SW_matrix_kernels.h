@@ -0,0 +1,80 @@
+#ifndef SW_MATRIX_KERNELS_H
+#define SW_MATRIX_KERNELS_H
+
+#include "SW_matrix.h"
+
+/* the innermost loops of the matrix module, only SW_matrix*.c include this
+   every instruction set has its own file built with its own -m flags, SW_matrix.c calls them through SWM_kernels() */
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SWM_X86
+#endif
+
+/* the micro tile of the gemm kernels, packing lays A and B out for it */
+#define SWM_GEMM_MR 6
+#define SWM_GEMM_NR 16
+
+typedef void (*SWM_ToFloatConverter)(const void *source, SWM_Type type, float *destination, size_t amount);
+typedef void (*SWM_FromFloatConverter)(const float *source, void *destination, SWM_Type type, size_t amount);
+
+/* C[MR x NR] += alpha * a * b over kc, a and b packed, only the top left rows x columns get written */
+typedef void (*SWM_GemmKernel)(uint32_t kc, float alpha, const float *a, const float *b, float *C, uint32_t ldc, uint32_t rows, uint32_t columns);
+
+/* one sparse row times a dense input */
+typedef float (*SWM_CsrRowDot)(const float *values, const uint32_t *columnIndices, uint32_t amount, const float *x);
+
+typedef void (*SWM_GemmInt8Kernel)(uint32_t M, uint32_t N, uint32_t K, const uint8_t *A, uint32_t lda, const int8_t *B, uint32_t ldb, int32_t *C, uint32_t ldc);
+
+typedef void (*SWM_ConvolutionTileKernel)(const float *input, size_t channelStride, size_t rowStride, uint32_t channels, uint32_t kernelSize, uint32_t stride, const float *weights, float *tile);
+
+typedef void (*SWM_PoolRowKernel)(const float *input, uint32_t inputWidth, uint32_t size, uint32_t stride, bool max, uint32_t width, float *output, uint32_t *indices, uint32_t indexOffset);
+typedef float (*SWM_SumKernel)(const float *values, size_t amount);
+
+/* what the CPU gets, picked once */
+typedef struct SWM_Kernels
+{
+    SWM_ToFloatConverter convertToFloat;
+    SWM_FromFloatConverter convertFromFloat;
+    SWM_GemmKernel gemm;
+    SWM_CsrRowDot csrRowDot;
+    SWM_GemmInt8Kernel gemmInt8;
+    SWM_ConvolutionTileKernel convolutionTile;
+    SWM_PoolRowKernel poolRow;
+    SWM_SumKernel sum;
+    const char *name;
+} SWM_Kernels;
+
+const SWM_Kernels *SWM_kernels(void);
+
+// SW_matrix_generic.c, plain C for every CPU
+
+void SWM_convertToFloatScalar(const void *source, SWM_Type type, float *destination, size_t amount);
+void SWM_convertFromFloatScalar(const float *source, void *destination, SWM_Type type, size_t amount);
+void SWM_gemmKernelGeneric(uint32_t kc, float alpha, const float *a, const float *b, float *C, uint32_t ldc, uint32_t rows, uint32_t columns);
+float SWM_csrRowDotGeneric(const float *values, const uint32_t *columnIndices, uint32_t amount, const float *x);
+void SWM_gemmInt8Scalar(uint32_t M, uint32_t N, uint32_t K, const uint8_t *A, uint32_t lda, const int8_t *B, uint32_t ldb, int32_t *C, uint32_t ldc);
+void SWM_convolutionTileGeneric(const float *input, size_t channelStride, size_t rowStride, uint32_t channels, uint32_t kernelSize, uint32_t stride, const float *weights, float *tile);
+void SWM_poolRowGeneric(const float *input, uint32_t inputWidth, uint32_t size, uint32_t stride, bool max, uint32_t width, float *output, uint32_t *indices, uint32_t indexOffset);
+float SWM_sumGeneric(const float *values, size_t amount);
+
+#ifdef SWM_X86
+
+// SW_matrix_avx2.c, AVX2 with FMA and F16C
+
+void SWM_convertToFloatAvx2(const void *source, SWM_Type type, float *destination, size_t amount);
+void SWM_convertFromFloatAvx2(const float *source, void *destination, SWM_Type type, size_t amount);
+void SWM_gemmKernelAvx2(uint32_t kc, float alpha, const float *a, const float *b, float *C, uint32_t ldc, uint32_t rows, uint32_t columns);
+float SWM_csrRowDotAvx2(const float *values, const uint32_t *columnIndices, uint32_t amount, const float *x);
+void SWM_gemmInt8Avx2(uint32_t M, uint32_t N, uint32_t K, const uint8_t *A, uint32_t lda, const int8_t *B, uint32_t ldb, int32_t *C, uint32_t ldc);
+void SWM_convolutionTileAvx2(const float *input, size_t channelStride, size_t rowStride, uint32_t channels, uint32_t kernelSize, uint32_t stride, const float *weights, float *tile);
+void SWM_poolRowAvx2(const float *input, uint32_t inputWidth, uint32_t size, uint32_t stride, bool max, uint32_t width, float *output, uint32_t *indices, uint32_t indexOffset);
+float SWM_sumAvx2(const float *values, size_t amount);
+
+// SW_matrix_avx512.c, AVX-512 BF16 and VNNI, each only used when the CPU has that one
+
+void SWM_convertFromFloatAvx512Bf16(const float *source, void *destination, SWM_Type type, size_t amount);
+void SWM_gemmInt8Avx512Vnni(uint32_t M, uint32_t N, uint32_t K, const uint8_t *A, uint32_t lda, const int8_t *B, uint32_t ldb, int32_t *C, uint32_t ldc);
+
+#endif // SWM_X86
+
+#endif // SW_MATRIX_KERNELS_H
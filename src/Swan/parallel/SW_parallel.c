@@ -0,0 +1,507 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include "SW_parallel.h"
+#include "SW_trace.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SWP_PAUSE() _mm_pause()
+#else
+#define SWP_PAUSE() ((void)0)
+#endif
+
+#define SWP_MAX_THREADS 256
+
+// How often a worker checks for new work before it goes to sleep, up to a few hundred microseconds, so back to back jobs don't pay for a wake up
+// With more threads than CPUs spinning only takes time from the threads doing the work, then nobody spins
+#define SWP_SPIN_COUNT 4000
+
+// Roughly how many multiply adds a block should be worth
+#define SWP_BLOCK_COST 32768
+
+// The blocks a thread still has to run, the first in the low half and one past the last in the high half
+// The owner takes them from the front and thieves from the back, both with a compare exchange on the whole thing
+typedef struct SWP_Queue
+{
+    _Alignas(64) _Atomic uint64_t blocks;
+} SWP_Queue;
+
+typedef struct SWP_Job
+{
+    SWP_Task task;
+    void *context;
+    size_t begin, end, grain;
+} SWP_Job;
+
+typedef struct SWP_Pool
+{
+    pthread_mutex_t submit;         // One SWP_parallelFor at a time, also held while changing settings
+    pthread_mutex_t sleep;
+    pthread_cond_t wake;
+
+    pthread_t *workers;
+    uint32_t threadCount;           // Workers plus the calling thread, 0 while they aren't running
+    uint32_t requestedThreads;      // 0 for the default
+    uint32_t *cpus;                 // NULL when the workers aren't pinned
+    uint32_t cpuAmount;
+    bool affinityRead;              // SWAN_THREAD_AFFINITY only counts until SWP_setThreadAffinity is called
+
+    _Atomic uint64_t generation;    // Goes up for every job, the workers wait for it to change
+    _Atomic uint32_t sleeping;
+    _Atomic uint32_t remaining;     // Workers that haven't finished the current job yet
+    _Atomic bool stopping;
+    uint64_t startGeneration;
+    uint32_t spinCount;
+
+    SWP_Job job;
+} SWP_Pool;
+
+static SWP_Pool SWP_pool = { .submit = PTHREAD_MUTEX_INITIALIZER, .sleep = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER };
+static SWP_Queue SWP_queues[SWP_MAX_THREADS];
+static char SWP_workerNames[SWP_MAX_THREADS][16];   // For the trace, they have to outlive the workers
+
+static _Thread_local bool SWP_insideTask = false;
+static _Thread_local uint32_t SWP_threadIndex = 0;
+
+// setup
+
+static uint32_t SWP_availableCpus(uint32_t *cpus, uint32_t maxAmount)
+{
+#ifdef __linux__
+    cpu_set_t Set;
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &Set) == 0)
+    {
+        uint32_t Amount = 0;
+        for (uint32_t i = 0; i < CPU_SETSIZE && Amount < maxAmount; i++)
+            if (CPU_ISSET(i, &Set))
+            {
+                if (cpus != NULL) cpus[Amount] = i;
+                Amount++;
+            }
+
+        if (Amount != 0)
+            return Amount;
+    }
+#endif
+
+#ifdef _SC_NPROCESSORS_ONLN
+    long Amount = sysconf(_SC_NPROCESSORS_ONLN);
+    if (Amount > 0)
+    {
+        if ((unsigned long)Amount > maxAmount) Amount = maxAmount;
+        for (uint32_t i = 0; cpus != NULL && i < (uint32_t)Amount; i++)
+            cpus[i] = i;
+        return (uint32_t)Amount;
+    }
+#endif
+
+    if (cpus != NULL) cpus[0] = 0;
+    return 1;
+}
+
+static uint32_t SWP_defaultThreadCount(void)
+{
+    const char *Setting = getenv("SWAN_NUM_THREADS");
+    if (Setting != NULL && *Setting != '\0')
+    {
+        char *End;
+        unsigned long Amount = strtoul(Setting, &End, 10);
+        if (*End == '\0' && Amount != 0)
+            return Amount < SWP_MAX_THREADS ? (uint32_t)Amount : SWP_MAX_THREADS;
+
+        fputs("SWAN_NUM_THREADS should be a number of threads, ignoring it\n", stderr);
+    }
+
+    return SWP_availableCpus(NULL, SWP_MAX_THREADS);
+}
+
+static void SWP_readAffinity(void)
+{
+    SWP_pool.affinityRead = true;
+
+    const char *Setting = getenv("SWAN_THREAD_AFFINITY");
+    if (Setting == NULL || *Setting == '\0' || strcmp(Setting, "none") == 0)
+        return;
+
+    uint32_t Cpus[SWP_MAX_THREADS];
+    uint32_t Amount = 0;
+
+    if (strcmp(Setting, "compact") == 0)
+        Amount = SWP_availableCpus(Cpus, SWP_MAX_THREADS);
+    else
+    {
+        const char *Position = Setting;
+        while (*Position != '\0' && Amount < SWP_MAX_THREADS)
+        {
+            char *End;
+            unsigned long Cpu = strtoul(Position, &End, 10);
+            if (End == Position || (*End != ',' && *End != '\0'))
+            {
+                fputs("SWAN_THREAD_AFFINITY should be \"compact\" or a list of CPUs like \"0,2,4\", not pinning anything\n", stderr);
+                return;
+            }
+
+            Cpus[Amount++] = (uint32_t)Cpu;
+            Position = *End == ',' ? End + 1 : End;
+        }
+    }
+
+    if (Amount == 0)
+        return;
+
+    SWP_pool.cpus = malloc(sizeof(uint32_t) * Amount);
+    if (SWP_pool.cpus == NULL)
+        return;
+
+    memcpy(SWP_pool.cpus, Cpus, sizeof(uint32_t) * Amount);
+    SWP_pool.cpuAmount = Amount;
+}
+
+static void SWP_pin(uint32_t thread)
+{
+#ifdef __linux__
+    if (SWP_pool.cpus == NULL)
+        return;
+
+    cpu_set_t Set;
+    CPU_ZERO(&Set);
+    CPU_SET(SWP_pool.cpus[thread % SWP_pool.cpuAmount] % CPU_SETSIZE, &Set);
+
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &Set) != 0)
+        fputs("Couldn't pin a Swan thread to its CPU, it'll run wherever\n", stderr);
+#else
+    (void)thread;
+#endif
+}
+
+// blocks
+
+static bool SWP_takeBlock(uint32_t thread, uint32_t *block)
+{
+    _Atomic uint64_t *Blocks = &SWP_queues[thread].blocks;
+    uint64_t Value = atomic_load(Blocks);
+
+    for (;;)
+    {
+        uint32_t Front = (uint32_t)Value, Back = (uint32_t)(Value >> 32);
+        if (Front >= Back)
+            return false;
+
+        if (atomic_compare_exchange_weak(Blocks, &Value, (uint64_t)Back << 32 | (Front + 1)))
+        {
+            *block = Front;
+            return true;
+        }
+    }
+}
+
+static bool SWP_stealBlock(uint32_t thread, uint32_t *block)
+{
+    for (uint32_t i = 1; i < SWP_pool.threadCount; i++)
+    {
+        _Atomic uint64_t *Blocks = &SWP_queues[(thread + i) % SWP_pool.threadCount].blocks;
+        uint64_t Value = atomic_load(Blocks);
+
+        for (;;)
+        {
+            uint32_t Front = (uint32_t)Value, Back = (uint32_t)(Value >> 32);
+            if (Front >= Back)
+                break;
+
+            if (atomic_compare_exchange_weak(Blocks, &Value, (uint64_t)(Back - 1) << 32 | Front))
+            {
+                *block = Back - 1;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+static void SWP_runBlocks(uint32_t thread)
+{
+    const SWP_Job *Job = &SWP_pool.job;
+    uint32_t Block;
+    int64_t BlocksRun = 0;
+    uint64_t TraceBegin = SWP_traceBegin();
+
+    while (SWP_takeBlock(thread, &Block) || SWP_stealBlock(thread, &Block))
+    {
+        size_t Begin = Job->begin + (size_t)Block * Job->grain;
+        size_t End = Job->end - Begin > Job->grain ? Begin + Job->grain : Job->end;
+
+        Job->task(Job->context, Begin, End, thread);
+        BlocksRun++;
+    }
+
+    // The index is how many blocks this thread ran
+    if (BlocksRun != 0)
+        SWP_traceEnd(TraceBegin, "parallel for", "pool", BlocksRun);
+}
+
+// workers
+
+static uint64_t SWP_waitForWork(uint64_t seen)
+{
+    uint64_t Generation;
+
+    for (uint32_t i = 0; i < SWP_pool.spinCount; i++)
+    {
+        Generation = atomic_load(&SWP_pool.generation);
+        if (Generation != seen)
+            return Generation;
+
+        SWP_PAUSE();
+    }
+
+    // Whoever bumps the generation checks for sleepers after, and this checks the generation after saying it sleeps, so one of the two sees the other
+    pthread_mutex_lock(&SWP_pool.sleep);
+    atomic_fetch_add(&SWP_pool.sleeping, 1);
+
+    while ((Generation = atomic_load(&SWP_pool.generation)) == seen)
+        pthread_cond_wait(&SWP_pool.wake, &SWP_pool.sleep);
+
+    atomic_fetch_sub(&SWP_pool.sleeping, 1);
+    pthread_mutex_unlock(&SWP_pool.sleep);
+
+    return Generation;
+}
+
+static void *SWP_worker(void *argument)
+{
+    uint32_t Thread = (uint32_t)(uintptr_t)argument;
+    uint64_t Seen = SWP_pool.startGeneration;
+
+    SWP_pin(Thread);
+    SWP_setTraceThreadName(SWP_workerNames[Thread]);
+    SWP_insideTask = true;
+    SWP_threadIndex = Thread;
+
+    for (;;)
+    {
+        Seen = SWP_waitForWork(Seen);
+
+        if (atomic_load(&SWP_pool.stopping))
+            break;
+
+        SWP_runBlocks(Thread);
+        atomic_fetch_sub(&SWP_pool.remaining, 1);
+    }
+
+    return NULL;
+}
+
+static void SWP_wakeWorkers(void)
+{
+    atomic_fetch_add(&SWP_pool.generation, 1);
+
+    if (atomic_load(&SWP_pool.sleeping) != 0)
+    {
+        pthread_mutex_lock(&SWP_pool.sleep);
+        pthread_cond_broadcast(&SWP_pool.wake);
+        pthread_mutex_unlock(&SWP_pool.sleep);
+    }
+}
+
+// Needs the submit lock
+static void SWP_start(void)
+{
+    if (!SWP_pool.affinityRead)
+        SWP_readAffinity();
+
+    uint32_t ThreadCount = SWP_pool.requestedThreads != 0 ? SWP_pool.requestedThreads : SWP_defaultThreadCount();
+
+    SWP_pool.threadCount = 1;
+    if (ThreadCount == 1)
+        return;
+
+    SWP_pool.workers = malloc(sizeof(pthread_t) * ThreadCount);
+    if (SWP_pool.workers == NULL)
+    {
+        fputs("No memory for threads, everything runs on one\n", stderr);
+        return;
+    }
+
+    atomic_store(&SWP_pool.stopping, false);
+    SWP_pool.spinCount = ThreadCount <= SWP_availableCpus(NULL, SWP_MAX_THREADS) ? SWP_SPIN_COUNT : 0;
+    SWP_pool.startGeneration = atomic_load(&SWP_pool.generation);
+
+    for (uint32_t i = 1; i < ThreadCount; i++)
+    {
+        snprintf(SWP_workerNames[i], sizeof(SWP_workerNames[i]), "swan worker %u", i);
+
+        if (pthread_create(&SWP_pool.workers[i], NULL, SWP_worker, (void *)(uintptr_t)i) != 0)
+        {
+            fputs("Couldn't start all the threads asked for, going with what there is\n", stderr);
+            break;
+        }
+
+        SWP_pool.threadCount = i + 1;
+    }
+}
+
+// Needs the submit lock
+static void SWP_stop(void)
+{
+    if (SWP_pool.threadCount > 1)
+    {
+        atomic_store(&SWP_pool.stopping, true);
+
+        pthread_mutex_lock(&SWP_pool.sleep);
+        atomic_fetch_add(&SWP_pool.generation, 1);
+        pthread_cond_broadcast(&SWP_pool.wake);
+        pthread_mutex_unlock(&SWP_pool.sleep);
+
+        for (uint32_t i = 1; i < SWP_pool.threadCount; i++)
+            pthread_join(SWP_pool.workers[i], NULL);
+    }
+
+    free(SWP_pool.workers);
+    SWP_pool.workers = NULL;
+    SWP_pool.threadCount = 0;
+}
+
+// parallel for
+
+void SWP_parallelFor(size_t begin, size_t end, size_t grain, SWP_Task task, void *context)
+{
+    if (end <= begin)
+        return;
+
+    if (grain == 0)
+        grain = 1;
+
+    // Block numbers have to fit in half of a queue
+    if ((end - begin - 1) / grain >= UINT32_MAX)
+        grain = (end - begin - 1) / (UINT32_MAX - 1) + 1;
+
+    size_t BlockAmount = (end - begin - 1) / grain + 1;
+
+    if (BlockAmount == 1 || SWP_insideTask)
+    {
+        task(context, begin, end, SWP_threadIndex);
+        return;
+    }
+
+    pthread_mutex_lock(&SWP_pool.submit);
+
+    if (SWP_pool.threadCount == 0)
+        SWP_start();
+
+    uint32_t ThreadCount = SWP_pool.threadCount;
+
+    if (ThreadCount == 1)
+    {
+        pthread_mutex_unlock(&SWP_pool.submit);
+        task(context, begin, end, 0);
+        return;
+    }
+
+    // Every thread starts with an equal part of the blocks in a row, so neighbouring blocks tend to stay on one core
+    SWP_pool.job = (SWP_Job){ task, context, begin, end, grain };
+
+    for (uint32_t i = 0; i < ThreadCount; i++)
+    {
+        uint64_t Front = BlockAmount * i / ThreadCount;
+        uint64_t Back = BlockAmount * (i + 1) / ThreadCount;
+        atomic_store(&SWP_queues[i].blocks, Back << 32 | Front);
+    }
+
+    atomic_store(&SWP_pool.remaining, ThreadCount - 1);
+    SWP_wakeWorkers();
+
+    SWP_insideTask = true;
+    SWP_runBlocks(0);
+    SWP_insideTask = false;
+
+    // The last blocks can still be running on other threads
+    for (uint32_t i = 0; atomic_load(&SWP_pool.remaining) != 0; i++)
+    {
+        if (i < SWP_pool.spinCount)
+            SWP_PAUSE();
+        else
+            sched_yield();
+    }
+
+    pthread_mutex_unlock(&SWP_pool.submit);
+}
+
+size_t SWP_grainFor(size_t itemCost)
+{
+    return itemCost < SWP_BLOCK_COST ? SWP_BLOCK_COST / (itemCost != 0 ? itemCost : 1) : 1;
+}
+
+// settings
+
+void SWP_setThreadCount(uint32_t threadCount)
+{
+    pthread_mutex_lock(&SWP_pool.submit);
+
+    SWP_stop();
+    SWP_pool.requestedThreads = threadCount < SWP_MAX_THREADS ? threadCount : SWP_MAX_THREADS;
+
+    pthread_mutex_unlock(&SWP_pool.submit);
+}
+
+uint32_t SWP_getThreadCount(void)
+{
+    // The thread that started the running job holds the lock until every task is done
+    if (SWP_insideTask)
+        return SWP_pool.threadCount;
+
+    pthread_mutex_lock(&SWP_pool.submit);
+
+    if (SWP_pool.threadCount == 0)
+        SWP_start();
+
+    uint32_t ThreadCount = SWP_pool.threadCount;
+
+    pthread_mutex_unlock(&SWP_pool.submit);
+
+    return ThreadCount;
+}
+
+void SWP_setThreadAffinity(const uint32_t *cpus, uint32_t cpuAmount)
+{
+    pthread_mutex_lock(&SWP_pool.submit);
+
+    SWP_stop();
+
+    free(SWP_pool.cpus);
+    SWP_pool.cpus = NULL;
+    SWP_pool.cpuAmount = 0;
+    SWP_pool.affinityRead = true;
+
+    if (cpus != NULL && cpuAmount != 0)
+    {
+        SWP_pool.cpus = malloc(sizeof(uint32_t) * cpuAmount);
+        if (SWP_pool.cpus == NULL)
+            fputs("Not even a list of CPUs fits in memory, not pinning anything\n", stderr);
+        else
+        {
+            memcpy(SWP_pool.cpus, cpus, sizeof(uint32_t) * cpuAmount);
+            SWP_pool.cpuAmount = cpuAmount;
+        }
+    }
+
+    pthread_mutex_unlock(&SWP_pool.submit);
+}
+
+void SWP_shutdown(void)
+{
+    pthread_mutex_lock(&SWP_pool.submit);
+    SWP_stop();
+    pthread_mutex_unlock(&SWP_pool.submit);
+}
@@ -0,0 +1,34 @@
+#ifndef SW_PARALLEL_H
+#define SW_PARALLEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* one pool of worker threads for all of Swan, anything that wants more cores goes through SWP_parallelFor instead of starting its own threads
+   the workers start on the first SWP_parallelFor and stay around, spinning a little after each job and then sleeping until the next one
+
+   SWAN_NUM_THREADS sets the amount of threads, counting the one calling SWP_parallelFor, the default is one per CPU the process may use
+   SWAN_THREAD_AFFINITY pins the workers, "compact" puts thread i on the i-th CPU the process may use, a list like "0,2,4,6" on the i-th entry
+   the calling thread is never pinned, it's not ours */
+
+/* runs the items [begin, end) of one block, thread is below SWP_getThreadCount() and two blocks running at the same time never get the same one */
+typedef void (*SWP_Task)(void *context, size_t begin, size_t end, uint32_t thread);
+
+// parallel for
+
+/* splits [begin, end) into blocks of grain items and runs task on every block, returns once they're all done
+   every thread starts on its own part of the range and takes blocks from the others once it runs out
+   calls from inside a task, and ranges of a single block, just run on the calling thread */
+void SWP_parallelFor(size_t begin, size_t end, size_t grain, SWP_Task task, void *context);
+
+/* grain for items costing itemCost each (in roughly one multiply add), so a block is worth waking a thread for */
+size_t SWP_grainFor(size_t itemCost);
+
+// settings, these wait for running work and restart the workers
+
+void SWP_setThreadCount(uint32_t threadCount);                          /* 0 goes back to SWAN_NUM_THREADS or the default */
+uint32_t SWP_getThreadCount(void);
+void SWP_setThreadAffinity(const uint32_t *cpus, uint32_t cpuAmount);   /* worker i runs on cpus[i % cpuAmount], NULL unpins them */
+void SWP_shutdown(void);                                                /* stops the workers, the next SWP_parallelFor starts them again */
+
+#endif // SW_PARALLEL_H
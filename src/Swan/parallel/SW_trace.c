@@ -0,0 +1,225 @@
+#include "SW_trace.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+// Events each thread keeps, a power of two, 40 bytes each
+#define SWP_TRACE_CAPACITY 65536
+
+typedef struct SWP_TraceEvent
+{
+    const char *name;
+    const char *category;
+    uint64_t begin, duration;
+    int64_t argument;
+} SWP_TraceEvent;
+
+// Only the thread it belongs to writes to a ring, the writer reads up to written
+typedef struct SWP_TraceRing
+{
+    SWP_TraceEvent *events;
+    _Atomic uint64_t written;       // Events ever recorded, the ring has the last SWP_TRACE_CAPACITY of them
+    uint32_t thread;
+    const char *_Atomic name;
+    struct SWP_TraceRing *next;
+} SWP_TraceRing;
+
+static _Atomic bool SWP_tracing = false;
+static _Atomic uint64_t SWP_traceEpoch = 0;     // Events from before the last SWP_startTrace get skipped, clearing rings other threads write to isn't safe
+
+// Rings are never freed, a thread that's gone can still have events to write
+static pthread_mutex_t SWP_traceLock = PTHREAD_MUTEX_INITIALIZER;
+static SWP_TraceRing *SWP_traceRings = NULL;
+static uint32_t SWP_traceThreads = 0;
+
+static _Thread_local SWP_TraceRing *SWP_traceRing = NULL;
+static _Thread_local const char *SWP_traceThreadName = NULL;
+
+static const char *SWP_traceFile = NULL;
+
+static uint64_t SWP_traceClock(void)
+{
+    struct timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+
+    return (uint64_t)Time.tv_sec * 1000000000u + (uint64_t)Time.tv_nsec;
+}
+
+static SWP_TraceRing *SWP_getTraceRing(void)
+{
+    if (SWP_traceRing != NULL)
+        return SWP_traceRing;
+
+    SWP_TraceRing *Ring = calloc(1, sizeof(SWP_TraceRing));
+    SWP_TraceEvent *Events = malloc(sizeof(SWP_TraceEvent) * SWP_TRACE_CAPACITY);
+
+    // Tracing isn't worth crashing over, this thread just won't show up
+    if (Ring == NULL || Events == NULL)
+    {
+        free(Ring);
+        free(Events);
+        return NULL;
+    }
+
+    Ring->events = Events;
+    atomic_store(&Ring->name, SWP_traceThreadName);
+
+    pthread_mutex_lock(&SWP_traceLock);
+    Ring->thread = SWP_traceThreads++;
+    Ring->next = SWP_traceRings;
+    SWP_traceRings = Ring;
+    pthread_mutex_unlock(&SWP_traceLock);
+
+    SWP_traceRing = Ring;
+    return Ring;
+}
+
+// tracing
+
+void SWP_startTrace(void)
+{
+    atomic_store(&SWP_traceEpoch, SWP_traceClock());
+    atomic_store(&SWP_tracing, true);
+}
+
+void SWP_stopTrace(void)
+{
+    atomic_store(&SWP_tracing, false);
+}
+
+static void SWP_writeEscaped(FILE *file, const char *text)
+{
+    for (; *text != '\0'; text++)
+    {
+        if (*text == '"' || *text == '\\')
+            fputc('\\', file);
+
+        if ((unsigned char)*text >= 0x20)
+            fputc(*text, file);
+    }
+}
+
+bool SWP_writeTrace(const char *fileName)
+{
+    FILE *File = fopen(fileName, "w");
+    if (File == NULL)
+    {
+        fputs("Couldn't open the file for the trace\n", stderr);
+        return false;
+    }
+
+    uint64_t Epoch = atomic_load(&SWP_traceEpoch);
+    bool First = true;
+
+    fputs("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [", File);
+
+    pthread_mutex_lock(&SWP_traceLock);
+
+    for (SWP_TraceRing *Ring = SWP_traceRings; Ring != NULL; Ring = Ring->next)
+    {
+        const char *Name = atomic_load(&Ring->name);
+
+        fprintf(File, "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"", First ? "" : ",", Ring->thread);
+        if (Name != NULL)
+            SWP_writeEscaped(File, Name);
+        else
+            fprintf(File, "thread %u", Ring->thread);
+        fputs("\"}}", File);
+        First = false;
+
+        uint64_t Written = atomic_load(&Ring->written);
+        uint64_t Oldest = Written > SWP_TRACE_CAPACITY ? Written - SWP_TRACE_CAPACITY : 0;
+
+        for (uint64_t i = Oldest; i < Written; i++)
+        {
+            const SWP_TraceEvent *Event = &Ring->events[i % SWP_TRACE_CAPACITY];
+            if (Event->begin < Epoch) continue;
+
+            // Chrome wants microseconds
+            fputs(",\n{\"name\": \"", File);
+            SWP_writeEscaped(File, Event->name);
+            fputs("\", \"cat\": \"", File);
+            SWP_writeEscaped(File, Event->category);
+            fprintf(File, "\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f", Ring->thread, (Event->begin - Epoch) / 1e3, Event->duration / 1e3);
+
+            if (Event->argument >= 0)
+                fprintf(File, ", \"args\": {\"index\": %lld}", (long long)Event->argument);
+
+            fputc('}', File);
+        }
+    }
+
+    pthread_mutex_unlock(&SWP_traceLock);
+
+    fputs("\n]}\n", File);
+
+    bool Worked = !ferror(File);
+    if (fclose(File) != 0)
+        Worked = false;
+
+    if (!Worked)
+        fputs("Writing the trace went wrong somewhere\n", stderr);
+
+    return Worked;
+}
+
+// events
+
+uint64_t SWP_traceBegin(void)
+{
+    if (!atomic_load_explicit(&SWP_tracing, memory_order_relaxed))
+        return 0;
+
+    return SWP_traceClock();
+}
+
+void SWP_traceEnd(uint64_t begin, const char *name, const char *category, int64_t argument)
+{
+    if (begin == 0 || !atomic_load_explicit(&SWP_tracing, memory_order_relaxed))
+        return;
+
+    uint64_t End = SWP_traceClock();
+
+    SWP_TraceRing *Ring = SWP_getTraceRing();
+    if (Ring == NULL)
+        return;
+
+    uint64_t Written = atomic_load_explicit(&Ring->written, memory_order_relaxed);
+    Ring->events[Written % SWP_TRACE_CAPACITY] = (SWP_TraceEvent){ name, category, begin, End - begin, argument };
+
+    // The event has to be there before the writer can see it
+    atomic_store_explicit(&Ring->written, Written + 1, memory_order_release);
+}
+
+void SWP_setTraceThreadName(const char *name)
+{
+    SWP_traceThreadName = name;
+
+    if (SWP_traceRing != NULL)
+        atomic_store(&SWP_traceRing->name, name);
+}
+
+// SWAN_TRACE
+
+static void SWP_writeTraceAtExit(void)
+{
+    SWP_stopTrace();
+    SWP_writeTrace(SWP_traceFile);
+}
+
+__attribute__((constructor))
+static void SWP_traceFromEnvironment(void)
+{
+    const char *File = getenv("SWAN_TRACE");
+    if (File == NULL || *File == '\0')
+        return;
+
+    SWP_traceFile = File;
+    SWP_startTrace();
+    atexit(SWP_writeTraceAtExit);
+}
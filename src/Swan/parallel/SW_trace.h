@@ -0,0 +1,28 @@
+#ifndef SW_TRACE_H
+#define SW_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* a timeline of what every thread was doing, written out as Chrome trace JSON (chrome://tracing or ui.perfetto.dev)
+   every thread records into its own ring, so tracing takes no locks, a full ring drops its oldest events
+   SWAN_TRACE=file.json traces the whole run and writes it when the program exits */
+
+// tracing
+
+void SWP_startTrace(void);                  /* drops anything recorded before */
+void SWP_stopTrace(void);
+bool SWP_writeTrace(const char *fileName);  /* call it once the traced work is done, false if the file couldn't be written */
+
+// events
+
+/* when the event started, 0 when not tracing, so SWP_traceEnd knows to skip it */
+uint64_t SWP_traceBegin(void);
+
+/* records [begin, now) on the calling thread, name and category have to stay around (string literals), argument shows up as "index" unless it's negative */
+void SWP_traceEnd(uint64_t begin, const char *name, const char *category, int64_t argument);
+
+/* what the calling thread shows up as, name has to stay around */
+void SWP_setTraceThreadName(const char *name);
+
+#endif // SW_TRACE_H
@@ -0,0 +1,799 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Swan.h"
+#include "SW_util.h"
+
+// Benchmarks for Swan on made up data, the results are JSON in the same order and with the same names every run so two of them can be diffed
+// Every benchmark is calibrated to a number of iterations that takes at least --min-time, then timed --repetitions times with that many iterations
+
+typedef void (*BN_Function)(void *context, uint64_t iterations);
+
+typedef struct BN_Settings
+{
+    const char *filter;     // Only benchmarks with this in their name run
+    uint32_t repetitions;
+    double minTime;         // Seconds a repetition takes at least
+    bool quick;             // Fewer repetitions and shapes, to see that everything still runs
+    bool list;              // Print the names instead of running them
+} BN_Settings;
+
+static BN_Settings BN_settings = { NULL, 10, 0.02, false, false };
+
+static FILE *BN_output = NULL;
+static bool BN_firstResult = true;
+
+// Keeps the compiler from dropping work nothing reads
+static volatile float BN_sink;
+
+// Latency benchmarks keep every call, this many at most per repetition
+#define BN_MAX_LATENCY_CALLS 20000
+
+static double BN_Clock(void)
+{
+    struct timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+
+    return (double)Time.tv_sec + (double)Time.tv_nsec / 1e9;
+}
+
+static bool BN_Selected(const char *name)
+{
+    if (BN_settings.filter != NULL && strstr(name, BN_settings.filter) == NULL)
+        return false;
+
+    if (BN_settings.list)
+    {
+        puts(name);
+        return false;
+    }
+
+    return true;
+}
+
+static void *BN_Allocate(size_t size)
+{
+    // Workspaces can be 0 bytes
+    void *Memory = malloc(size != 0 ? size : 1);
+    if (Memory == NULL)
+    {
+        fputs("The benchmark ran out of memory before Swan even got to\n", stderr);
+        exit(1);
+    }
+
+    return Memory;
+}
+
+static float *BN_RandomFloats(size_t amount, float low, float high)
+{
+    float *Values = BN_Allocate(amount * sizeof(float));
+
+    for (size_t i = 0; i < amount; i++)
+        Values[i] = low + (high - low) * ((float)rand() / (float)RAND_MAX);
+
+    return Values;
+}
+
+// results
+
+static int BN_CompareDoubles(const void *a, const void *b)
+{
+    double A = *(const double *)a, B = *(const double *)b;
+    return (A > B) - (A < B);
+}
+
+// values gets sorted
+static double BN_Percentile(double *values, size_t amount, double percentile)
+{
+    qsort(values, amount, sizeof(double), BN_CompareDoubles);
+
+    double Position = percentile / 100.0 * (double)(amount - 1);
+    size_t Below = (size_t)Position;
+    if (Below + 1 >= amount)
+        return values[amount - 1];
+
+    return values[Below] + (Position - (double)Below) * (values[Below + 1] - values[Below]);
+}
+
+// samples are the seconds one iteration took in each repetition, work is what one iteration does in the unit throughput is in
+static void BN_Report(const char *name, const char *throughputUnit, double work, uint64_t iterations, const double *samples, const double *latencies, size_t latencyAmount)
+{
+    uint32_t Amount = BN_settings.repetitions;
+
+    double *Sorted = BN_Allocate(Amount * sizeof(double));
+    memcpy(Sorted, samples, Amount * sizeof(double));
+
+    double Median = BN_Percentile(Sorted, Amount, 50.0);
+    double Throughput = Median > 0.0 ? work / Median : 0.0;
+
+    fprintf(BN_output, "%s\n    {\"name\": \"%s\", \"iterations\": %llu, \"seconds\": [", BN_firstResult ? "" : ",", name, (unsigned long long)iterations);
+    for (uint32_t i = 0; i < Amount; i++)
+        fprintf(BN_output, "%s%.9g", i != 0 ? ", " : "", samples[i]);
+    fprintf(BN_output, "], \"median\": %.9g, \"min\": %.9g, \"max\": %.9g, \"throughput\": %.9g, \"throughputUnit\": \"%s\"",
+        Median, Sorted[0], Sorted[Amount - 1], Throughput, throughputUnit);
+
+    fprintf(stderr, "%-60s %12.3f us %12.2f %s", name, Median * 1e6, Throughput, throughputUnit);
+
+    if (latencies != NULL)
+    {
+        double *Calls = BN_Allocate(latencyAmount * sizeof(double));
+        memcpy(Calls, latencies, latencyAmount * sizeof(double));
+
+        double P50 = BN_Percentile(Calls, latencyAmount, 50.0);
+        double P90 = BN_Percentile(Calls, latencyAmount, 90.0);
+        double P99 = BN_Percentile(Calls, latencyAmount, 99.0);
+        double P999 = BN_Percentile(Calls, latencyAmount, 99.9);
+
+        fprintf(BN_output, ", \"percentiles\": {\"p50\": %.9g, \"p90\": %.9g, \"p99\": %.9g, \"p999\": %.9g}", P50, P90, P99, P999);
+        fprintf(stderr, "  p50 %.2f us  p99 %.2f us", P50 * 1e6, P99 * 1e6);
+
+        free(Calls);
+    }
+
+    fputs("}", BN_output);
+    fputc('\n', stderr);
+    BN_firstResult = false;
+
+    free(Sorted);
+}
+
+// running
+
+static double BN_Time(BN_Function function, void *context, uint64_t iterations)
+{
+    double Start = BN_Clock();
+    function(context, iterations);
+    return BN_Clock() - Start;
+}
+
+// Doubles as the warmup, the last try already ran with the iterations that get used
+static uint64_t BN_Calibrate(BN_Function function, void *context)
+{
+    uint64_t Iterations = 1;
+
+    for (;;)
+    {
+        double Seconds = BN_Time(function, context, Iterations);
+        if (Seconds >= BN_settings.minTime || Iterations >= (1ull << 40))
+            return Iterations;
+
+        // Aim a little past minTime so the next try is usually the last one
+        double Scale = Seconds > 0.0 ? 1.4 * BN_settings.minTime / Seconds : 100.0;
+        if (Scale > 100.0) Scale = 100.0;
+        if (Scale < 2.0) Scale = 2.0;
+
+        Iterations = (uint64_t)((double)Iterations * Scale);
+    }
+}
+
+static void BN_Run(const char *name, const char *throughputUnit, double work, BN_Function function, void *context)
+{
+    if (!BN_Selected(name))
+        return;
+
+    uint64_t Iterations = BN_Calibrate(function, context);
+
+    double *Samples = BN_Allocate(BN_settings.repetitions * sizeof(double));
+    for (uint32_t r = 0; r < BN_settings.repetitions; r++)
+        Samples[r] = BN_Time(function, context, Iterations) / (double)Iterations;
+
+    BN_Report(name, throughputUnit, work, Iterations, Samples, NULL, 0);
+    free(Samples);
+}
+
+// Every call gets timed on its own for the percentiles, a repetition's sample is the median of its calls
+static void BN_RunLatency(const char *name, BN_Function function, void *context)
+{
+    if (!BN_Selected(name))
+        return;
+
+    uint64_t Calls = BN_Calibrate(function, context);
+    if (Calls > BN_MAX_LATENCY_CALLS)
+        Calls = BN_MAX_LATENCY_CALLS;
+
+    size_t LatencyAmount = (size_t)Calls * BN_settings.repetitions;
+    double *Latencies = BN_Allocate(LatencyAmount * sizeof(double));
+    double *Samples = BN_Allocate(BN_settings.repetitions * sizeof(double));
+    double *Repetition = BN_Allocate((size_t)Calls * sizeof(double));
+
+    for (uint32_t r = 0; r < BN_settings.repetitions; r++)
+    {
+        for (uint64_t i = 0; i < Calls; i++)
+            Latencies[r * Calls + i] = BN_Time(function, context, 1);
+
+        memcpy(Repetition, &Latencies[r * Calls], (size_t)Calls * sizeof(double));
+        Samples[r] = BN_Percentile(Repetition, (size_t)Calls, 50.0);
+    }
+
+    BN_Report(name, "calls/s", 1.0, Calls, Samples, Latencies, LatencyAmount);
+
+    free(Repetition);
+    free(Samples);
+    free(Latencies);
+}
+
+// gemm
+
+typedef struct BN_Gemm
+{
+    bool transA, transB;
+    uint32_t M, N, K;
+    SWM_Type type;
+    void *A, *B;
+    float *C;
+} BN_Gemm;
+
+static void BN_GemmIterations(void *context, uint64_t iterations)
+{
+    BN_Gemm *Gemm = context;
+
+    // A is M x K and B is K x N, stored the other way around when they're transposed
+    for (uint64_t i = 0; i < iterations; i++)
+        SWM_gemm(Gemm->transA, Gemm->transB, Gemm->M, Gemm->N, Gemm->K, 1.0f, Gemm->A, Gemm->type, Gemm->transA ? Gemm->M : Gemm->K,
+            Gemm->B, Gemm->type, Gemm->transB ? Gemm->K : Gemm->N, 0.0f, Gemm->C, Gemm->N);
+}
+
+static void *BN_RandomMatrix(size_t amount, SWM_Type type)
+{
+    float *Values = BN_RandomFloats(amount, -1.0f, 1.0f);
+    if (type == SWM_TYPE_FLOAT32)
+        return Values;
+
+    void *Converted = BN_Allocate(amount * SWM_typeSize(type));
+    SWM_convertFromFloat(Values, Converted, type, amount);
+    free(Values);
+
+    return Converted;
+}
+
+static void BN_BenchGemm(bool transA, bool transB, uint32_t M, uint32_t N, uint32_t K, SWM_Type type)
+{
+    static const char *TypeNames[] = { "f32", "bf16", "f16" };
+
+    char Name[96];
+    snprintf(Name, sizeof(Name), "gemm/%c%c/%s/%ux%ux%u", transA ? 't' : 'n', transB ? 't' : 'n', TypeNames[type], M, N, K);
+
+    if (!BN_Selected(Name))
+        return;
+
+    BN_Gemm Gemm = { transA, transB, M, N, K, type, BN_RandomMatrix((size_t)M * K, type), BN_RandomMatrix((size_t)K * N, type), BN_Allocate((size_t)M * N * sizeof(float)) };
+
+    // BN_Selected already printed the name if only listing, so BN_Run won't see it again
+    bool List = BN_settings.list;
+    BN_settings.list = false;
+    BN_Run(Name, "GFLOP/s", 2.0 * M * N * K / 1e9, BN_GemmIterations, &Gemm);
+    BN_settings.list = List;
+
+    free(Gemm.A);
+    free(Gemm.B);
+    free(Gemm.C);
+}
+
+static void BN_BenchGemms(void)
+{
+    // The gemms a 784-32 dense layer does with a batch of 32: forward, the weight gradient and the input error
+    BN_BenchGemm(false, true, 32, 32, 784, SWM_TYPE_FLOAT32);
+    BN_BenchGemm(true, false, 32, 784, 32, SWM_TYPE_FLOAT32);
+    BN_BenchGemm(false, false, 32, 784, 32, SWM_TYPE_FLOAT32);
+
+    // One sample at a time
+    BN_BenchGemm(false, true, 1, 1024, 1024, SWM_TYPE_FLOAT32);
+
+    // Square ones, in every layout and type
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        bool TransA = i == 2, TransB = i == 1;
+        BN_BenchGemm(TransA, TransB, 256, 256, 256, SWM_TYPE_FLOAT32);
+    }
+
+    BN_BenchGemm(false, true, 256, 256, 256, SWM_TYPE_BFLOAT16);
+    BN_BenchGemm(false, true, 256, 256, 256, SWM_TYPE_FLOAT16);
+
+    // Convolutions end up tall and thin
+    BN_BenchGemm(false, true, 3136, 16, 144, SWM_TYPE_FLOAT32);
+
+    if (!BN_settings.quick)
+    {
+        BN_BenchGemm(false, true, 1024, 1024, 1024, SWM_TYPE_FLOAT32);
+        BN_BenchGemm(false, true, 1024, 1024, 1024, SWM_TYPE_BFLOAT16);
+    }
+}
+
+// activations and loss
+
+#define BN_VALUE_AMOUNT (1u << 16)
+
+typedef struct BN_Values
+{
+    float *input, *output;
+    uint32_t amount;
+    uint32_t width;                         // Softmax and loss go over rows this wide
+    SW_ActivationFunction activationFunction;
+} BN_Values;
+
+static void BN_ActivationIterations(void *context, uint64_t iterations)
+{
+    BN_Values *Values = context;
+
+    for (uint64_t n = 0; n < iterations; n++)
+        for (uint32_t i = 0; i < Values->amount; i++)
+            Values->output[i] = SW_ApplyActivation(Values->input[i], Values->activationFunction);
+}
+
+static void BN_DerivativeIterations(void *context, uint64_t iterations)
+{
+    BN_Values *Values = context;
+
+    for (uint64_t n = 0; n < iterations; n++)
+        for (uint32_t i = 0; i < Values->amount; i++)
+            Values->output[i] = SW_ApplyActivationDerivative(Values->input[i], Values->activationFunction);
+}
+
+static void BN_SoftmaxIterations(void *context, uint64_t iterations)
+{
+    BN_Values *Values = context;
+
+    for (uint64_t n = 0; n < iterations; n++)
+        for (uint32_t i = 0; i + Values->width <= Values->amount; i += Values->width)
+            SW_Softmax(&Values->input[i], &Values->output[i], Values->width);
+}
+
+// The input is the correct output and output the prediction, softmax made it look like one
+static void BN_CrossEntropyIterations(void *context, uint64_t iterations)
+{
+    BN_Values *Values = context;
+    float Loss = 0.0f;
+
+    for (uint64_t n = 0; n < iterations; n++)
+        for (uint32_t i = 0; i + Values->width <= Values->amount; i += Values->width)
+            Loss += SW_CrossEntropy(&Values->input[i], &Values->output[i], Values->width);
+
+    BN_sink = Loss;
+}
+
+static void BN_BenchActivations(void)
+{
+    static const struct { const char *name; SW_ActivationFunction function; } Activations[] =
+    {
+        { "relu", SW_ACTIVATION_FUNCTION_RELU },
+        { "sigmoid", SW_ACTIVATION_FUNCTION_SIGMOID },
+        { "tanh", SW_ACTIVATION_FUNCTION_TANH },
+    };
+
+    BN_Values Values = { BN_RandomFloats(BN_VALUE_AMOUNT, -4.0f, 4.0f), BN_RandomFloats(BN_VALUE_AMOUNT, 0.0f, 1.0f), BN_VALUE_AMOUNT, 1, SW_ACTIVATION_FUNCTION_NONE };
+    char Name[96];
+
+    for (uint32_t i = 0; i < sizeof(Activations) / sizeof(Activations[0]); i++)
+    {
+        Values.activationFunction = Activations[i].function;
+
+        snprintf(Name, sizeof(Name), "activation/%s/%u", Activations[i].name, BN_VALUE_AMOUNT);
+        BN_Run(Name, "Melem/s", BN_VALUE_AMOUNT / 1e6, BN_ActivationIterations, &Values);
+
+        snprintf(Name, sizeof(Name), "activation/%s/derivative/%u", Activations[i].name, BN_VALUE_AMOUNT);
+        BN_Run(Name, "Melem/s", BN_VALUE_AMOUNT / 1e6, BN_DerivativeIterations, &Values);
+    }
+
+    // Ten wide like the output of an MNIST network, and a thousand wide like a big classifier
+    static const uint32_t Widths[] = { 10, 1000 };
+
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        Values.width = Widths[i];
+
+        snprintf(Name, sizeof(Name), "softmax/%u/%u", Widths[i], BN_VALUE_AMOUNT / Widths[i]);
+        BN_Run(Name, "Melem/s", BN_VALUE_AMOUNT / Widths[i] * Widths[i] / 1e6, BN_SoftmaxIterations, &Values);
+
+        // Softmax of the input makes proper probabilities for the loss to read
+        BN_SoftmaxIterations(&Values, 1);
+
+        snprintf(Name, sizeof(Name), "loss/cross-entropy/%u/%u", Widths[i], BN_VALUE_AMOUNT / Widths[i]);
+        BN_Run(Name, "Melem/s", BN_VALUE_AMOUNT / Widths[i] * Widths[i] / 1e6, BN_CrossEntropyIterations, &Values);
+    }
+
+    free(Values.input);
+    free(Values.output);
+}
+
+// layers
+
+// One layer of a network on its own, with everything the network would otherwise hand it
+typedef struct BN_Layer
+{
+    SW_Network network;
+    SW_Layer *layer;
+    SW_LayerBatch batch;
+} BN_Layer;
+
+static void BN_LayerForwardIterations(void *context, uint64_t iterations)
+{
+    BN_Layer *Layer = context;
+
+    for (uint64_t i = 0; i < iterations; i++)
+        Layer->layer->implementation->forwardBatch(Layer->layer, &Layer->batch);
+}
+
+static void BN_LayerBackwardIterations(void *context, uint64_t iterations)
+{
+    BN_Layer *Layer = context;
+
+    for (uint64_t i = 0; i < iterations; i++)
+        Layer->layer->implementation->backwardBatch(Layer->layer, &Layer->batch);
+}
+
+// network has the layer to benchmark last, it gets freed here
+static void BN_BenchLayer(const char *name, SW_Network *network, uint32_t batchSize)
+{
+    char Names[3][96];
+    snprintf(Names[0], sizeof(Names[0]), "layer/%s/forward/batch%u", name, batchSize);
+    snprintf(Names[1], sizeof(Names[1]), "layer/%s/inference/batch%u", name, batchSize);
+    snprintf(Names[2], sizeof(Names[2]), "layer/%s/backward/batch%u", name, batchSize);
+
+    bool Wanted[3];
+    for (uint32_t i = 0; i < 3; i++)
+        Wanted[i] = BN_Selected(Names[i]);
+
+    if (!Wanted[0] && !Wanted[1] && !Wanted[2])
+    {
+        SW_UnloadNetwork(network);
+        return;
+    }
+
+    BN_Layer Layer = { .network = *network };
+    Layer.layer = &Layer.network.layers[Layer.network.layerAmount - 1];
+
+    SW_Layer *Current = Layer.layer;
+    uint32_t InputAmount = Layer.network.layers[Layer.network.layerAmount - 2].neuronAmount;
+    size_t WeightAmount = (size_t)Current->weightRows * Current->weightColumns;
+
+    Layer.batch = (SW_LayerBatch)
+    {
+        .batchSize = batchSize,
+        .inference = false,
+        .type = SWM_TYPE_FLOAT32,
+        .input = BN_RandomFloats((size_t)batchSize * InputAmount, 0.0f, 1.0f),
+        .weights = Current->weights,
+        .weightType = SWM_TYPE_FLOAT32,
+        .workspace = BN_Allocate(Current->implementation->workspaceSize(Current, batchSize)),
+        .output = BN_Allocate((size_t)batchSize * Current->neuronAmount * sizeof(float)),
+        .outputErrorFloat = BN_RandomFloats((size_t)batchSize * Current->neuronAmount, -0.1f, 0.1f),
+        .gradientScale = 1.0f / batchSize,
+        .weightGradient = BN_Allocate(WeightAmount * sizeof(float)),
+        .biasGradient = BN_Allocate((Current->weightRows + 1) * sizeof(float)),
+        .inputError = BN_Allocate((size_t)batchSize * InputAmount * sizeof(float)),
+    };
+    Layer.batch.outputError = Layer.batch.outputErrorFloat;
+
+    // The already printed names don't need running again
+    bool List = BN_settings.list;
+    BN_settings.list = false;
+
+    if (Wanted[0])
+        BN_Run(Names[0], "samples/s", batchSize, BN_LayerForwardIterations, &Layer);
+
+    if (Wanted[1])
+    {
+        SW_LayerBatch Training = Layer.batch;
+        Layer.batch.inference = true;
+
+        // Inference has a scratch of its own, and the tuning shouldn't be timed
+        if (Current->implementation->prepare != NULL)
+            Current->implementation->prepare(Current);
+
+        size_t ScratchSize = Current->implementation->inferenceWorkspaceSize != NULL ? Current->implementation->inferenceWorkspaceSize(Current, batchSize) : 0;
+        Layer.batch.workspace = BN_Allocate(ScratchSize);
+
+        BN_Run(Names[1], "samples/s", batchSize, BN_LayerForwardIterations, &Layer);
+
+        free(Layer.batch.workspace);
+        Layer.batch = Training;
+    }
+
+    // Backward needs what forward kept in the workspace
+    if (Wanted[2])
+    {
+        BN_LayerForwardIterations(&Layer, 1);
+        BN_Run(Names[2], "samples/s", batchSize, BN_LayerBackwardIterations, &Layer);
+    }
+
+    BN_settings.list = List;
+
+    free((void *)Layer.batch.input);
+    free(Layer.batch.workspace);
+    free(Layer.batch.output);
+    free((void *)Layer.batch.outputErrorFloat);
+    free(Layer.batch.weightGradient);
+    free(Layer.batch.biasGradient);
+    free(Layer.batch.inputError);
+
+    SW_UnloadNetwork(&Layer.network);
+}
+
+static void BN_BenchLayers(void)
+{
+    SW_Network Network;
+
+    SW_InitNetwork(&Network);
+    SW_AddNetworkLayer(&Network, 784, SW_ACTIVATION_FUNCTION_RELU);
+    SW_AddNetworkLayer(&Network, 256, SW_ACTIVATION_FUNCTION_RELU);
+    SW_RandomizeNetwork(&Network);
+    BN_BenchLayer("dense/784x256", &Network, 64);
+
+    SW_InitNetwork(&Network);
+    SW_AddNetworkImageLayer(&Network, 1, 28, 28);
+    SW_AddNetworkConvolutionLayer(&Network, 16, 3, 1, 1, SW_ACTIVATION_FUNCTION_RELU);
+    SW_RandomizeNetwork(&Network);
+    BN_BenchLayer("convolution/1x28x28-16k3", &Network, 32);
+
+    SW_InitNetwork(&Network);
+    SW_AddNetworkImageLayer(&Network, 16, 14, 14);
+    SW_AddNetworkConvolutionLayer(&Network, 32, 3, 1, 1, SW_ACTIVATION_FUNCTION_RELU);
+    SW_RandomizeNetwork(&Network);
+    BN_BenchLayer("convolution/16x14x14-32k3", &Network, 32);
+
+    static const struct { const char *name; SW_PoolingType type; } Poolings[] =
+    {
+        { "max", SW_POOLING_TYPE_MAX },
+        { "average", SW_POOLING_TYPE_AVERAGE },
+        { "global-average", SW_POOLING_TYPE_GLOBAL_AVERAGE },
+    };
+
+    for (uint32_t i = 0; i < sizeof(Poolings) / sizeof(Poolings[0]); i++)
+    {
+        char Name[64];
+        snprintf(Name, sizeof(Name), "pooling/%s/16x28x28-2", Poolings[i].name);
+
+        SW_InitNetwork(&Network);
+        SW_AddNetworkImageLayer(&Network, 16, 28, 28);
+        SW_AddNetworkPoolingLayer(&Network, Poolings[i].type, 2, 2);
+        SW_RandomizeNetwork(&Network);
+        BN_BenchLayer(Name, &Network, 32);
+    }
+}
+
+// whole networks
+
+#define BN_SAMPLE_AMOUNT 1024
+
+typedef struct BN_Model
+{
+    SW_Network network;
+    float **inputs, **outputs;          // BN_SAMPLE_AMOUNT made up samples with a one hot output each
+    uint32_t sampleAmount;
+    uint32_t batchSize;
+    uint32_t next;                      // The sample the next latency call executes
+
+    float *batchInput, *batchOutput;    // batchSize samples in rows for SW_ExecuteNetworkBatch
+    void *workspace;
+    size_t workspaceSize;
+} BN_Model;
+
+static void BN_InitModel(BN_Model *model, uint32_t sampleAmount, uint32_t batchSize)
+{
+    SW_RandomizeNetwork(&model->network);
+
+    // Randomizing seeds from the time, the data should be the same every run
+    srand(1);
+
+    uint32_t InputAmount = model->network.layers[0].neuronAmount;
+    uint32_t OutputAmount = model->network.layers[model->network.layerAmount - 1].neuronAmount;
+
+    model->sampleAmount = sampleAmount;
+    model->batchSize = batchSize;
+    model->next = 0;
+    model->inputs = BN_Allocate(sampleAmount * sizeof(float *));
+    model->outputs = BN_Allocate(sampleAmount * sizeof(float *));
+
+    for (uint32_t i = 0; i < sampleAmount; i++)
+    {
+        model->inputs[i] = BN_RandomFloats(InputAmount, 0.0f, 1.0f);
+        model->outputs[i] = calloc(OutputAmount, sizeof(float));
+        if (model->outputs[i] == NULL)
+            exit(1);
+
+        model->outputs[i][rand() % OutputAmount] = 1.0f;
+    }
+
+    model->batchInput = BN_Allocate((size_t)batchSize * InputAmount * sizeof(float));
+    model->batchOutput = BN_Allocate((size_t)batchSize * OutputAmount * sizeof(float));
+    for (uint32_t i = 0; i < batchSize; i++)
+        memcpy(&model->batchInput[(size_t)i * InputAmount], model->inputs[i % sampleAmount], InputAmount * sizeof(float));
+
+    SW_PrepareNetwork(&model->network);
+    model->workspaceSize = SW_QueryWorkspaceSize(&model->network, batchSize, SW_WORKSPACE_USE_INFERENCE);
+    model->workspace = BN_Allocate(model->workspaceSize);
+}
+
+static void BN_FreeModel(BN_Model *model)
+{
+    for (uint32_t i = 0; i < model->sampleAmount; i++)
+    {
+        free(model->inputs[i]);
+        free(model->outputs[i]);
+    }
+
+    free(model->inputs);
+    free(model->outputs);
+    free(model->batchInput);
+    free(model->batchOutput);
+    free(model->workspace);
+
+    SW_UnloadNetwork(&model->network);
+}
+
+// One pass over all the samples, a target loss of 0 never stops it early
+static void BN_TrainIterations(void *context, uint64_t iterations)
+{
+    BN_Model *Model = context;
+
+    for (uint64_t i = 0; i < iterations; i++)
+        BN_sink = SW_TrainNeuralNetwork(&Model->network, Model->inputs, Model->outputs, Model->sampleAmount, Model->batchSize, 0.0f, SW_LOSS_FUNCTION_MEAN_SQUARED_ERROR);
+}
+
+static void BN_BatchIterations(void *context, uint64_t iterations)
+{
+    BN_Model *Model = context;
+
+    for (uint64_t i = 0; i < iterations; i++)
+        SW_ExecuteNetworkBatch(&Model->network, Model->batchInput, Model->batchOutput, Model->batchSize, Model->workspace, Model->workspaceSize);
+}
+
+static void BN_ExecuteIterations(void *context, uint64_t iterations)
+{
+    BN_Model *Model = context;
+
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        SW_SetNetworkInput(&Model->network, Model->inputs[Model->next]);
+        SW_ExucuteNetwork(&Model->network);
+        Model->next = (Model->next + 1) % Model->sampleAmount;
+    }
+}
+
+static void BN_CompiledIterations(void *context, uint64_t iterations)
+{
+    BN_Model *Model = context;
+
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        SW_ExecuteCompiledNetwork(&Model->network, Model->inputs[Model->next], Model->batchOutput);
+        Model->next = (Model->next + 1) % Model->sampleAmount;
+    }
+}
+
+static void BN_BenchModel(const char *name, BN_Model *model)
+{
+    char Name[96];
+
+    snprintf(Name, sizeof(Name), "train/%s/batch%u", name, model->batchSize);
+    BN_Run(Name, "samples/s", model->sampleAmount, BN_TrainIterations, model);
+
+    snprintf(Name, sizeof(Name), "inference/%s/batch%u", name, model->batchSize);
+    BN_Run(Name, "samples/s", model->batchSize, BN_BatchIterations, model);
+
+    snprintf(Name, sizeof(Name), "inference/%s/latency", name);
+    BN_RunLatency(Name, BN_ExecuteIterations, model);
+
+    // Only networks the compiler takes, the name stays in the output either way so it doesn't look like it went missing in a diff
+    snprintf(Name, sizeof(Name), "inference/%s/latency/compiled", name);
+    if (SW_CompileNetwork(&model->network))
+        BN_RunLatency(Name, BN_CompiledIterations, model);
+}
+
+static void BN_BenchModels(void)
+{
+    BN_Model Model;
+
+    // The network main.c trains on MNIST
+    SW_InitNetwork(&Model.network);
+    SW_AddNetworkLayer(&Model.network, 28 * 28, SW_ACTIVATION_FUNCTION_RELU);
+    SW_AddNetworkLayer(&Model.network, 32, SW_ACTIVATION_FUNCTION_RELU);
+    SW_AddNetworkLayer(&Model.network, 32, SW_ACTIVATION_FUNCTION_RELU);
+    SW_AddNetworkLayer(&Model.network, 10, SW_ACTIVATION_FUNCTION_SIGMOID);
+    BN_InitModel(&Model, BN_SAMPLE_AMOUNT, 32);
+    BN_BenchModel("mnist-mlp", &Model);
+    BN_FreeModel(&Model);
+
+    // A small convolutional one on the same images
+    SW_InitNetwork(&Model.network);
+    SW_AddNetworkImageLayer(&Model.network, 1, 28, 28);
+    SW_AddNetworkConvolutionLayer(&Model.network, 8, 3, 1, 1, SW_ACTIVATION_FUNCTION_RELU);
+    SW_AddNetworkPoolingLayer(&Model.network, SW_POOLING_TYPE_MAX, 2, 2);
+    SW_AddNetworkConvolutionLayer(&Model.network, 16, 3, 1, 1, SW_ACTIVATION_FUNCTION_RELU);
+    SW_AddNetworkPoolingLayer(&Model.network, SW_POOLING_TYPE_MAX, 2, 2);
+    SW_AddNetworkLayer(&Model.network, 10, SW_ACTIVATION_FUNCTION_SIGMOID);
+    BN_InitModel(&Model, BN_settings.quick ? 64 : 256, 32);
+    BN_BenchModel("mnist-cnn", &Model);
+    BN_FreeModel(&Model);
+}
+
+int main(int argc, char **argv)
+{
+    const char *OutputFile = NULL;
+    bool RepetitionsGiven = false, MinTimeGiven = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool HasValue = i + 1 < argc;
+
+        if (strcmp(argv[i], "--filter") == 0 && HasValue)
+            BN_settings.filter = argv[++i];
+        else if (strcmp(argv[i], "--repetitions") == 0 && HasValue)
+        {
+            BN_settings.repetitions = (uint32_t)strtoul(argv[++i], NULL, 10);
+            RepetitionsGiven = true;
+        }
+        else if (strcmp(argv[i], "--min-time") == 0 && HasValue)
+        {
+            BN_settings.minTime = strtod(argv[++i], NULL);
+            MinTimeGiven = true;
+        }
+        else if (strcmp(argv[i], "--output") == 0 && HasValue)
+            OutputFile = argv[++i];
+        else if (strcmp(argv[i], "--quick") == 0)
+            BN_settings.quick = true;
+        else if (strcmp(argv[i], "--list") == 0)
+            BN_settings.list = true;
+        else
+        {
+            fputs("usage: swan_bench [--filter text] [--repetitions n] [--min-time seconds] [--output results.json] [--quick] [--list]\n", stderr);
+            return 1;
+        }
+    }
+
+    if (BN_settings.quick)
+    {
+        if (!RepetitionsGiven) BN_settings.repetitions = 3;
+        if (!MinTimeGiven) BN_settings.minTime = 0.002;
+    }
+
+    if (BN_settings.repetitions == 0)
+        BN_settings.repetitions = 1;
+
+    BN_output = stdout;
+    if (OutputFile != NULL && !BN_settings.list)
+    {
+        BN_output = fopen(OutputFile, "w");
+        if (BN_output == NULL)
+        {
+            fputs("Can't write the results there\n", stderr);
+            return 1;
+        }
+    }
+
+    // The data is made up, but it's the same made up data every run
+    srand(1);
+
+#ifdef SW_PROFILE
+    bool Profiled = true;
+#else
+    bool Profiled = false;
+#endif
+
+    if (!BN_settings.list)
+        fprintf(BN_output, "{\"version\": 1, \"threads\": %u, \"isa\": \"%s\", \"repetitions\": %u, \"minTime\": %.9g, \"quick\": %s, \"profiled\": %s, \"benchmarks\": [",
+            SWP_getThreadCount(), SWM_kernelName(), BN_settings.repetitions, BN_settings.minTime, BN_settings.quick ? "true" : "false", Profiled ? "true" : "false");
+
+    BN_BenchGemms();
+    BN_BenchActivations();
+    BN_BenchLayers();
+    BN_BenchModels();
+
+    if (BN_settings.list)
+        return 0;
+
+    fputs("\n]}\n", BN_output);
+
+    if (BN_output != stdout && fclose(BN_output) != 0)
+    {
+        fputs("Writing the results went wrong somewhere\n", stderr);
+        return 1;
+    }
+
+    SWP_shutdown();
+    return 0;
+}
@@ -0,0 +1,546 @@
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Compares two swan_bench results and fails when something got slower than the threshold, and the noise can't explain it
+// usage: swan_bench_compare baseline.json current.json [--threshold percent] [--confidence level] [--filter text]
+//
+// For every benchmark both have, the change is the median of the current samples over the median of the baseline ones.
+// The confidence interval of that change comes from bootstrapping: both sample sets get resampled with replacement and the
+// ratio of their medians is taken, many times over. A regression is a change past the threshold whose whole interval is slower too.
+
+#define BC_BOOTSTRAP_ROUNDS 4000
+
+typedef struct BC_Benchmark
+{
+    char *name;
+    double *samples;
+    uint32_t sampleAmount;
+} BC_Benchmark;
+
+typedef struct BC_Results
+{
+    BC_Benchmark *benchmarks;
+    uint32_t benchmarkAmount;
+    double threads;
+    char *isa;
+    bool quick, profiled;
+} BC_Results;
+
+// parsing, only as much JSON as swan_bench writes, anything else in there gets skipped
+
+typedef struct BC_Parser
+{
+    const char *text;
+    const char *fileName;
+    bool failed;
+} BC_Parser;
+
+static void BC_Fail(BC_Parser *parser, const char *what)
+{
+    if (!parser->failed)
+        fprintf(stderr, "%s doesn't look like swan_bench output: %s\n", parser->fileName, what);
+
+    parser->failed = true;
+}
+
+static void BC_SkipSpace(BC_Parser *parser)
+{
+    while (isspace((unsigned char)*parser->text))
+        parser->text++;
+}
+
+static bool BC_Accept(BC_Parser *parser, char character)
+{
+    BC_SkipSpace(parser);
+    if (*parser->text != character)
+        return false;
+
+    parser->text++;
+    return true;
+}
+
+static void BC_Expect(BC_Parser *parser, char character)
+{
+    if (!BC_Accept(parser, character))
+    {
+        char What[32];
+        snprintf(What, sizeof(What), "expected '%c'", character);
+        BC_Fail(parser, What);
+    }
+}
+
+// Escapes are kept as they are, swan_bench names don't have any
+static char *BC_ParseString(BC_Parser *parser)
+{
+    BC_Expect(parser, '"');
+    if (parser->failed)
+        return NULL;
+
+    const char *Start = parser->text;
+    while (*parser->text != '"' && *parser->text != '\0')
+        parser->text += parser->text[0] == '\\' && parser->text[1] != '\0' ? 2 : 1;
+
+    if (*parser->text != '"')
+    {
+        BC_Fail(parser, "a string never ends");
+        return NULL;
+    }
+
+    size_t Length = (size_t)(parser->text - Start);
+    parser->text++;
+
+    char *String = malloc(Length + 1);
+    if (String == NULL)
+        exit(1);
+
+    memcpy(String, Start, Length);
+    String[Length] = '\0';
+    return String;
+}
+
+static double BC_ParseNumber(BC_Parser *parser)
+{
+    BC_SkipSpace(parser);
+
+    char *End;
+    double Number = strtod(parser->text, &End);
+    if (End == parser->text)
+        BC_Fail(parser, "expected a number");
+
+    parser->text = End;
+    return Number;
+}
+
+static void BC_SkipValue(BC_Parser *parser);
+
+static void BC_SkipContainer(BC_Parser *parser, char close, bool keys)
+{
+    if (BC_Accept(parser, close))
+        return;
+
+    do
+    {
+        if (keys)
+        {
+            free(BC_ParseString(parser));
+            BC_Expect(parser, ':');
+        }
+
+        BC_SkipValue(parser);
+    }
+    while (!parser->failed && BC_Accept(parser, ','));
+
+    BC_Expect(parser, close);
+}
+
+static void BC_SkipValue(BC_Parser *parser)
+{
+    BC_SkipSpace(parser);
+
+    if (BC_Accept(parser, '{'))
+        BC_SkipContainer(parser, '}', true);
+    else if (BC_Accept(parser, '['))
+        BC_SkipContainer(parser, ']', false);
+    else if (*parser->text == '"')
+        free(BC_ParseString(parser));
+    else if (strncmp(parser->text, "true", 4) == 0)
+        parser->text += 4;
+    else if (strncmp(parser->text, "false", 5) == 0)
+        parser->text += 5;
+    else if (strncmp(parser->text, "null", 4) == 0)
+        parser->text += 4;
+    else
+        BC_ParseNumber(parser);
+}
+
+static bool BC_ParseBool(BC_Parser *parser)
+{
+    BC_SkipSpace(parser);
+
+    if (strncmp(parser->text, "true", 4) == 0)
+    {
+        parser->text += 4;
+        return true;
+    }
+
+    if (strncmp(parser->text, "false", 5) == 0)
+    {
+        parser->text += 5;
+        return false;
+    }
+
+    BC_Fail(parser, "expected true or false");
+    return false;
+}
+
+static void BC_ParseSamples(BC_Parser *parser, BC_Benchmark *benchmark)
+{
+    uint32_t Capacity = 16;
+    benchmark->samples = malloc(Capacity * sizeof(double));
+    if (benchmark->samples == NULL)
+        exit(1);
+
+    BC_Expect(parser, '[');
+    if (parser->failed || BC_Accept(parser, ']'))
+        return;
+
+    do
+    {
+        if (benchmark->sampleAmount == Capacity)
+        {
+            Capacity *= 2;
+            benchmark->samples = realloc(benchmark->samples, Capacity * sizeof(double));
+            if (benchmark->samples == NULL)
+                exit(1);
+        }
+
+        benchmark->samples[benchmark->sampleAmount++] = BC_ParseNumber(parser);
+    }
+    while (!parser->failed && BC_Accept(parser, ','));
+
+    BC_Expect(parser, ']');
+}
+
+static void BC_ParseBenchmark(BC_Parser *parser, BC_Benchmark *benchmark)
+{
+    *benchmark = (BC_Benchmark){ NULL, NULL, 0 };
+
+    BC_Expect(parser, '{');
+    if (parser->failed || BC_Accept(parser, '}'))
+        return;
+
+    do
+    {
+        char *Key = BC_ParseString(parser);
+        BC_Expect(parser, ':');
+        if (parser->failed)
+        {
+            free(Key);
+            return;
+        }
+
+        if (strcmp(Key, "name") == 0 && benchmark->name == NULL)
+            benchmark->name = BC_ParseString(parser);
+        else if (strcmp(Key, "seconds") == 0 && benchmark->samples == NULL)
+            BC_ParseSamples(parser, benchmark);
+        else
+            BC_SkipValue(parser);
+
+        free(Key);
+    }
+    while (!parser->failed && BC_Accept(parser, ','));
+
+    BC_Expect(parser, '}');
+
+    if (!parser->failed && (benchmark->name == NULL || benchmark->sampleAmount == 0))
+        BC_Fail(parser, "a benchmark without a name or samples");
+}
+
+static void BC_ParseBenchmarks(BC_Parser *parser, BC_Results *results)
+{
+    uint32_t Capacity = 64;
+    results->benchmarks = malloc(Capacity * sizeof(BC_Benchmark));
+    if (results->benchmarks == NULL)
+        exit(1);
+
+    BC_Expect(parser, '[');
+    if (parser->failed || BC_Accept(parser, ']'))
+        return;
+
+    do
+    {
+        if (results->benchmarkAmount == Capacity)
+        {
+            Capacity *= 2;
+            results->benchmarks = realloc(results->benchmarks, Capacity * sizeof(BC_Benchmark));
+            if (results->benchmarks == NULL)
+                exit(1);
+        }
+
+        // Counted right away so a half parsed one still gets freed
+        BC_ParseBenchmark(parser, &results->benchmarks[results->benchmarkAmount++]);
+    }
+    while (!parser->failed && BC_Accept(parser, ','));
+
+    BC_Expect(parser, ']');
+}
+
+static void BC_FreeResults(BC_Results *results)
+{
+    for (uint32_t i = 0; i < results->benchmarkAmount; i++)
+    {
+        free(results->benchmarks[i].name);
+        free(results->benchmarks[i].samples);
+    }
+
+    free(results->benchmarks);
+    free(results->isa);
+}
+
+static bool BC_LoadResults(const char *fileName, BC_Results *results)
+{
+    *results = (BC_Results){ NULL, 0, 0.0, NULL, false, false };
+
+    FILE *File = fopen(fileName, "rb");
+    if (File == NULL)
+    {
+        fprintf(stderr, "Can't open %s\n", fileName);
+        return false;
+    }
+
+    fseek(File, 0, SEEK_END);
+    long Size = ftell(File);
+    fseek(File, 0, SEEK_SET);
+
+    char *Text = malloc(Size > 0 ? (size_t)Size + 1 : 1);
+    if (Text == NULL)
+        exit(1);
+
+    size_t Read = Size > 0 ? fread(Text, 1, (size_t)Size, File) : 0;
+    Text[Read] = '\0';
+    fclose(File);
+
+    BC_Parser Parser = { Text, fileName, false };
+    bool HasBenchmarks = false;
+
+    BC_Expect(&Parser, '{');
+    if (!Parser.failed && !BC_Accept(&Parser, '}'))
+    {
+        do
+        {
+            char *Key = BC_ParseString(&Parser);
+            BC_Expect(&Parser, ':');
+            if (Parser.failed)
+            {
+                free(Key);
+                break;
+            }
+
+            if (strcmp(Key, "benchmarks") == 0 && !HasBenchmarks)
+            {
+                BC_ParseBenchmarks(&Parser, results);
+                HasBenchmarks = true;
+            }
+            else if (strcmp(Key, "threads") == 0)
+                results->threads = BC_ParseNumber(&Parser);
+            else if (strcmp(Key, "isa") == 0 && results->isa == NULL)
+                results->isa = BC_ParseString(&Parser);
+            else if (strcmp(Key, "quick") == 0)
+                results->quick = BC_ParseBool(&Parser);
+            else if (strcmp(Key, "profiled") == 0)
+                results->profiled = BC_ParseBool(&Parser);
+            else
+                BC_SkipValue(&Parser);
+
+            free(Key);
+        }
+        while (!Parser.failed && BC_Accept(&Parser, ','));
+
+        BC_Expect(&Parser, '}');
+    }
+
+    if (!Parser.failed && !HasBenchmarks)
+        BC_Fail(&Parser, "there's no list of benchmarks");
+
+    free(Text);
+
+    if (Parser.failed)
+    {
+        BC_FreeResults(results);
+        return false;
+    }
+
+    return true;
+}
+
+// statistics
+
+static int BC_CompareDoubles(const void *a, const void *b)
+{
+    double A = *(const double *)a, B = *(const double *)b;
+    return (A > B) - (A < B);
+}
+
+// values gets sorted
+static double BC_Quantile(double *values, uint32_t amount, double quantile)
+{
+    qsort(values, amount, sizeof(double), BC_CompareDoubles);
+
+    double Position = quantile * (double)(amount - 1);
+    uint32_t Below = (uint32_t)Position;
+    if (Below + 1 >= amount)
+        return values[amount - 1];
+
+    return values[Below] + (Position - (double)Below) * (values[Below + 1] - values[Below]);
+}
+
+// xorshift64*, seeded the same every time so the same two files always give the same answer
+static uint64_t BC_Random(uint64_t *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1Dull;
+}
+
+static double BC_ResampledMedian(const BC_Benchmark *benchmark, double *scratch, uint64_t *state)
+{
+    for (uint32_t i = 0; i < benchmark->sampleAmount; i++)
+        scratch[i] = benchmark->samples[BC_Random(state) % benchmark->sampleAmount];
+
+    return BC_Quantile(scratch, benchmark->sampleAmount, 0.5);
+}
+
+// The ratio of the medians, current over baseline, and the interval it's in with the given confidence
+static void BC_CompareSamples(const BC_Benchmark *baseline, const BC_Benchmark *current, double confidence, double *ratio, double *low, double *high)
+{
+    uint32_t Largest = baseline->sampleAmount > current->sampleAmount ? baseline->sampleAmount : current->sampleAmount;
+    double *Scratch = malloc(Largest * sizeof(double));
+    double *Ratios = malloc(BC_BOOTSTRAP_ROUNDS * sizeof(double));
+    if (Scratch == NULL || Ratios == NULL)
+        exit(1);
+
+    memcpy(Scratch, baseline->samples, baseline->sampleAmount * sizeof(double));
+    double BaselineMedian = BC_Quantile(Scratch, baseline->sampleAmount, 0.5);
+    memcpy(Scratch, current->samples, current->sampleAmount * sizeof(double));
+    double CurrentMedian = BC_Quantile(Scratch, current->sampleAmount, 0.5);
+
+    *ratio = BaselineMedian > 0.0 ? CurrentMedian / BaselineMedian : 1.0;
+
+    uint64_t State = 0x9E3779B97F4A7C15ull;
+    for (uint32_t i = 0; i < BC_BOOTSTRAP_ROUNDS; i++)
+    {
+        double Baseline = BC_ResampledMedian(baseline, Scratch, &State);
+        double Current = BC_ResampledMedian(current, Scratch, &State);
+
+        Ratios[i] = Baseline > 0.0 ? Current / Baseline : 1.0;
+    }
+
+    *low = BC_Quantile(Ratios, BC_BOOTSTRAP_ROUNDS, (1.0 - confidence) / 2.0);
+    *high = BC_Quantile(Ratios, BC_BOOTSTRAP_ROUNDS, 1.0 - (1.0 - confidence) / 2.0);
+
+    free(Scratch);
+    free(Ratios);
+}
+
+static const BC_Benchmark *BC_FindBenchmark(const BC_Results *results, const char *name)
+{
+    for (uint32_t i = 0; i < results->benchmarkAmount; i++)
+        if (strcmp(results->benchmarks[i].name, name) == 0)
+            return &results->benchmarks[i];
+
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    const char *Files[2] = { NULL, NULL };
+    const char *Filter = NULL;
+    double Threshold = 5.0;
+    double Confidence = 0.95;
+    uint32_t FileAmount = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool HasValue = i + 1 < argc;
+
+        if (strcmp(argv[i], "--threshold") == 0 && HasValue)
+            Threshold = strtod(argv[++i], NULL);
+        else if (strcmp(argv[i], "--confidence") == 0 && HasValue)
+            Confidence = strtod(argv[++i], NULL);
+        else if (strcmp(argv[i], "--filter") == 0 && HasValue)
+            Filter = argv[++i];
+        else if (argv[i][0] != '-' && FileAmount < 2)
+            Files[FileAmount++] = argv[i];
+        else
+            FileAmount = 3;
+    }
+
+    if (FileAmount != 2 || Threshold < 0.0 || !(Confidence > 0.0 && Confidence < 1.0))
+    {
+        fputs("usage: swan_bench_compare baseline.json current.json [--threshold percent] [--confidence level] [--filter text]\n", stderr);
+        return 2;
+    }
+
+    BC_Results Baseline, Current;
+    if (!BC_LoadResults(Files[0], &Baseline))
+        return 2;
+
+    if (!BC_LoadResults(Files[1], &Current))
+    {
+        BC_FreeResults(&Baseline);
+        return 2;
+    }
+
+    bool SameIsa = Baseline.isa == NULL || Current.isa == NULL || strcmp(Baseline.isa, Current.isa) == 0; // Older results don't say which kernels they used
+
+    // Still compared, the numbers just don't say much
+    if (Baseline.threads != Current.threads || !SameIsa || Baseline.quick != Current.quick || Baseline.profiled != Current.profiled)
+        fputs("The two runs didn't use the same threads, kernels, --quick or SWAN_PROFILE, take the comparison with a grain of salt\n", stderr);
+
+    uint32_t Regressions = 0, Improvements = 0, Compared = 0;
+
+    printf("%-60s %12s %12s %9s %21s\n", "benchmark", "baseline us", "current us", "change", "interval");
+
+    for (uint32_t i = 0; i < Current.benchmarkAmount; i++)
+    {
+        const BC_Benchmark *New = &Current.benchmarks[i];
+        if (Filter != NULL && strstr(New->name, Filter) == NULL)
+            continue;
+
+        const BC_Benchmark *Old = BC_FindBenchmark(&Baseline, New->name);
+        if (Old == NULL)
+        {
+            printf("%-60s %12s\n", New->name, "new");
+            continue;
+        }
+
+        double Ratio, Low, High;
+        BC_CompareSamples(Old, New, Confidence, &Ratio, &Low, &High);
+        Compared++;
+
+        // The interval has to be past no change at all, and the median past the threshold
+        const char *Verdict = "";
+        if (Ratio > 1.0 + Threshold / 100.0 && Low > 1.0)
+        {
+            Verdict = "  REGRESSION";
+            Regressions++;
+        }
+        else if (Ratio < 1.0 - Threshold / 100.0 && High < 1.0)
+        {
+            Verdict = "  faster";
+            Improvements++;
+        }
+
+        double *Scratch = malloc((Old->sampleAmount + New->sampleAmount) * sizeof(double));
+        if (Scratch == NULL)
+            exit(1);
+
+        memcpy(Scratch, Old->samples, Old->sampleAmount * sizeof(double));
+        double OldMedian = BC_Quantile(Scratch, Old->sampleAmount, 0.5);
+        memcpy(Scratch, New->samples, New->sampleAmount * sizeof(double));
+        double NewMedian = BC_Quantile(Scratch, New->sampleAmount, 0.5);
+        free(Scratch);
+
+        printf("%-60s %12.3f %12.3f %+8.2f%% [%+8.2f%%, %+8.2f%%]%s\n", New->name, OldMedian * 1e6, NewMedian * 1e6,
+            (Ratio - 1.0) * 100.0, (Low - 1.0) * 100.0, (High - 1.0) * 100.0, Verdict);
+    }
+
+    for (uint32_t i = 0; i < Baseline.benchmarkAmount; i++)
+    {
+        const char *Name = Baseline.benchmarks[i].name;
+        if ((Filter == NULL || strstr(Name, Filter) != NULL) && BC_FindBenchmark(&Current, Name) == NULL)
+            printf("%-60s %12s\n", Name, "gone");
+    }
+
+    printf("\n%u compared, %u slower and %u faster by more than %.1f%% at %.0f%% confidence\n", Compared, Regressions, Improvements, Threshold, Confidence * 100.0);
+
+    BC_FreeResults(&Baseline);
+    BC_FreeResults(&Current);
+
+    return Regressions != 0 ? 1 : 0;
+}
@@ -0,0 +1,304 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "Swan.h"
+
+// Turns a saved network into one C file with nothing left to decide at runtime
+// Every size is a constant, the weights are static arrays and each layer gets its own loops, so the compiler can unroll and vectorize all of it
+// usage: swan-codegen <network file> <output.c> [function prefix]
+
+// Layers with fewer weights than this left after pruning get straight line code with only their nonzero weights
+#define CG_SPARSE_DENSITY 0.05f
+#define CG_MAX_SPARSE_WEIGHTS 65536
+
+// Hex floats, so the weights in the generated file are exactly the ones in the network
+static void CG_WriteFloats(FILE *file, const float *values, size_t amount)
+{
+    for (size_t i = 0; i < amount; i++)
+        fprintf(file, "%s%af,", i % 8 == 0 ? "\n    " : " ", values[i]);
+
+    fputs("\n", file);
+}
+
+static const char *CG_ActivationName(SW_ActivationFunction activationFunction)
+{
+    switch (activationFunction)
+    {
+    case SW_ACTIVATION_FUNCTION_RELU:
+        return "relu";
+
+    case SW_ACTIVATION_FUNCTION_SIGMOID:
+        return "sigmoid";
+
+    case SW_ACTIVATION_FUNCTION_TANH:
+        return "tanh";
+
+    // Softmax doesn't do anything yet in Swan either
+    default:
+        return "none";
+    }
+}
+
+// The same functions as SW_util.h, every layer calls the one it needs without a switch
+static void CG_WriteActivations(FILE *file, const char *prefix)
+{
+    fprintf(file, "static inline float %s_relu(float x) { return x > 0.0f ? x : 0.0f; }\n", prefix);
+    fprintf(file, "static inline float %s_sigmoid(float x) { return 1.0f / (1.0f + expf(-x)); }\n", prefix);
+    fprintf(file, "static inline float %s_tanh(float x) { return tanhf(x) * 0.5f + 0.5f; }\n", prefix);
+    fprintf(file, "static inline float %s_none(float x) { return x; }\n\n", prefix);
+}
+
+static size_t CG_NonzeroWeights(const SW_Layer *layer)
+{
+    size_t Amount = 0;
+
+    for (size_t i = 0; i < (size_t)layer->weightRows * layer->weightColumns; i++)
+        if (layer->weights[i] != 0.0f)
+            Amount++;
+
+    return Amount;
+}
+
+static int CG_IsSparse(const SW_Layer *layer)
+{
+    size_t Nonzero = CG_NonzeroWeights(layer);
+
+    return layer->type == SW_LAYER_TYPE_DENSE && Nonzero <= CG_MAX_SPARSE_WEIGHTS && Nonzero < CG_SPARSE_DENSITY * layer->weightRows * layer->weightColumns;
+}
+
+static void CG_WriteWeights(FILE *file, const char *prefix, const SW_Layer *layer, uint32_t layerIndex)
+{
+    if (layer->weights == NULL)
+        return;
+
+    fprintf(file, "static const float %s_Layer%uBiases[%u] __attribute__((aligned(64))) = {", prefix, layerIndex, layer->weightRows);
+    CG_WriteFloats(file, layer->biases, layer->weightRows);
+    fputs("};\n\n", file);
+
+    // Sparse layers have their weights in the code itself
+    if (CG_IsSparse(layer))
+        return;
+
+    if (layer->type == SW_LAYER_TYPE_DENSE)
+    {
+        // Transposed, so the inner loop goes over the outputs and vectorizes without having to reorder a sum
+        float *Transposed = malloc(sizeof(float) * layer->weightRows * layer->weightColumns);
+        if (Transposed == NULL)
+        {
+            fputs("Your network doesn't even fit in memory twice", stderr);
+            abort();
+        }
+
+        for (uint32_t r = 0; r < layer->weightRows; r++)
+            for (uint32_t c = 0; c < layer->weightColumns; c++)
+                Transposed[(size_t)c * layer->weightRows + r] = layer->weights[(size_t)r * layer->weightColumns + c];
+
+        fprintf(file, "static const float %s_Layer%uWeights[%zu] __attribute__((aligned(64))) = {", prefix, layerIndex, (size_t)layer->weightColumns * layer->weightRows);
+        CG_WriteFloats(file, Transposed, (size_t)layer->weightRows * layer->weightColumns);
+        fputs("};\n\n", file);
+
+        free(Transposed);
+        return;
+    }
+
+    fprintf(file, "static const float %s_Layer%uWeights[%zu] __attribute__((aligned(64))) = {", prefix, layerIndex, (size_t)layer->weightRows * layer->weightColumns);
+    CG_WriteFloats(file, layer->weights, (size_t)layer->weightRows * layer->weightColumns);
+    fputs("};\n\n", file);
+}
+
+static void CG_WriteDense(FILE *file, const char *prefix, const SW_Layer *layer, uint32_t layerIndex, const char *input, const char *output)
+{
+    const char *Activation = CG_ActivationName(layer->activationFunction);
+    uint32_t Outputs = layer->weightRows, Inputs = layer->weightColumns;
+
+    fprintf(file, "    // Layer %u, dense %u -> %u, %s\n", layerIndex, Inputs, Outputs, Activation);
+
+    if (CG_IsSparse(layer))
+    {
+        for (uint32_t r = 0; r < Outputs; r++)
+        {
+            fprintf(file, "    %s[%u] = %s_%s(%s_Layer%uBiases[%u]", output, r, prefix, Activation, prefix, layerIndex, r);
+
+            for (uint32_t c = 0; c < Inputs; c++)
+            {
+                float Weight = layer->weights[(size_t)r * Inputs + c];
+                if (Weight != 0.0f)
+                    fprintf(file, " + %af * %s[%u]", Weight, input, c);
+            }
+
+            fputs(");\n", file);
+        }
+
+        fputs("\n", file);
+        return;
+    }
+
+    fprintf(file, "    for (int o = 0; o < %u; o++)\n        %s[o] = %s_Layer%uBiases[o];\n", Outputs, output, prefix, layerIndex);
+    fprintf(file, "    for (int i = 0; i < %u; i++)\n    {\n        const float x = %s[i];\n", Inputs, input);
+    fprintf(file, "        for (int o = 0; o < %u; o++)\n            %s[o] += %s_Layer%uWeights[i * %u + o] * x;\n    }\n", Outputs, output, prefix, layerIndex, Outputs);
+    fprintf(file, "    for (int o = 0; o < %u; o++)\n        %s[o] = %s_%s(%s[o]);\n\n", Outputs, output, prefix, Activation, output);
+}
+
+static void CG_WriteConvolution(FILE *file, const char *prefix, const SW_Layer *layer, uint32_t layerIndex, const char *input, const char *output)
+{
+    const SW_Convolution *Convolution = layer->convolution;
+    const char *Activation = CG_ActivationName(layer->activationFunction);
+    uint32_t Kernel = Convolution->kernelSize;
+
+    fprintf(file, "    // Layer %u, %ux%u convolution %ux%ux%u -> %ux%ux%u, stride %u, padding %u, %s\n", layerIndex, Kernel, Kernel,
+        Convolution->inputChannels, Convolution->inputHeight, Convolution->inputWidth, layer->channels, layer->height, layer->width, Convolution->stride, Convolution->padding, Activation);
+
+    uint32_t PaddedHeight = Convolution->inputHeight + 2 * Convolution->padding;
+    uint32_t PaddedWidth = Convolution->inputWidth + 2 * Convolution->padding;
+    const char *Source = input;
+
+    // The padding written out, so the loops below don't have a single bounds check left
+    if (Convolution->padding != 0)
+    {
+        fprintf(file, "    {\n        static _Thread_local float Padded[%u] __attribute__((aligned(64)));\n\n", Convolution->inputChannels * PaddedHeight * PaddedWidth);
+        fprintf(file, "        for (int c = 0; c < %u; c++)\n", Convolution->inputChannels);
+        fprintf(file, "            for (int y = 0; y < %u; y++)\n", Convolution->inputHeight);
+        fprintf(file, "                for (int x = 0; x < %u; x++)\n", Convolution->inputWidth);
+        fprintf(file, "                    Padded[(c * %u + y + %u) * %u + x + %u] = %s[(c * %u + y) * %u + x];\n\n", PaddedHeight, Convolution->padding, PaddedWidth, Convolution->padding, input, Convolution->inputHeight, Convolution->inputWidth);
+        Source = "Padded";
+    }
+    else
+        fputs("    {\n", file);
+
+    // One weight at a time over a whole output plane, the inner loop goes along a row and vectorizes
+    fprintf(file, "        for (int oc = 0; oc < %u; oc++)\n        {\n", layer->channels);
+    fprintf(file, "            float *Plane = &%s[oc * %u];\n\n", output, layer->height * layer->width);
+    fprintf(file, "            for (int p = 0; p < %u; p++)\n                Plane[p] = %s_Layer%uBiases[oc];\n\n", layer->height * layer->width, prefix, layerIndex);
+    fprintf(file, "            for (int ic = 0; ic < %u; ic++)\n", Convolution->inputChannels);
+    fprintf(file, "                for (int ky = 0; ky < %u; ky++)\n", Kernel);
+    fprintf(file, "                    for (int kx = 0; kx < %u; kx++)\n                    {\n", Kernel);
+    fprintf(file, "                        const float w = %s_Layer%uWeights[((oc * %u + ic) * %u + ky) * %u + kx];\n", prefix, layerIndex, Convolution->inputChannels, Kernel, Kernel);
+    fprintf(file, "                        const float *Window = &%s[(ic * %u + ky) * %u + kx];\n\n", Source, PaddedHeight, PaddedWidth);
+    fprintf(file, "                        for (int oy = 0; oy < %u; oy++)\n", layer->height);
+    fprintf(file, "                            for (int ox = 0; ox < %u; ox++)\n", layer->width);
+    fprintf(file, "                                Plane[oy * %u + ox] += w * Window[oy * %u + ox * %u];\n                    }\n\n", layer->width, Convolution->stride * PaddedWidth, Convolution->stride);
+    fprintf(file, "            for (int p = 0; p < %u; p++)\n                Plane[p] = %s_%s(Plane[p]);\n        }\n    }\n\n", layer->height * layer->width, prefix, Activation);
+}
+
+static void CG_WritePooling(FILE *file, const SW_Layer *layer, uint32_t layerIndex, const char *input, const char *output)
+{
+    const SW_Pooling *Pooling = layer->pooling;
+    uint32_t InputPixels = Pooling->inputHeight * Pooling->inputWidth;
+
+    if (Pooling->type == SW_POOLING_TYPE_GLOBAL_AVERAGE)
+    {
+        fprintf(file, "    // Layer %u, global average pooling %ux%ux%u\n", layerIndex, Pooling->inputChannels, Pooling->inputHeight, Pooling->inputWidth);
+        fprintf(file, "    for (int c = 0; c < %u; c++)\n    {\n        float Sum = 0.0f;\n", layer->channels);
+        fprintf(file, "        for (int p = 0; p < %u; p++)\n            Sum += %s[c * %u + p];\n", InputPixels, input, InputPixels);
+        fprintf(file, "        %s[c] = Sum / %u;\n    }\n\n", output, InputPixels);
+        return;
+    }
+
+    int Max = Pooling->type == SW_POOLING_TYPE_MAX;
+
+    fprintf(file, "    // Layer %u, %ux%u %s pooling with stride %u\n", layerIndex, Pooling->size, Pooling->size, Max ? "max" : "average", Pooling->stride);
+    fprintf(file, "    for (int c = 0; c < %u; c++)\n", layer->channels);
+    fprintf(file, "        for (int oy = 0; oy < %u; oy++)\n", layer->height);
+    fprintf(file, "            for (int ox = 0; ox < %u; ox++)\n            {\n", layer->width);
+    fprintf(file, "                const float *Window = &%s[(c * %u + oy * %u) * %u + ox * %u];\n", input, Pooling->inputHeight, Pooling->stride, Pooling->inputWidth, Pooling->stride);
+    fprintf(file, "                float Result = %s;\n", Max ? "Window[0]" : "0.0f");
+    fprintf(file, "                for (int ky = 0; ky < %u; ky++)\n", Pooling->size);
+    fprintf(file, "                    for (int kx = 0; kx < %u; kx++)\n", Pooling->size);
+
+    if (Max)
+        fprintf(file, "                        Result = Window[ky * %u + kx] > Result ? Window[ky * %u + kx] : Result;\n", Pooling->inputWidth, Pooling->inputWidth);
+    else
+        fprintf(file, "                        Result += Window[ky * %u + kx];\n", Pooling->inputWidth);
+
+    if (Max)
+        fprintf(file, "                %s[(c * %u + oy) * %u + ox] = Result;\n            }\n\n", output, layer->height, layer->width);
+    else
+        fprintf(file, "                %s[(c * %u + oy) * %u + ox] = Result / %u;\n            }\n\n", output, layer->height, layer->width, Pooling->size * Pooling->size);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        fputs("usage: swan-codegen <network file> <output.c> [function prefix]\n", stderr);
+        return 1;
+    }
+
+    const char *Prefix = argc > 3 ? argv[3] : "swan_network";
+
+    SW_Network Network;
+    SW_InitNetwork(&Network);
+    SW_LoadNetwork(&Network, argv[1]);
+
+    if (Network.layerAmount < 2)
+    {
+        fputs("That file doesn't have a network worth generating code for\n", stderr);
+        SW_UnloadNetwork(&Network);
+        return 1;
+    }
+
+    FILE *File = fopen(argv[2], "w");
+    if (File == NULL)
+    {
+        fputs("Can't write the generated code there\n", stderr);
+        SW_UnloadNetwork(&Network);
+        return 1;
+    }
+
+    uint32_t LayerAmount = Network.layerAmount;
+    uint32_t InputAmount = Network.layers[0].neuronAmount;
+    uint32_t OutputAmount = Network.layers[LayerAmount - 1].neuronAmount;
+
+    // The layers in between take turns on two buffers, like SW_ExecuteNetworkBatch does
+    uint32_t BufferSizes[2] = { 1, 1 };
+    for (uint32_t i = 1; i + 1 < LayerAmount; i++)
+        if (Network.layers[i].neuronAmount > BufferSizes[(i + 1) % 2])
+            BufferSizes[(i + 1) % 2] = Network.layers[i].neuronAmount;
+
+    fprintf(File, "// Generated by swan-codegen from %s, regenerate it instead of editing it\n", argv[1]);
+    fprintf(File, "// void %s_execute(const float *input, float *output);\n", Prefix);
+    fprintf(File, "// input has %u floats and output gets %u, build with something like -O3 -march=native\n\n", InputAmount, OutputAmount);
+    fputs("#include <math.h>\n\n", File);
+    fprintf(File, "#define %s_INPUT_AMOUNT %u\n#define %s_OUTPUT_AMOUNT %u\n\n", Prefix, InputAmount, Prefix, OutputAmount);
+
+    CG_WriteActivations(File, Prefix);
+
+    for (uint32_t i = 1; i < LayerAmount; i++)
+        CG_WriteWeights(File, Prefix, &Network.layers[i], i);
+
+    fprintf(File, "void %s_execute(const float *restrict input, float *restrict output)\n{\n", Prefix);
+    fprintf(File, "    float Buffer0[%u] __attribute__((aligned(64)));\n", BufferSizes[0]);
+    fprintf(File, "    float Buffer1[%u] __attribute__((aligned(64)));\n\n", BufferSizes[1]);
+    fputs("    (void)Buffer0;\n    (void)Buffer1;\n\n", File);
+
+    for (uint32_t i = 1; i < LayerAmount; i++)
+    {
+        SW_Layer *CurrentLayer = &Network.layers[i];
+        const char *Input = i == 1 ? "input" : (i % 2 == 1 ? "Buffer1" : "Buffer0");
+        const char *Output = i + 1 == LayerAmount ? "output" : ((i + 1) % 2 == 0 ? "Buffer0" : "Buffer1");
+
+        switch (CurrentLayer->type)
+        {
+        case SW_LAYER_TYPE_CONVOLUTION:
+            CG_WriteConvolution(File, Prefix, CurrentLayer, i, Input, Output);
+            break;
+
+        case SW_LAYER_TYPE_POOLING:
+            CG_WritePooling(File, CurrentLayer, i, Input, Output);
+            break;
+
+        default:
+            CG_WriteDense(File, Prefix, CurrentLayer, i, Input, Output);
+            break;
+        }
+    }
+
+    fputs("}\n", File);
+    fclose(File);
+
+    SW_UnloadNetwork(&Network);
+
+    return 0;
+}
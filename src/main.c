@@ -106,15 +106,21 @@ int main(void)
         CorrectOutput[i][MNISTLabels[i]] = 1.0f;
     }
 
+    // Saved in the background every 50 batches while training, a crash only loses what came after the last one
+    SW_StartAutosave(&network, "savednetwork", 50);
+
     // A testing loop that shows the loss every so often
     printf("Loss: %.20f\n", SW_CalculateLoss(&network, SW_LOSS_FUNCTION_MEAN_SQUARED_ERROR, ImageData[TestImageID], CorrectOutput[TestImageID]));
 
-    for (uint32_t i = 0; i < 5000; i++)
+    // Every call is one pass over all the images
+    // The 0.001 is the loss a batch has to get below for the pass to stop early, not the learning rate, that stays 0.2 per averaged batch
+    // A sigmoid output that learned to say 0 everywhere already has a loss of 0.1 per sample, stopping there would stop before it learns anything
+    for (uint32_t i = 0; i < 10; i++)
     {
-        SW_TrainNeuralNetwork(&network, ImageData, CorrectOutput, 6000, 1, 0.1f, SW_LOSS_FUNCTION_MEAN_SQUARED_ERROR);
+        float Loss = SW_TrainNeuralNetwork(&network, ImageData, CorrectOutput, 6000, 32, 0.001f, SW_LOSS_FUNCTION_MEAN_SQUARED_ERROR);
 
-        if (i % 100 == 0)
-            printf("Loss: %.20f\n", SW_CalculateLoss(&network, SW_LOSS_FUNCTION_MEAN_SQUARED_ERROR, ImageData[TestImageID], CorrectOutput[TestImageID]));
+        printf("Epoch %u, average loss: %.20f\n", i, Loss);
+        printf("Loss: %.20f\n", SW_CalculateLoss(&network, SW_LOSS_FUNCTION_MEAN_SQUARED_ERROR, ImageData[TestImageID], CorrectOutput[TestImageID]));
     }
 
     // Find which neuron was the strongest on the last layer
@@ -135,7 +141,9 @@ int main(void)
 
     printf("\nOutput value: %u\n", LargestWeightValue);
 
-    SW_SaveNetwork(&network, "savednetwork");
+    // The final weights, unloading waits for them to be written
+    SW_WaitForAutosave(&network);
+    SW_AutosaveNow(&network);
 
     SW_UnloadNetwork(&network);
 
@@ -0,0 +1,328 @@
+#define _GNU_SOURCE
+
+#include "ring.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SV_PAUSE() _mm_pause()
+#else
+#define SV_PAUSE() ((void)0)
+#endif
+
+// A waiting client looks at closed this often, in case the server shut down just as it went to sleep
+#define SV_RING_CLOSED_CHECK 100000000
+
+// How often either side checks before going to sleep, a few tens of microseconds, about what a futex wake up costs
+// On a single CPU the other side can't make progress while this one spins, then nobody spins
+#define SV_RING_SPIN_COUNT 2000
+
+static uint32_t SV_RingSpinCount(void)
+{
+    return sysconf(_SC_NPROCESSORS_ONLN) > 1 ? SV_RING_SPIN_COUNT : 0;
+}
+
+// The futexes are shared between processes, so no FUTEX_PRIVATE_FLAG
+static void SV_FutexWait(_Atomic uint32_t *address, uint32_t value, const struct timespec *timeout)
+{
+    syscall(SYS_futex, (uint32_t *)address, FUTEX_WAIT, value, timeout, NULL, 0);
+}
+
+static void SV_FutexWake(_Atomic uint32_t *address, int amount)
+{
+    syscall(SYS_futex, (uint32_t *)address, FUTEX_WAKE, amount, NULL, NULL, 0);
+}
+
+static size_t SV_RoundUp(size_t size, size_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+uint64_t SV_Clock(void)
+{
+    struct timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+
+    return (uint64_t)Time.tv_sec * 1000000000u + (uint64_t)Time.tv_nsec;
+}
+
+// server
+
+bool SV_CreateRing(SV_Ring *ring, const char *name, uint32_t inputAmount, uint32_t outputAmount, uint32_t slotAmount)
+{
+    memset(ring, 0, sizeof(SV_Ring));
+
+    if (strlen(name) >= sizeof(ring->name))
+    {
+        fputs("That ring name is longer than anyone needs\n", stderr);
+        return false;
+    }
+
+    // Rows start on their own cache lines, a client writing one slot doesn't slow down the server reading the next
+    size_t InputOffset = SV_RoundUp(sizeof(SV_RingHeader) + sizeof(SV_RingSlot) * slotAmount, 64);
+    size_t OutputOffset = SV_RoundUp(InputOffset + sizeof(float) * inputAmount * slotAmount, 64);
+    size_t Size = SV_RoundUp(OutputOffset + sizeof(float) * outputAmount * slotAmount, (size_t)sysconf(_SC_PAGESIZE));
+
+    // Clients still holding the old one keep it until they close it, they just won't get answers
+    shm_unlink(name);
+
+    int File = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0660);
+    if (File < 0)
+    {
+        perror("swan_serve: shm_open");
+        return false;
+    }
+
+    if (ftruncate(File, (off_t)Size) < 0)
+    {
+        perror("swan_serve: ftruncate");
+        close(File);
+        shm_unlink(name);
+        return false;
+    }
+
+    void *Memory = mmap(NULL, Size, PROT_READ | PROT_WRITE, MAP_SHARED, File, 0);
+    close(File);
+
+    if (Memory == MAP_FAILED)
+    {
+        perror("swan_serve: mmap");
+        shm_unlink(name);
+        return false;
+    }
+
+    // ftruncate zeroed it, every slot starts out free
+    SV_RingHeader *Header = Memory;
+    Header->inputAmount = inputAmount;
+    Header->outputAmount = outputAmount;
+    Header->slotAmount = slotAmount;
+    Header->inputOffset = InputOffset;
+    Header->outputOffset = OutputOffset;
+    Header->version = SV_RING_VERSION;
+
+    // Last, clients opening it before this don't look any further
+    atomic_thread_fence(memory_order_release);
+    Header->magic = SV_RING_MAGIC;
+
+    ring->header = Header;
+    ring->size = Size;
+    ring->owner = true;
+    ring->spinCount = SV_RingSpinCount();
+    strcpy(ring->name, name);
+
+    return true;
+}
+
+void SV_ShutdownRing(SV_Ring *ring)
+{
+    SV_RingHeader *Header = ring->header;
+
+    atomic_store(&Header->closed, 1);
+
+    // The server thread might be about to sleep on the doorbell it saw last
+    atomic_fetch_add(&Header->doorbell, 1);
+
+    // The clients check closed before they sleep, on every wake up, and every SV_RING_CLOSED_CHECK in between
+    for (uint32_t i = 0; i < Header->slotAmount; i++)
+        SV_FutexWake(&Header->slots[i].state, INT_MAX);
+    SV_FutexWake(&Header->doorbell, INT_MAX);
+}
+
+uint32_t SV_TakeReadySlots(SV_Ring *ring, uint32_t start, uint32_t *slots, uint32_t amount)
+{
+    SV_RingHeader *Header = ring->header;
+    uint32_t Taken = 0;
+
+    for (uint32_t i = 0; i < Header->slotAmount && Taken < amount; i++)
+    {
+        uint32_t Slot = (start + i) % Header->slotAmount;
+
+        // Only the server moves a slot on from ready, no compare exchange needed
+        if (atomic_load_explicit(&Header->slots[Slot].state, memory_order_acquire) != SV_RING_SLOT_READY)
+            continue;
+
+        atomic_store_explicit(&Header->slots[Slot].state, SV_RING_SLOT_RUNNING, memory_order_relaxed);
+        slots[Taken++] = Slot;
+    }
+
+    return Taken;
+}
+
+void SV_FinishRingSlot(SV_Ring *ring, uint32_t slot)
+{
+    SV_RingSlot *Slot = &ring->header->slots[slot];
+
+    // The client says it waits before it checks the state, and this checks for waiting after setting the state, so one of the two sees the other
+    atomic_store(&Slot->state, SV_RING_SLOT_DONE);
+
+    if (atomic_load(&Slot->waiting) != 0)
+        SV_FutexWake(&Slot->state, INT_MAX);
+}
+
+void SV_WaitForRingDoorbell(SV_Ring *ring, uint32_t seen, uint64_t timeout)
+{
+    SV_RingHeader *Header = ring->header;
+
+    for (uint32_t i = 0; i < ring->spinCount; i++)
+    {
+        if (atomic_load(&Header->doorbell) != seen)
+            return;
+
+        SV_PAUSE();
+    }
+
+    struct timespec Timeout = { (time_t)(timeout / 1000000000u), (long)(timeout % 1000000000u) };
+
+    atomic_store(&Header->serverWaiting, 1);
+
+    if (atomic_load(&Header->doorbell) == seen && !atomic_load(&Header->closed))
+        SV_FutexWait(&Header->doorbell, seen, timeout == UINT64_MAX ? NULL : &Timeout);
+
+    atomic_store(&Header->serverWaiting, 0);
+}
+
+// client
+
+bool SV_OpenRing(SV_Ring *ring, const char *name)
+{
+    memset(ring, 0, sizeof(SV_Ring));
+
+    int File = shm_open(name, O_RDWR | O_CLOEXEC, 0);
+    if (File < 0)
+        return false;
+
+    struct stat Stat;
+    if (fstat(File, &Stat) < 0 || (size_t)Stat.st_size < sizeof(SV_RingHeader))
+    {
+        close(File);
+        return false;
+    }
+
+    void *Memory = mmap(NULL, (size_t)Stat.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, File, 0);
+    close(File);
+
+    if (Memory == MAP_FAILED)
+        return false;
+
+    SV_RingHeader *Header = Memory;
+    bool Valid = Header->magic == SV_RING_MAGIC && Header->version == SV_RING_VERSION;
+    atomic_thread_fence(memory_order_acquire);
+
+    // A ring from a different build, or one that's still being made
+    if (!Valid || Header->outputOffset + sizeof(float) * Header->outputAmount * Header->slotAmount > (size_t)Stat.st_size)
+    {
+        munmap(Memory, (size_t)Stat.st_size);
+        return false;
+    }
+
+    ring->header = Header;
+    ring->size = (size_t)Stat.st_size;
+    ring->spinCount = SV_RingSpinCount();
+
+    return true;
+}
+
+int64_t SV_AcquireRingSlot(SV_Ring *ring)
+{
+    SV_RingHeader *Header = ring->header;
+
+    for (;;)
+    {
+        uint32_t Start = atomic_fetch_add_explicit(&Header->nextSlot, 1, memory_order_relaxed);
+
+        for (uint32_t i = 0; i < Header->slotAmount; i++)
+        {
+            uint32_t Slot = (Start + i) % Header->slotAmount;
+            uint32_t Free = SV_RING_SLOT_FREE;
+
+            if (atomic_compare_exchange_strong(&Header->slots[Slot].state, &Free, SV_RING_SLOT_WRITING))
+                return Slot;
+        }
+
+        if (atomic_load(&Header->closed))
+            return -1;
+
+        // Every slot is busy, more clients than the server was started for
+        sched_yield();
+    }
+}
+
+void SV_SubmitRingSlot(SV_Ring *ring, uint32_t slot)
+{
+    SV_RingHeader *Header = ring->header;
+
+    Header->slots[slot].submitted = SV_Clock();
+    atomic_store(&Header->slots[slot].state, SV_RING_SLOT_READY);
+
+    // Same as SV_FinishRingSlot the other way around, the server says it waits before checking the doorbell
+    atomic_fetch_add(&Header->doorbell, 1);
+
+    if (atomic_load(&Header->serverWaiting) != 0)
+        SV_FutexWake(&Header->doorbell, 1);
+}
+
+bool SV_WaitRingSlot(SV_Ring *ring, uint32_t slot)
+{
+    SV_RingHeader *Header = ring->header;
+    SV_RingSlot *Slot = &Header->slots[slot];
+
+    for (uint32_t i = 0; i < ring->spinCount; i++)
+    {
+        if (atomic_load_explicit(&Slot->state, memory_order_acquire) == SV_RING_SLOT_DONE)
+            return true;
+
+        SV_PAUSE();
+    }
+
+    struct timespec Timeout = { 0, SV_RING_CLOSED_CHECK };
+    bool Done;
+
+    for (;;)
+    {
+        atomic_store(&Slot->waiting, 1);
+
+        uint32_t State = atomic_load(&Slot->state);
+        Done = State == SV_RING_SLOT_DONE;
+
+        if (Done || atomic_load(&Header->closed))
+            break;
+
+        SV_FutexWait(&Slot->state, State, &Timeout);
+    }
+
+    atomic_store(&Slot->waiting, 0);
+
+    return Done;
+}
+
+void SV_ReleaseRingSlot(SV_Ring *ring, uint32_t slot)
+{
+    atomic_store_explicit(&ring->header->slots[slot].state, SV_RING_SLOT_FREE, memory_order_release);
+}
+
+// both
+
+void SV_CloseRing(SV_Ring *ring)
+{
+    if (ring->header == NULL)
+        return;
+
+    munmap(ring->header, ring->size);
+
+    if (ring->owner)
+        shm_unlink(ring->name);
+
+    memset(ring, 0, sizeof(SV_Ring));
+}
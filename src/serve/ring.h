@@ -0,0 +1,98 @@
+#ifndef SV_RING_H
+#define SV_RING_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A shared memory ring of request slots between swan_serve and clients on the same machine, see swan_serve --shm
+//
+// A client takes a free slot, writes its input straight into SV_RingInput, submits it and waits,
+// the server runs it in a batch with whatever else is ready and writes the output straight into SV_RingOutput
+// The inputs and outputs of all slots are one array each, so slots that are next to each other run without being copied at all
+// Waiting spins a little and then sleeps on a futex, wakeups only cost a system call when the other side actually sleeps
+//
+// Any amount of clients, in any amount of processes, can share one ring, a slot belongs to one of them from SV_AcquireRingSlot to SV_ReleaseRingSlot
+// A client that dies in between loses that slot until the server makes a new ring
+
+#define SV_RING_MAGIC 0x474E4952 // "RING"
+#define SV_RING_VERSION 1
+
+typedef enum SV_RingSlotState
+{
+    SV_RING_SLOT_FREE = 0,
+    SV_RING_SLOT_WRITING,   // A client owns it and is writing its input
+    SV_RING_SLOT_READY,     // Submitted, waiting for a batch
+    SV_RING_SLOT_RUNNING,   // In a batch on the server
+    SV_RING_SLOT_DONE       // The output is there, the client still owns it until it releases it
+} SV_RingSlotState;
+
+typedef struct SV_RingSlot
+{
+    _Alignas(64) _Atomic uint32_t state;    // An SV_RingSlotState, the client sleeps on it while waiting
+    _Atomic uint32_t waiting;               // The client sleeps, the server has to wake it
+    uint64_t submitted;                     // CLOCK_MONOTONIC nanoseconds, for the batching delay and the latency
+} SV_RingSlot;
+
+typedef struct SV_RingHeader
+{
+    uint32_t magic, version;
+    uint32_t inputAmount, outputAmount;     // In floats, per slot
+    uint32_t slotAmount;
+    uint64_t inputOffset, outputOffset;     // Bytes from the start of the ring to the input and output arrays
+
+    _Alignas(64) _Atomic uint32_t doorbell; // Goes up on every submit, the server sleeps on it
+    _Atomic uint32_t serverWaiting;
+    _Atomic uint32_t closed;                // The server is gone, nothing submitted gets done anymore
+
+    _Alignas(64) _Atomic uint32_t nextSlot; // Where clients start looking for a free slot, so they don't all fight over the first one
+
+    SV_RingSlot slots[];
+} SV_RingHeader;
+
+typedef struct SV_Ring
+{
+    SV_RingHeader *header;
+    size_t size;
+    char name[256];
+    bool owner;                             // Made with SV_CreateRing, closing it removes the name
+    uint32_t spinCount;
+} SV_Ring;
+
+// server
+
+bool SV_CreateRing(SV_Ring *ring, const char *name, uint32_t inputAmount, uint32_t outputAmount, uint32_t slotAmount); // name like "/swan", replaces a ring left behind with that name
+void SV_ShutdownRing(SV_Ring *ring);    // Marks it closed and wakes every client, so nobody waits for a server that's gone
+
+// The slots that are ready, from start on and wrapping around, up to amount of them, marks them running and returns how many there are
+uint32_t SV_TakeReadySlots(SV_Ring *ring, uint32_t start, uint32_t *slots, uint32_t amount);
+void SV_FinishRingSlot(SV_Ring *ring, uint32_t slot);
+
+// Sleeps until something gets submitted after the doorbell was seen, or timeout nanoseconds go by (UINT64_MAX for no timeout)
+void SV_WaitForRingDoorbell(SV_Ring *ring, uint32_t seen, uint64_t timeout);
+
+// client
+
+bool SV_OpenRing(SV_Ring *ring, const char *name);
+int64_t SV_AcquireRingSlot(SV_Ring *ring);                  // Waits for a free slot, -1 once the server is gone
+void SV_SubmitRingSlot(SV_Ring *ring, uint32_t slot);
+bool SV_WaitRingSlot(SV_Ring *ring, uint32_t slot);         // Waits for the output, false if the server shut down first
+void SV_ReleaseRingSlot(SV_Ring *ring, uint32_t slot);
+
+// both
+
+void SV_CloseRing(SV_Ring *ring);
+uint64_t SV_Clock(void);                                    // CLOCK_MONOTONIC in nanoseconds, what submitted is in
+
+static inline float *SV_RingInput(SV_Ring *ring, uint32_t slot)
+{
+    return (float *)((char *)ring->header + ring->header->inputOffset) + (size_t)slot * ring->header->inputAmount;
+}
+
+static inline float *SV_RingOutput(SV_Ring *ring, uint32_t slot)
+{
+    return (float *)((char *)ring->header + ring->header->outputOffset) + (size_t)slot * ring->header->outputAmount;
+}
+
+#endif // SV_RING_H
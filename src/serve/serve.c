@@ -0,0 +1,731 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "Swan.h"
+#include "ring.h"
+
+// Serves a network over a Unix socket, requests that arrive close together get executed as one batch
+// usage: swan_serve <network file> <socket path> [--max-batch n] [--max-delay microseconds] [--stats seconds] [--shm name]
+//
+// The protocol is native endian, it's for processes on the same machine:
+// - right after connecting the server sends three uint32s, SV_MAGIC, the input size and the output size (in floats)
+// - every request is input size floats, every answer output size floats, answers come in the order of the requests
+// - a client can send as many requests as it wants without waiting for the answers, it has to read them at some point though
+//
+// With --shm clients can skip the socket and use a shared memory ring instead, see ring.h, it gets batched the same way on a thread of its own
+//
+// The sockets are served by one thread around ppoll, the batches themselves run on the thread pool like any other SW_ExecuteNetworkBatch
+
+#define SV_MAGIC 0x4E415753 // "SWAN", like the network files
+
+// Requests that can wait for a batch, the server stops reading from clients while this many are queued
+#define SV_QUEUE_BATCHES 8
+
+// Latencies kept for the percentiles, the oldest ones get overwritten
+#define SV_LATENCY_AMOUNT 65536
+
+#define SV_MAX_CONNECTIONS 1024
+
+typedef struct SV_Connection
+{
+    int socket;
+
+    uint8_t *request;               // The request being read, one request big
+    size_t requestFill;
+
+    uint8_t *answers;               // Answers not yet sent, with their hello first
+    size_t answerSize, answerSent, answerCapacity;
+
+    uint32_t pending;               // Queued requests without an answer yet
+    bool readDone;                  // The client won't send more, or it's gone
+    bool broken;                    // Writing failed, the answers get dropped
+} SV_Connection;
+
+typedef struct SV_Request
+{
+    SV_Connection *connection;
+    uint64_t arrival;
+} SV_Request;
+
+typedef struct SV_Stats
+{
+    uint64_t requests, batches;
+    uint64_t *batchSizes;           // How many batches had each size, maxBatch + 1 of them
+    uint64_t executeNanoseconds;
+
+    uint32_t *latencies;            // Microseconds from having the whole request to having its answer
+    uint64_t latencyAmount;         // Ever recorded, the ring has the last SV_LATENCY_AMOUNT
+} SV_Stats;
+
+typedef struct SV_Server
+{
+    SW_Network network;
+    uint32_t inputAmount, outputAmount;
+
+    uint32_t maxBatch;
+    uint64_t maxDelay;              // Nanoseconds the first request of a batch waits for others at most
+
+    // The queue is a ring of requests with an input row each
+    SV_Request *queue;
+    float *queueInputs;
+    uint32_t queueCapacity, queueHead, queueAmount;
+
+    float *batchInput, *batchOutput;
+    uint64_t *batchArrivals;
+
+    pthread_mutex_t lock;           // One batch at a time, both of them share the workspace and the stats
+    void *workspace;
+    size_t workspaceSize;
+
+    SV_Ring ring;                   // header is NULL without --shm
+    pthread_t ringThread;
+    float *ringInput, *ringOutput;  // For batches whose slots aren't next to each other
+
+    SV_Connection *connections[SV_MAX_CONNECTIONS];
+    uint32_t connectionAmount;
+
+    SV_Stats stats;
+} SV_Server;
+
+static volatile sig_atomic_t SV_stop = 0;
+
+static void SV_Stop(int signal)
+{
+    (void)signal;
+    SV_stop = 1;
+}
+
+static void *SV_Allocate(size_t size)
+{
+    void *Memory = malloc(size != 0 ? size : 1);
+    if (Memory == NULL)
+    {
+        fputs("The server ran out of memory, send smaller networks\n", stderr);
+        exit(1);
+    }
+
+    return Memory;
+}
+
+// stats
+
+static int SV_CompareLatencies(const void *a, const void *b)
+{
+    uint32_t A = *(const uint32_t *)a, B = *(const uint32_t *)b;
+    return (A > B) - (A < B);
+}
+
+static void SV_PrintStats(SV_Server *server)
+{
+    SV_Stats *Stats = &server->stats;
+
+    pthread_mutex_lock(&server->lock);
+
+    if (Stats->batches == 0)
+    {
+        pthread_mutex_unlock(&server->lock);
+        fputs("swan_serve: no requests yet\n", stderr);
+        return;
+    }
+
+    size_t Amount = Stats->latencyAmount < SV_LATENCY_AMOUNT ? (size_t)Stats->latencyAmount : SV_LATENCY_AMOUNT;
+    uint32_t *Sorted = SV_Allocate(Amount * sizeof(uint32_t));
+    memcpy(Sorted, Stats->latencies, Amount * sizeof(uint32_t));
+    qsort(Sorted, Amount, sizeof(uint32_t), SV_CompareLatencies);
+
+    double MeanBatch = (double)Stats->requests / Stats->batches;
+
+    fprintf(stderr, "swan_serve: %llu requests in %llu batches, %.2f per batch (%.1f%% full), %.1f us executing per batch\n",
+        (unsigned long long)Stats->requests, (unsigned long long)Stats->batches, MeanBatch, 100.0 * MeanBatch / server->maxBatch,
+        Stats->executeNanoseconds / 1e3 / Stats->batches);
+    fprintf(stderr, "swan_serve: latency p50 %u us, p90 %u us, p99 %u us, max %u us over the last %zu requests\n",
+        Sorted[Amount / 2], Sorted[Amount * 9 / 10], Sorted[Amount * 99 / 100], Sorted[Amount - 1], Amount);
+
+    // Only the sizes that happened
+    fputs("swan_serve: batch sizes", stderr);
+    for (uint32_t i = 1; i <= server->maxBatch; i++)
+        if (Stats->batchSizes[i] != 0)
+            fprintf(stderr, " %u:%llu", i, (unsigned long long)Stats->batchSizes[i]);
+    fputc('\n', stderr);
+
+    pthread_mutex_unlock(&server->lock);
+    free(Sorted);
+}
+
+// connections
+
+static void SV_Append(SV_Connection *connection, const void *data, size_t size)
+{
+    if (connection->broken)
+        return;
+
+    if (connection->answerSize + size > connection->answerCapacity)
+    {
+        // What's been sent already gets dropped first
+        memmove(connection->answers, connection->answers + connection->answerSent, connection->answerSize - connection->answerSent);
+        connection->answerSize -= connection->answerSent;
+        connection->answerSent = 0;
+
+        if (connection->answerSize + size > connection->answerCapacity)
+        {
+            connection->answerCapacity = (connection->answerSize + size) * 2;
+            connection->answers = realloc(connection->answers, connection->answerCapacity);
+            if (connection->answers == NULL)
+            {
+                fputs("The server ran out of memory, read your answers faster\n", stderr);
+                exit(1);
+            }
+        }
+    }
+
+    memcpy(connection->answers + connection->answerSize, data, size);
+    connection->answerSize += size;
+}
+
+static void SV_Flush(SV_Connection *connection)
+{
+    while (!connection->broken && connection->answerSent < connection->answerSize)
+    {
+        ssize_t Sent = send(connection->socket, connection->answers + connection->answerSent, connection->answerSize - connection->answerSent, MSG_NOSIGNAL);
+
+        if (Sent > 0)
+            connection->answerSent += (size_t)Sent;
+        else if (Sent < 0 && errno == EINTR)
+            continue;
+        else if (Sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        else
+        {
+            connection->broken = true;
+            connection->readDone = true;
+        }
+    }
+
+    connection->answerSize = connection->answerSent = 0;
+}
+
+static void SV_Accept(SV_Server *server, int listener)
+{
+    for (;;)
+    {
+        int Socket = accept4(listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (Socket < 0)
+            return;
+
+        if (server->connectionAmount == SV_MAX_CONNECTIONS)
+        {
+            close(Socket);
+            continue;
+        }
+
+        SV_Connection *Connection = calloc(1, sizeof(SV_Connection));
+        if (Connection == NULL)
+            exit(1);
+
+        Connection->socket = Socket;
+        Connection->request = SV_Allocate(sizeof(float) * server->inputAmount);
+
+        uint32_t Hello[3] = { SV_MAGIC, server->inputAmount, server->outputAmount };
+        SV_Append(Connection, Hello, sizeof(Hello));
+        SV_Flush(Connection);
+
+        server->connections[server->connectionAmount++] = Connection;
+    }
+}
+
+// Connections stay around until every one of their requests has its answer, the queue points at them
+static void SV_CloseFinished(SV_Server *server)
+{
+    for (uint32_t i = 0; i < server->connectionAmount; i++)
+    {
+        SV_Connection *Connection = server->connections[i];
+        bool Unsent = !Connection->broken && Connection->answerSent < Connection->answerSize;
+
+        if (!Connection->readDone || Connection->pending != 0 || Unsent)
+            continue;
+
+        close(Connection->socket);
+        free(Connection->request);
+        free(Connection->answers);
+        free(Connection);
+
+        server->connections[i--] = server->connections[--server->connectionAmount];
+    }
+}
+
+// Reads whole requests into the queue until the socket is empty or the queue is full
+static void SV_Read(SV_Server *server, SV_Connection *connection)
+{
+    size_t RequestSize = sizeof(float) * server->inputAmount;
+
+    while (!connection->readDone && server->queueAmount < server->queueCapacity)
+    {
+        ssize_t Read = recv(connection->socket, connection->request + connection->requestFill, RequestSize - connection->requestFill, 0);
+
+        if (Read < 0 && errno == EINTR)
+            continue;
+        if (Read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+
+        // Closed, or broken, a half sent request just gets dropped
+        if (Read <= 0)
+        {
+            connection->readDone = true;
+            return;
+        }
+
+        connection->requestFill += (size_t)Read;
+        if (connection->requestFill < RequestSize)
+            continue;
+
+        uint32_t Slot = (server->queueHead + server->queueAmount) % server->queueCapacity;
+        server->queue[Slot] = (SV_Request){ connection, SV_Clock() };
+        memcpy(&server->queueInputs[(size_t)Slot * server->inputAmount], connection->request, RequestSize);
+
+        server->queueAmount++;
+        connection->pending++;
+        connection->requestFill = 0;
+    }
+}
+
+// batches
+
+// Runs one batch and counts it, arrivals has when each of the requests came in
+static void SV_Execute(SV_Server *server, const float *input, float *output, uint32_t batchSize, const uint64_t *arrivals)
+{
+    pthread_mutex_lock(&server->lock);
+
+    uint64_t Start = SV_Clock();
+
+    // A lone request is faster through the compiled network when there is one
+    if (batchSize == 1 && server->network.compiled != NULL)
+        SW_ExecuteCompiledNetwork(&server->network, input, output);
+    else
+        SW_ExecuteNetworkBatch(&server->network, input, output, batchSize, server->workspace, server->workspaceSize);
+
+    uint64_t End = SV_Clock();
+
+    SV_Stats *Stats = &server->stats;
+    Stats->requests += batchSize;
+    Stats->batches++;
+    Stats->batchSizes[batchSize]++;
+    Stats->executeNanoseconds += End - Start;
+
+    for (uint32_t b = 0; b < batchSize; b++)
+    {
+        uint64_t Latency = (End - arrivals[b]) / 1000;
+        Stats->latencies[Stats->latencyAmount++ % SV_LATENCY_AMOUNT] = Latency > UINT32_MAX ? UINT32_MAX : (uint32_t)Latency;
+    }
+
+    pthread_mutex_unlock(&server->lock);
+}
+
+static void SV_ExecuteBatch(SV_Server *server)
+{
+    uint32_t BatchSize = server->queueAmount < server->maxBatch ? server->queueAmount : server->maxBatch;
+
+    for (uint32_t b = 0; b < BatchSize; b++)
+    {
+        uint32_t Slot = (server->queueHead + b) % server->queueCapacity;
+        memcpy(&server->batchInput[(size_t)b * server->inputAmount], &server->queueInputs[(size_t)Slot * server->inputAmount], sizeof(float) * server->inputAmount);
+        server->batchArrivals[b] = server->queue[Slot].arrival;
+    }
+
+    SV_Execute(server, server->batchInput, server->batchOutput, BatchSize, server->batchArrivals);
+
+    for (uint32_t b = 0; b < BatchSize; b++)
+    {
+        SV_Request *Request = &server->queue[(server->queueHead + b) % server->queueCapacity];
+
+        SV_Append(Request->connection, &server->batchOutput[(size_t)b * server->outputAmount], sizeof(float) * server->outputAmount);
+        Request->connection->pending--;
+    }
+
+    server->queueHead = (server->queueHead + BatchSize) % server->queueCapacity;
+    server->queueAmount -= BatchSize;
+}
+
+// shared memory
+
+// Same batching as the sockets, only the requests are already in the ring and the answers go right back there
+static void *SV_ServeRing(void *argument)
+{
+    SV_Server *Server = argument;
+    SV_Ring *Ring = &Server->ring;
+
+    uint32_t *Slots = SV_Allocate(sizeof(uint32_t) * Server->maxBatch);
+    uint64_t *Arrivals = SV_Allocate(sizeof(uint64_t) * Server->maxBatch);
+    uint32_t Amount = 0, Next = 0;
+
+    while (!atomic_load(&Ring->header->closed))
+    {
+        // Read before looking, a submit after the look changes it and the wait returns right away
+        uint32_t Doorbell = atomic_load(&Ring->header->doorbell);
+
+        uint32_t Taken = SV_TakeReadySlots(Ring, Next, Slots + Amount, Server->maxBatch - Amount);
+        for (uint32_t i = Amount; i < Amount + Taken; i++)
+            Arrivals[i] = Ring->header->slots[Slots[i]].submitted;
+
+        if (Taken != 0)
+            Next = (Slots[Amount + Taken - 1] + 1) % Ring->header->slotAmount;
+        Amount += Taken;
+
+        // The oldest request can be anywhere in the batch, clients stamp their own submits
+        uint64_t Oldest = UINT64_MAX;
+        for (uint32_t i = 0; i < Amount; i++)
+            Oldest = Arrivals[i] < Oldest ? Arrivals[i] : Oldest;
+
+        uint64_t Now = SV_Clock();
+
+        if (Amount == Server->maxBatch || (Amount != 0 && Oldest + Server->maxDelay <= Now))
+        {
+            // Slots next to each other already are a batch, anything else gets copied together first
+            bool Contiguous = true;
+            for (uint32_t i = 1; i < Amount; i++)
+                Contiguous &= Slots[i] == Slots[0] + i;
+
+            if (Contiguous)
+                SV_Execute(Server, SV_RingInput(Ring, Slots[0]), SV_RingOutput(Ring, Slots[0]), Amount, Arrivals);
+            else
+            {
+                for (uint32_t i = 0; i < Amount; i++)
+                    memcpy(&Server->ringInput[(size_t)i * Server->inputAmount], SV_RingInput(Ring, Slots[i]), sizeof(float) * Server->inputAmount);
+
+                SV_Execute(Server, Server->ringInput, Server->ringOutput, Amount, Arrivals);
+
+                for (uint32_t i = 0; i < Amount; i++)
+                    memcpy(SV_RingOutput(Ring, Slots[i]), &Server->ringOutput[(size_t)i * Server->outputAmount], sizeof(float) * Server->outputAmount);
+            }
+
+            for (uint32_t i = 0; i < Amount; i++)
+                SV_FinishRingSlot(Ring, Slots[i]);
+
+            Amount = 0;
+            continue;
+        }
+
+        if (Taken != 0)
+            continue;
+
+        // Nothing new, sleep until something is or the oldest one can't wait any longer
+        SV_WaitForRingDoorbell(Ring, Doorbell, Amount != 0 ? Oldest + Server->maxDelay - Now : UINT64_MAX);
+    }
+
+    free(Slots);
+    free(Arrivals);
+
+    return NULL;
+}
+
+static int SV_Listen(const char *path)
+{
+    struct sockaddr_un Address = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(Address.sun_path))
+    {
+        fputs("That socket path is too long for a Unix socket\n", stderr);
+        return -1;
+    }
+
+    strcpy(Address.sun_path, path);
+
+    int Listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (Listener < 0)
+    {
+        perror("swan_serve: socket");
+        return -1;
+    }
+
+    // Whatever a server before this one left behind
+    unlink(path);
+
+    if (bind(Listener, (struct sockaddr *)&Address, sizeof(Address)) < 0 || listen(Listener, 128) < 0)
+    {
+        perror("swan_serve: bind");
+        close(Listener);
+        return -1;
+    }
+
+    return Listener;
+}
+
+static bool SV_InitServer(SV_Server *server, const char *networkFile, uint32_t maxBatch, uint64_t maxDelay)
+{
+    memset(server, 0, sizeof(SV_Server));
+
+    SW_InitNetwork(&server->network);
+    SW_LoadNetwork(&server->network, (char *)networkFile);
+
+    if (server->network.layerAmount < 2)
+    {
+        fputs("That file doesn't have a network worth serving\n", stderr);
+        SW_UnloadNetwork(&server->network);
+        return false;
+    }
+
+    server->inputAmount = server->network.layers[0].neuronAmount;
+    server->outputAmount = server->network.layers[server->network.layerAmount - 1].neuronAmount;
+    server->maxBatch = maxBatch;
+    server->maxDelay = maxDelay;
+
+    server->queueCapacity = maxBatch * SV_QUEUE_BATCHES;
+    server->queue = SV_Allocate(sizeof(SV_Request) * server->queueCapacity);
+    server->queueInputs = SV_Allocate(sizeof(float) * server->inputAmount * server->queueCapacity);
+
+    server->batchInput = SV_Allocate(sizeof(float) * server->inputAmount * maxBatch);
+    server->batchOutput = SV_Allocate(sizeof(float) * server->outputAmount * maxBatch);
+    server->batchArrivals = SV_Allocate(sizeof(uint64_t) * maxBatch);
+
+    // Tuned first, the workspace only has to fit the algorithms that got picked
+    SW_PrepareNetwork(&server->network);
+    server->workspaceSize = SW_QueryWorkspaceSize(&server->network, maxBatch, SW_WORKSPACE_USE_INFERENCE);
+    server->workspace = SV_Allocate(server->workspaceSize);
+
+    server->stats.batchSizes = calloc(maxBatch + 1, sizeof(uint64_t));
+    server->stats.latencies = SV_Allocate(sizeof(uint32_t) * SV_LATENCY_AMOUNT);
+    if (server->stats.batchSizes == NULL)
+        exit(1);
+
+    // Only small dense networks compile, the rest always goes through the batch path
+    SW_CompileNetwork(&server->network);
+
+    pthread_mutex_init(&server->lock, NULL);
+
+    return true;
+}
+
+static bool SV_StartRing(SV_Server *server, const char *name)
+{
+    if (!SV_CreateRing(&server->ring, name, server->inputAmount, server->outputAmount, server->queueCapacity))
+        return false;
+
+    server->ringInput = SV_Allocate(sizeof(float) * server->inputAmount * server->maxBatch);
+    server->ringOutput = SV_Allocate(sizeof(float) * server->outputAmount * server->maxBatch);
+
+    // The signals go to the main thread, its ppoll is what notices them
+    sigset_t Signals, Previous;
+    sigemptyset(&Signals);
+    sigaddset(&Signals, SIGINT);
+    sigaddset(&Signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &Signals, &Previous);
+
+    int Error = pthread_create(&server->ringThread, NULL, SV_ServeRing, server);
+    pthread_sigmask(SIG_SETMASK, &Previous, NULL);
+
+    if (Error != 0)
+    {
+        fputs("The shared memory ring didn't get a thread\n", stderr);
+        SV_CloseRing(&server->ring);
+        return false;
+    }
+
+    return true;
+}
+
+static void SV_StopRing(SV_Server *server)
+{
+    if (server->ring.header == NULL)
+        return;
+
+    SV_ShutdownRing(&server->ring);
+    pthread_join(server->ringThread, NULL);
+    SV_CloseRing(&server->ring);
+}
+
+static void SV_FreeServer(SV_Server *server)
+{
+    for (uint32_t i = 0; i < server->connectionAmount; i++)
+    {
+        close(server->connections[i]->socket);
+        free(server->connections[i]->request);
+        free(server->connections[i]->answers);
+        free(server->connections[i]);
+    }
+
+    free(server->queue);
+    free(server->queueInputs);
+    free(server->batchInput);
+    free(server->batchOutput);
+    free(server->batchArrivals);
+    free(server->ringInput);
+    free(server->ringOutput);
+    free(server->workspace);
+    free(server->stats.batchSizes);
+    free(server->stats.latencies);
+
+    pthread_mutex_destroy(&server->lock);
+    SW_UnloadNetwork(&server->network);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        fputs("usage: swan_serve <network file> <socket path> [--max-batch n] [--max-delay microseconds] [--stats seconds] [--shm name]\n", stderr);
+        return 1;
+    }
+
+    uint32_t MaxBatch = 32;
+    double MaxDelay = 500.0;
+    double StatsInterval = 10.0;
+    const char *RingName = NULL;
+
+    for (int i = 3; i < argc; i++)
+    {
+        bool HasValue = i + 1 < argc;
+
+        if (strcmp(argv[i], "--max-batch") == 0 && HasValue)
+            MaxBatch = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--max-delay") == 0 && HasValue)
+            MaxDelay = strtod(argv[++i], NULL);
+        else if (strcmp(argv[i], "--stats") == 0 && HasValue)
+            StatsInterval = strtod(argv[++i], NULL);
+        else if (strcmp(argv[i], "--shm") == 0 && HasValue)
+            RingName = argv[++i];
+        else
+        {
+            fprintf(stderr, "swan_serve doesn't know what %s is\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (MaxBatch == 0 || MaxDelay < 0.0)
+    {
+        fputs("The batches need room for at least one request, and the delay can't be negative\n", stderr);
+        return 1;
+    }
+
+    SV_Server Server;
+    if (!SV_InitServer(&Server, argv[1], MaxBatch, (uint64_t)(MaxDelay * 1e3)))
+        return 1;
+
+    int Listener = SV_Listen(argv[2]);
+    if (Listener < 0)
+    {
+        SV_FreeServer(&Server);
+        return 1;
+    }
+
+    struct sigaction Action = { .sa_handler = SV_Stop };
+    sigemptyset(&Action.sa_mask);
+    sigaction(SIGINT, &Action, NULL);
+    sigaction(SIGTERM, &Action, NULL);
+
+    fprintf(stderr, "swan_serve: %u inputs, %u outputs, batches of up to %u after %.0f us at most, on %s\n",
+        Server.inputAmount, Server.outputAmount, MaxBatch, MaxDelay, argv[2]);
+
+    if (RingName != NULL)
+    {
+        if (!SV_StartRing(&Server, RingName))
+        {
+            close(Listener);
+            unlink(argv[2]);
+            SV_FreeServer(&Server);
+            return 1;
+        }
+
+        fprintf(stderr, "swan_serve: and %u shared memory slots in %s\n", Server.queueCapacity, RingName);
+    }
+
+    struct pollfd *Polls = SV_Allocate(sizeof(struct pollfd) * (SV_MAX_CONNECTIONS + 1));
+    uint64_t NextStats = StatsInterval > 0.0 ? SV_Clock() + (uint64_t)(StatsInterval * 1e9) : UINT64_MAX;
+
+    while (!SV_stop)
+    {
+        // Full queues stop the reading, the clients wait in their socket buffers instead
+        bool QueueFull = Server.queueAmount == Server.queueCapacity;
+
+        Polls[0] = (struct pollfd){ .fd = Listener, .events = Server.connectionAmount < SV_MAX_CONNECTIONS ? POLLIN : 0 };
+        for (uint32_t i = 0; i < Server.connectionAmount; i++)
+        {
+            SV_Connection *Connection = Server.connections[i];
+            short Events = 0;
+
+            if (!Connection->readDone && !QueueFull)
+                Events |= POLLIN;
+            if (!Connection->broken && Connection->answerSent < Connection->answerSize)
+                Events |= POLLOUT;
+
+            Polls[i + 1] = (struct pollfd){ .fd = Connection->socket, .events = Events };
+        }
+
+        // Until the oldest request has waited long enough, or the next stats
+        uint64_t Now = SV_Clock();
+        uint64_t Deadline = NextStats;
+        if (Server.queueAmount != 0 && Server.queue[Server.queueHead].arrival + Server.maxDelay < Deadline)
+            Deadline = Server.queue[Server.queueHead].arrival + Server.maxDelay;
+
+        struct timespec Timeout = { 0, 0 };
+        if (Deadline > Now)
+        {
+            uint64_t Wait = Deadline - Now;
+            Timeout = (struct timespec){ (time_t)(Wait / 1000000000u), (long)(Wait % 1000000000u) };
+        }
+
+        uint32_t PollAmount = Server.connectionAmount + 1;
+        int Ready = ppoll(Polls, PollAmount, Deadline == UINT64_MAX ? NULL : &Timeout, NULL);
+        if (Ready < 0 && errno != EINTR)
+        {
+            perror("swan_serve: ppoll");
+            break;
+        }
+
+        if (Ready > 0)
+        {
+            // The connections can move around once some get closed, so only after all of them got their turn
+            for (uint32_t i = 0; i + 1 < PollAmount; i++)
+            {
+                SV_Connection *Connection = Server.connections[i];
+                short Events = Polls[i + 1].revents;
+
+                if (Events & (POLLIN | POLLHUP | POLLERR))
+                    SV_Read(&Server, Connection);
+                if (Events & POLLOUT)
+                    SV_Flush(Connection);
+            }
+
+            if (Polls[0].revents & POLLIN)
+                SV_Accept(&Server, Listener);
+        }
+
+        // Full batches go right away, the rest once the oldest request can't wait any longer
+        Now = SV_Clock();
+        while (Server.queueAmount >= Server.maxBatch || (Server.queueAmount != 0 && Server.queue[Server.queueHead].arrival + Server.maxDelay <= Now))
+            SV_ExecuteBatch(&Server);
+
+        for (uint32_t i = 0; i < Server.connectionAmount; i++)
+            SV_Flush(Server.connections[i]);
+
+        SV_CloseFinished(&Server);
+
+        if (Now >= NextStats)
+        {
+            SV_PrintStats(&Server);
+            NextStats = Now + (uint64_t)(StatsInterval * 1e9);
+        }
+    }
+
+    SV_StopRing(&Server);
+    SV_PrintStats(&Server);
+
+    free(Polls);
+    close(Listener);
+    unlink(argv[2]);
+    SV_FreeServer(&Server);
+    SWP_shutdown();
+
+    return 0;
+}